@@ -6,10 +6,80 @@
 #include <filesystem>
 #include <functional>
 #include <tuple>
+#include <vector>
+#include <memory>
+#include <future>
 
 namespace yolo
 {
-	struct image;
+	enum class image_format
+	{
+		rgb,
+		count
+	};
+
+	struct image
+	{
+		uint32_t 					width_px = 0u;
+		uint32_t 					height_px = 0u;
+
+		/// interleaved pixel data, row by row ( RGBRGBRGB... for 'image_format::rgb' )
+		std::vector<uint8_t> 		data;
+		image_format 				format = image_format::count;
+
+		static std::optional<image> load(const std::filesystem::path& filepath);
+		static bool load(const std::filesystem::path& filepath, image& target);
+
+		/// decodes an encoded ( jpg / png ) image that is already in memory
+		static std::optional<image> load_from_memory(const uint8_t* data, size_t num_bytes);
+	};
+
+	struct detection
+	{
+		uint32_t class_id = ~0u;
+
+		/// probability of the detection. range 0 - 1
+		float confidence = 0.0f;
+
+		/// center position X of the detection. range 0 - 1
+		float x = -1;
+
+		/// center position Y of the detection. range 0 - 1
+		float y = -1;
+
+		/// width of the detection. range 0 - 1
+		float w = -1;
+
+		/// height of the detection. range 0 - 1
+		float h = -1;
+	};
+
+	/// a physical core, and the logical cpus ( hyper-threads ) that share it
+	struct cpu_core
+	{
+		uint32_t 				package = 0; 	// socket
+		uint32_t 				numa_node = 0;
+
+		/// ids of the logical cpus, as the OS numbers them
+		std::vector<uint32_t> 	cpus;
+	};
+
+	struct cpu_topology
+	{
+		/// the cores this process may run on, ordered by NUMA node
+		std::vector<cpu_core> 	cores;
+		uint32_t 				num_numa_nodes = 1;
+		uint32_t 				num_logical_cpus = 0;
+	};
+
+	/// the physical cores and NUMA nodes of this machine, as far as this process is allowed to use them ( read from /sys on linux ).
+	/// Elsewhere every logical cpu counts as a core on node 0. Detected once, on the first call.
+	const cpu_topology& topology();
+
+	namespace v3
+	{
+		class detector;
+	}
 
 	namespace internal
 	{
@@ -28,6 +98,7 @@ namespace yolo
 		{
 			protected:
 				friend std::unique_ptr<server> start(const std::string_view& data_source, const std::filesystem::path& weights_folder_path, const std::filesystem::path& chart_png_path, const std::optional<std::filesystem::path>& latest_weights_filepath, unsigned int port);
+				friend std::unique_ptr<server> start_detection(std::shared_ptr<v3::detector> p_detector, unsigned int num_workers, unsigned int port);
 				explicit server(std::unique_ptr<server_internal>&& v);
 				const std::unique_ptr<server_internal> m_internal;
 			public:
@@ -112,15 +183,436 @@ namespace yolo
 		/// \param port
 		void train_on_colab(const std::string_view& data_source, const std::filesystem::path& weights_folder_path = "./weights", const std::filesystem::path& chart_png_path = "./chart.png", const std::optional<std::filesystem::path>& latest_weights_filepath = std::nullopt, const model_args& args = {}, unsigned int port = http::server::server::DEFAULT_PORT);
 
-		/// Starts up an usb-cam and a window, and display's what the results of the training
-		/// \param weights_path file path ( file must end with .weight ) of the weight to use, or a folder path with a collection of weights, where it will pick the best weights itself
+		/// Runs a 'video_pipeline' on a source ( an usb-cam by default ), and shows the detections in a window ( or logs them, without OpenCV ). Esc closes it.
+		/// \param weights_path file path ( file must end with .weight ) of the weight to use, or a folder path with a collection of weights, where it will pick the latest weights itself
+		/// \param source see 'video_pipeline::start'
+		/// \return false if the pipeline could not be started
 		bool demo(const std::filesystem::path& weights_path = "./weights", const std::filesystem::path& source = "/dev/video0");
 
-		/// run YOLO v3 detection on an image
-		//void detect(const std::filesystem::path& image, const std::filesystem::path& weights_filepath = "./trained.weights", const model_args& args = {});
+		struct quantize_args // NOLINT
+		{
+			/// amount of images ( the first ones of the folder ) that are run trough the network to find the range of the activations of each layer
+			uint32_t num_calibration_images = 64;
+
+			/// amount of images ( the ones after the calibration images ) the mAP of the float and int8 network is measured on
+			uint32_t num_evaluation_images = 200;
+		};
+
+		struct quantization_report
+		{
+			uint32_t 				num_quantized_layers = 0;
+			uint32_t 				num_convolutional_layers = 0;
+
+			/// mAP@0.5 on the evaluation images. range 0 - 1. 0 if there were no evaluation images
+			float 					map_fp32 = 0.0f;
+			float 					map_int8 = 0.0f;
+
+			/// map_int8 - map_fp32
+			float 					map_delta = 0.0f;
+
+			/// average time of a single detection on the evaluation images
+			float 					fp32_ms_per_image = 0.0f;
+			float 					int8_ms_per_image = 0.0f;
+
+			/// the quantized weights ( 'config.int8', next to 'config.cfg' )
+			std::filesystem::path 	artifact_path;
+		};
+
+		/// Quantizes the convolutions of a trained network to int8 ( per channel weights, uint8 activations ), for faster inference on the CPU ( see 'detector_args::int8' ).
+		/// The range of the activations is calibrated on images of the training data, and the mAP with and without the quantization is measured on other images of it.
+		/// \param images_and_txt_annotations_folder same folder as passed to 'train'
+		/// \param weights_path file path of the weights, or a folder path, where it will pick the latest weights
+		/// \return nullopt if loading the network or images failed, or the quantized weights could not be written
+		std::optional<quantization_report> quantize(const std::filesystem::path& images_and_txt_annotations_folder, const std::filesystem::path& weights_path = "./weights", const quantize_args& args = {});
+
+		struct prune_args // NOLINT
+		{
+			/// fraction of the prunable channels to remove ( the ones with the smallest batchnorm scale, over all layers )
+			float ratio = 0.5f;
+
+			/// every pruned layer keeps at least this many channels
+			uint32_t min_channels = 8;
+
+			/// the channels a layer keeps are rounded up to a multiple of this, which suits the SIMD kernels
+			uint32_t channel_multiple = 8;
+		};
+
+		struct prune_report
+		{
+			/// channels of the convolutional layers, before pruning
+			uint32_t 				num_channels = 0;
+			uint32_t 				num_pruned_channels = 0;
+
+			/// cost of the convolutions ( billions of floating point operations per image )
+			float 					bflops_before = 0.0f;
+			float 					bflops_after = 0.0f;
+
+			std::filesystem::path 	weights_path;
+		};
+
+		/// Prunes the channels with the smallest batchnorm scale from a trained network, which makes it smaller and faster at the cost of some accuracy
+		/// ( single class models often have many channels that are near-dead ). The accuracy mostly comes back by training the pruned network for a while.
+		/// Writes the pruned model ( 'model.cfg' ), its weights and the config to 'target_folder', which can be passed to 'train' to fine-tune it ( with the
+		/// same images ), and to 'detector::create' like any other weights folder.
+		/// \param weights_path file path of the weights, or a folder path, where it will pick the latest weights
+		/// \param target_folder folder to write the pruned model to. should not be the folder of 'weights_path'
+		/// \return nullopt if loading the model failed, it has layers that can not be pruned, or writing failed
+		std::optional<prune_report> prune(const std::filesystem::path& weights_path, const std::filesystem::path& target_folder, const prune_args& args = {});
+
+		struct detector_args // NOLINT
+		{
+			/// detections with a lower confidence are dropped
+			float thresh = 0.25f;
+
+			/// overlap ( IoU ) above which the weaker of 2 detections of the same class is dropped
+			float nms_thresh = 0.45f;
+
+			/// keep the aspect ratio of the image when scaling it to the network size ( pads the remainder )
+			bool letter_box = false;
+
+			/// max amount of images that are gathered from concurrent 'detect' calls, and run trough the network in a single forward pass.
+			/// the network is loaded with this batch size, so every forward pass costs the same regardless of how many images are in it.
+			uint32_t max_batch_size = 1;
+
+			/// max time ( in microseconds ) the oldest queued image waits for the batch to fill up before the forward pass is done anyway
+			uint32_t max_batch_wait_us = 0;
+
+			/// amount of copies of the network that run in parallel. All replicas share 1 read-only copy of the weights.
+			/// queued images are spread over the replicas, and an idle replica steals work queued for a busy one.
+			uint32_t replicas = 1;
+
+			/// amount of threads each replica uses for its forward pass. 0 = amount of physical cores / replicas ( see 'topology' ).
+			/// ( replicas x threads_per_replica ) is the split to tune for throughput on a given machine.
+			uint32_t threads_per_replica = 0;
+
+			/// pins the threads of each replica to physical cores of their own ( 1 thread per core ), the replicas spread over the NUMA nodes.
+			/// The activations of a replica, and a copy of the weights per NUMA node, are then allocated on the node it runs on.
+			/// The resulting layout is in 'detector_metrics::placement'. Without it, the OS moves the threads around, which makes the timing vary a lot.
+			/// Off by default: the cores are handed out from the first core of each node, so a second detector ( or a 'video_pipeline' ) in the same
+			/// process that pins as well ends up on the same cores. Only turn it on for the one that has the machine to itself.
+			bool pin_threads = false;
+
+			/// run the quantized convolutions that 'quantize' wrote next to the config. falls back to float ( with a log ) if there are none for these weights
+			bool int8 = false;
+
+			/// the [yolo] heads to detect with, in cfg order. empty = all. The layers that only feed the other heads are not computed.
+			/// yolov3: 0 = stride 32 ( large objects ), 1 = stride 16, 2 = stride 8 ( small objects, the most expensive branch )
+			std::vector<uint32_t> heads;
+		};
+
+		/// see 'detector::detect_tiled'
+		struct tile_args // NOLINT
+		{
+			/// width and height of the tiles, in pixels of the image. 0 = the network input size, so the tiles are not scaled
+			uint32_t 	tile_size_px = 0;
+
+			/// minimum overlap of neighbouring tiles, as part of a tile ( 0 - 0.9 ). should be about the size of the largest objects that are to be found in the tiles
+			float 		overlap = 0.2f;
+
+			/// also detect on the whole image scaled down to the network size, for the objects that are larger than a tile
+			bool 		full_frame_pass = true;
+
+			/// a box cut by a tile edge is merged into a box of the same class it lies in for more than this part ( of its area )
+			float 		cut_thresh = 0.6f;
+		};
+
+		/// where the threads of a replica run ( see 'detector_args::pin_threads' )
+		struct replica_placement
+		{
+			uint32_t 				numa_node = 0;
+
+			/// logical cpu each thread is pinned to, one per physical core
+			std::vector<uint32_t> 	cpus;
+		};
+
+		struct detector_metrics
+		{
+			uint32_t 	max_batch_size = 0;
+			uint32_t 	max_batch_wait_us = 0;
+			uint32_t 	replicas = 0;
+			uint32_t 	threads_per_replica = 0;
+
+			/// per replica. empty if the threads are not pinned
+			std::vector<replica_placement> placement;
+
+			/// amount of images detected so far
+			uint64_t 	num_images = 0;
+
+			/// amount of forward passes done so far
+			uint64_t 	num_batches = 0;
+
+			/// average amount of images per forward pass
+			float 		average_batch_size = 0.0f;
+
+			/// average time an image spent in the queue before its forward pass started
+			float 		average_queue_wait_us = 0.0f;
+
+			/// average time of a forward pass ( including the scaling of the images to the network input )
+			float 		average_batch_us = 0.0f;
+		};
+
+		class detector_internal;
+
+		/// YOLO v3 detector that loads the config and weights once, and keeps the network loaded in between detections.
+		/// Thread safe. Concurrent calls to 'detect' are batched together ( see 'detector_args::max_batch_size' ).
+		class detector
+		{
+			protected:
+				explicit detector(std::unique_ptr<detector_internal>&& v);
+				const std::unique_ptr<detector_internal> m_internal;
+			public:
+				~detector();
+
+				/// \param weights_path file path ( file must end with .weights ) of the weights to use, or a folder path with a collection of weights, where it will pick the latest weights itself.
+				///                     the 'config.cfg' written by 'train' is expected next to the weights ( or in the parent folder )
+				/// \return nullptr if loading the config or weights failed
+				static std::unique_ptr<detector> create(const std::filesystem::path& weights_path = "./weights", const detector_args& args = {});
+
+				/// run YOLO v3 detection on an image
+				std::vector<detection> detect(const image& image);
+
+				/// queues the image for detection. the future is set once the batch it ended up in has been run
+				std::future<std::vector<detection>> detect_async(image image);
+
+				/// runs detection on overlapping tiles of the image instead of on the image scaled down to the network size, so small objects in large images stay visible.
+				/// The tiles are queued together, so they are spread over the replicas and batched like concurrent 'detect' calls.
+				/// Boxes are merged across the tiles with non maximum suppression ( see 'detector_args::nms_thresh' and 'tile_args::cut_thresh' ).
+				std::vector<detection> detect_tiled(const image& image, const tile_args& args = {});
 
-		/// run YOLO v3 detection on an image
-		//void detect(const image& image, const std::filesystem::path& weights_filepath = "./trained.weights", const model_args& args = {});
+				/// run YOLO v3 detection on an image file
+				/// \return nullopt if the image could not be loaded
+				std::optional<std::vector<detection>> detect(const std::filesystem::path& image_filepath);
+
+				[[nodiscard]] detector_metrics metrics() const;
+		};
+
+		/// what a stage of the 'video_pipeline' does with a frame when the buffer to the next stage is full ( the next stage can not keep up )
+		enum class overload_policy
+		{
+			drop_oldest, 	// drops the oldest frame in the buffer, so the frames that do get trough are as recent as possible
+			drop_newest, 	// drops the new frame
+			block 			// waits until there is room, which slows down the stages before it ( up to the source )
+		};
+
+		/// Skips the forward pass while the scene does not change, and reuses the last detections instead ( for cameras that watch a mostly static scene ).
+		/// Each frame is scaled down to a small gray image, and compared to the last frame that did run the forward pass, per cell of 16x16 pixels.
+		struct motion_gate_args // NOLINT
+		{
+			bool 		enabled = false;
+
+			/// mean absolute difference of a cell ( gray, range 0 - 255 ) that counts as a change. raise it for noisy cameras
+			float 		threshold = 6.0f;
+
+			/// part of the frame that is watched, range 0 - 1. changes outside of it ( a clock, trees ) are ignored
+			float 		left = 0.0f;
+			float 		top = 0.0f;
+			float 		width = 1.0f;
+			float 		height = 1.0f;
+
+			/// runs the forward pass at least once every this many frames anyway. 0 = only on change
+			uint32_t 	max_skipped_frames = 30;
+		};
+
+		/// Follows the objects across the frames ( SORT: a constant velocity Kalman filter per object, matched to the detections by IoU ), so every
+		/// object gets an id that stays the same from frame to frame, and the frames that skip the forward pass still get boxes where the objects are now.
+		struct tracker_args // NOLINT
+		{
+			bool 		enabled = false;
+
+			/// minimum IoU of a detection and the predicted box of a track ( of the same class ) for them to be matched
+			float 		iou_thresh = 0.3f;
+
+			/// frames that ran the forward pass, that a track can go without a matching detection before it is removed
+			uint32_t 	max_misses = 3;
+
+			/// matched detections a track needs before it is reported, so a false positive that shows up once does not get a track
+			uint32_t 	min_hits = 3;
+		};
+
+		/// an object followed by the tracker
+		struct track
+		{
+			/// unique for the lifetime of the 'video_pipeline'
+			uint64_t 	id = 0;
+
+			/// where the object is in this frame. the confidence is the one of the last detection that was matched to it
+			detection 	box;
+
+			/// false if 'box' was corrected by a detection in this frame, true if it is only predicted
+			bool 		predicted = false;
+		};
+
+		struct video_args // NOLINT
+		{
+			/// frames that fit in the buffer between 2 stages ( rounded up to a power of 2 ). the latency grows with it when the pipeline is overloaded
+			uint32_t 		buffer_size = 2;
+
+			overload_policy policy = overload_policy::drop_oldest;
+
+			/// rate to read the source at. 0 = the rate of the source: video files are replayed in real time, cameras and image folders are read as fast as they deliver
+			float 			source_fps = 0.0f;
+
+			float 			thresh = 0.25f;
+			float 			nms_thresh = 0.45f;
+			bool 			letter_box = false;
+
+			/// threads of the forward pass. 0 = the physical cores minus 2 ( for the other stages )
+			uint32_t 		threads = 0;
+
+			/// pins the threads of the forward pass to physical cores of their own ( see 'topology' ). Off by default, for the same reason as 'detector_args::pin_threads'
+			bool 			pin_threads = false;
+
+			/// runs the forward pass on one of every this many frames only ( the others are handled as if the motion gate skipped them ).
+			/// use it with the tracker, which moves the boxes along on the frames in between
+			uint32_t 		infer_interval = 1;
+
+			motion_gate_args motion_gate;
+			tracker_args 	tracker;
+		};
+
+		struct video_frame
+		{
+			/// position of the frame in the source ( counts the dropped frames as well )
+			uint64_t 				index = 0;
+			image 					source;
+			std::vector<detection> 	detections;
+
+			/// time from when the frame was read from the source until its detections were ready ( glass to detection, minus the capture itself )
+			float 					latency_ms = 0.0f;
+
+			/// false if the forward pass was skipped ( see 'video_args::infer_interval' and 'motion_gate_args' ), and 'detections' are those of the last frame that did run it
+			bool 					inferred = true;
+
+			/// the objects the tracker follows, if 'video_args::tracker' is enabled
+			std::vector<track> 		tracks;
+
+			/// true if 'video_args::tracker' is enabled. then 'tracks' is what to show, also when it is empty ( before the first track is confirmed, or after the last one is lost )
+			bool 					tracked = false;
+		};
+
+		struct video_metrics
+		{
+			uint64_t 	frames_read = 0;
+			uint64_t 	frames_done = 0;
+
+			/// frames dropped by the overload policy
+			uint64_t 	frames_dropped = 0;
+
+			/// frames the motion gate skipped the forward pass for
+			uint64_t 	frames_gated = 0;
+
+			float 		average_latency_ms = 0.0f;
+			float 		max_latency_ms = 0.0f;
+
+			/// average time per frame of each stage: decode, preprocess, infer, postprocess, sink
+			float 		stage_ms[5] = {};
+		};
+
+		class video_pipeline_internal;
+
+		/// Runs detection on a video source in separate stages: decode -> preprocess ( scaling into the network input ) -> infer ( the forward pass, and decoding
+		/// the boxes ) -> postprocess ( non maximum suppression ) -> sink. Each stage has its own thread, and hands its frames to the next one trough a bounded
+		/// lock-free ring buffer. When a buffer is full, 'video_args::policy' decides what happens, so the latency stays bounded when the CPU can not keep up.
+		class video_pipeline
+		{
+			protected:
+				explicit video_pipeline(std::unique_ptr<video_pipeline_internal>&& v);
+				const std::unique_ptr<video_pipeline_internal> m_internal;
+			public:
+				/// stops the pipeline ( see 'stop' )
+				~video_pipeline();
+
+				/// called from the sink stage, for each frame that made it trough the pipeline, in order
+				using sink = std::function<void(video_frame&& frame)>;
+
+				/// \param weights_path same as for 'detector::create'
+				/// \param source "/dev/videoN" for a camera, a folder of .jpg / .png images, an http(s) url of an MJPEG stream ( ip cameras ), or a video file / other stream url
+				///               ( cameras, video files and other streams need darknet with OpenCV )
+				/// \return nullptr if loading the network or opening the source failed
+				static std::unique_ptr<video_pipeline> start(const std::filesystem::path& weights_path, const std::string& source, sink sink, const video_args& args = {});
+
+				/// blocks until the source has ended, and all its frames went trough the sink ( or until 'stop' )
+				void wait();
+
+				/// \return true once the source has ended, and all its frames went trough the sink ( or after 'stop' )
+				[[nodiscard]] bool is_done() const;
+
+				/// stops all stages, the frames still in the pipeline are dropped. not to be called from the sink
+				void stop();
+
+				[[nodiscard]] video_metrics metrics() const;
+		};
+	}
+
+	namespace http::server
+	{
+		enum
+		{
+			DEFAULT_NUM_DETECTION_WORKERS = 8
+		};
+
+		/// sets up a server that runs detections for its clients, on a network that stays loaded.
+		/// Clients 'POST /detect' with a jpg or png as body, and get the detections back as json:
+		///     {"width":1920,"height":1080,"detections":[{"class_id":0,"confidence":0.91,"x":0.51,"y":0.43,"w":0.2,"h":0.3}]}
+		/// ( x and y are the center of the detection, all in range 0 - 1 of the image size )
+		/// Connections are kept alive, so a client can send many requests over 1 connection.
+		/// The server will close upon destruction of the returning object.
+		///
+		/// \param p_detector detector to run the requests on. concurrent requests are batched / spread over replicas as configured in its 'detector_args'
+		/// \param num_workers amount of connections that are handled concurrently
+		/// \return nullptr or server object. If null, the starting of the server failed.
+		std::unique_ptr<server> start_detection(std::shared_ptr<v3::detector> p_detector, unsigned int num_workers = DEFAULT_NUM_DETECTION_WORKERS, unsigned int port = server::DEFAULT_PORT);
+
+		/// same as above, but loads the detector from 'weights_path' ( see 'v3::detector::create' )
+		std::unique_ptr<server> start_detection(const std::filesystem::path& weights_path, const v3::detector_args& detector_args = {}, unsigned int num_workers = DEFAULT_NUM_DETECTION_WORKERS, unsigned int port = server::DEFAULT_PORT);
+
+		struct mjpeg_args // NOLINT
+		{
+			unsigned int 	port = 8090;
+
+			/// viewers that can watch at the same time. each one holds a connection, and a thread of the server
+			unsigned int 	max_clients = 8;
+
+			/// threads that draw the boxes and encode the frames
+			unsigned int 	num_encode_threads = 2;
+
+			/// JPEG quality ( 1 - 100 ) with 1 viewer. it goes down linearly to 'min_quality' at 'max_clients' viewers
+			int 			max_quality = 85;
+			int 			min_quality = 50;
+
+			/// frame rate with 1 viewer. it is divided over the viewers as they connect, down to 'min_fps'
+			float 			max_fps = 30.0f;
+			float 			min_fps = 5.0f;
+
+			/// draws the tracks of the frame ( or its detections, without the tracker )
+			bool 			draw_boxes = true;
+		};
+
+		class mjpeg_server_internal;
+
+		/// Serves the frames of a 'video_pipeline' as an MJPEG stream ( multipart/x-mixed-replace ) on 'GET /stream', which browsers and video players
+		/// show as is ( 'GET /' is a page that shows it ). The boxes are drawn and the frames are encoded on threads of the server, so the sink of the
+		/// pipeline only hands the frame over. Each frame is encoded once, and that same buffer is sent to all viewers. A viewer that can not keep up
+		/// skips to the latest frame. Nothing is encoded while nobody watches, and the quality and frame rate go down as more viewers connect, which
+		/// keeps the upload bounded.
+		class mjpeg_server
+		{
+			protected:
+				explicit mjpeg_server(std::unique_ptr<mjpeg_server_internal>&& v);
+				const std::unique_ptr<mjpeg_server_internal> m_internal;
+			public:
+				/// stops the server, and disconnects the viewers
+				~mjpeg_server();
+
+				/// \return nullptr if the port could not be bound
+				static std::unique_ptr<mjpeg_server> start(const mjpeg_args& args = {});
+
+				/// hands 'frame' to the encoders, and returns right away. frames are skipped ( before they are copied ) while nobody watches,
+				/// and above the frame rate for the current amount of viewers. can be called from any thread
+				void push(const v3::video_frame& frame);
+
+				[[nodiscard]] uint32_t num_clients() const;
+		};
 	}
 
 	/// pull training data from a server ( with --server )
@@ -2,8 +2,10 @@
 #include <iostream>
 #include <cstring>
 #include <array>
+#include <sstream>
 #include "../src_lib/internal/progress_watch.hpp"
 #include "../src_lib/internal/internal.hpp"
+#include "../src_lib/internal/elementwise.hpp"
 
 namespace yolo::internal
 {
@@ -11,6 +13,7 @@ namespace yolo::internal
 	static const char* find_arg_value(int argc, const char** argv, const char *arg);
 	static std::string str(const char* cstr);
 	static std::optional<std::string> str_opt(const char* cstr);
+	static std::vector<uint32_t> parse_indices(const char* cstr);
 
 	template<int NumValues>
 	static std::optional<std::array<const char*, NumValues>> find_arg_values(int argc, const char** argv, const char *arg);
@@ -68,7 +71,55 @@ namespace yolo::internal
 		std::cout << "                                     * The 'trainer' will keep sharing the latest weights file back to the server again" << std::endl;
 		std::cout << "                                 This is convenient when using this with google colab, where colab can disconnect the 'trainer' at any time." << std::endl;
 		std::cout << "" << std::endl;
-		std::cout << "	--demo                         opens a window and activates the usb-cam, you can use it to see the results of the training" << std::endl;
+		std::cout << "	--demo [weights-path] [source (optional)]" << std::endl;
+		std::cout << "                                 runs detection on a video source, and shows the detections in a window ( Esc closes it )" << std::endl;
+		std::cout << "                                 source is '/dev/video0' by default, and can be a camera, a video file, a folder of images," << std::endl;
+		std::cout << "                                 or the http url of an MJPEG stream ( ip cameras )" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --demo ./weights" << std::endl;
+		std::cout << "                                     --demo ./weights ./street.mp4" << std::endl;
+		std::cout << "                                     --demo ./weights http://192.168.1.20/video.mjpg" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--mjpeg_port [port]            with '--demo': serves the annotated video as an MJPEG stream on http://host:port/ instead of showing a window" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --demo ./weights http://192.168.1.20/video.mjpg --mjpeg_port 8090" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--detect [weights-path] [image-path]" << std::endl;
+		std::cout << "                                 runs detection on an image, and prints the detections" << std::endl;
+		std::cout << "                                 weights-path can be a .weights file, or a folder with .weights files" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --detect ./weights ./cat.jpg" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--detect_server [weights-path] [port (optional)]" << std::endl;
+		std::cout << "                                 sets up a server that runs detections on the posted images ( POST /detect with a jpg/png as body )" << std::endl;
+		std::cout << "                                 and responds with the detections as json" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --detect_server ./weights 8086" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--heads [indices]              with '--detect' / '--detect_server': only runs these [yolo] heads ( comma separated, in cfg order )" << std::endl;
+		std::cout << "                                 for yolov3: 0 = large objects, 1 = medium, 2 = small objects" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --detect ./weights ./cat.jpg --heads 0,1" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--tiled                        with '--detect': detects on overlapping network sized tiles of the image ( for small objects in large images )" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --detect ./weights ./street_4k.jpg --tiled" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--quantize [folder-path] [weights-path]" << std::endl;
+		std::cout << "                                 quantizes the network to int8 for faster detection on the CPU, calibrated on" << std::endl;
+		std::cout << "                                 the images/annotations in the given folder ( the one it was trained on )" << std::endl;
+		std::cout << "                                 writes 'config.int8' next to 'config.cfg', and prints the mAP with and without it" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --quantize ./data ./weights" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--prune [weights-path] [target-folder] [ratio (optional)]" << std::endl;
+		std::cout << "                                 removes the channels with the smallest batchnorm scale ( 'ratio' of them, default 0.5 )" << std::endl;
+		std::cout << "                                 and writes the smaller model to 'target-folder'. fine-tune it afterwards with" << std::endl;
+		std::cout << "                                 '--train_yolov3' on the same images, and 'target-folder' as weights folder" << std::endl;
+		std::cout << "                                 examples:" << std::endl;
+		std::cout << "                                     --prune ./weights ./pruned 0.6" << std::endl;
+		std::cout << "" << std::endl;
+		std::cout << "	--benchmark_kernels            times darknet's upsample / shortcut / activation loops against the vectorized ones" << std::endl;
 		std::cout << "" << std::endl;
 		std::cout << "  -h, --help                     shows this help" << std::endl;
 		std::cout << "" << std::endl;
@@ -111,11 +162,106 @@ namespace yolo::internal
 			yolo::v3::train(v->images_and_txt_annotations_folder, v->weights_folder_path);
 		}
 
-		if(find_arg(argc, argv, "--demo"))
+		if(auto weights_path = str_opt(find_arg_value(argc, argv, "--demo")))
 		{
-			std::filesystem::path base_path = "./";
-			std::filesystem::path session_path = base_path / "session_1664043901";
-			yolo::v3::demo(session_path / "weights");
+			const auto v = find_arg_values<2>(argc, argv, "--demo");
+			const std::string source = v->at(1) != nullptr ? v->at(1) : "/dev/video0";
+			if(auto mjpeg_port = str_opt(find_arg_value(argc, argv, "--mjpeg_port")))
+			{
+				yolo::http::server::mjpeg_args mjpeg_args;
+				mjpeg_args.port = (unsigned int)atoi(mjpeg_port->c_str());
+				if(auto p_server = yolo::http::server::mjpeg_server::start(mjpeg_args))
+				{
+					auto p_pipeline = yolo::v3::video_pipeline::start(*weights_path, source, [&](yolo::v3::video_frame&& frame){ p_server->push(frame); });
+					if(p_pipeline != nullptr)
+					{
+						getchar(); // just wait for a key fow now. the stream will stay up until then.
+					}
+				}
+			}
+			else
+			{
+				yolo::v3::demo(*weights_path, source);
+			}
+		}
+
+		yolo::v3::detector_args detector_args;
+		detector_args.heads = parse_indices(find_arg_value(argc, argv, "--heads"));
+
+		if(auto v = find_arg_values<2>(argc, argv, "--detect"))
+		{
+			if(v->at(0) != nullptr && v->at(1) != nullptr)
+			{
+				if(auto p_detector = yolo::v3::detector::create(v->at(0), detector_args))
+				{
+					std::optional<std::vector<yolo::detection>> detections;
+					if(!find_arg(argc, argv, "--tiled"))
+					{
+						detections = p_detector->detect(std::filesystem::path(v->at(1)));
+					}
+					else if(auto image = yolo::image::load(v->at(1)))
+					{
+						detections = p_detector->detect_tiled(*image);
+					}
+					if(detections.has_value())
+					{
+						for(const auto& d : *detections)
+						{
+							std::cout << d.class_id << " " << d.confidence << " " << d.x << " " << d.y << " " << d.w << " " << d.h << std::endl;
+						}
+					}
+				}
+			}
+		}
+
+		if(auto weights_path = str_opt(find_arg_value(argc, argv, "--detect_server")))
+		{
+			const auto v = find_arg_values<2>(argc, argv, "--detect_server");
+			const unsigned int port = v->at(1) != nullptr ? (unsigned int)atoi(v->at(1)) : (unsigned int)yolo::http::server::server::DEFAULT_PORT;
+			if(auto p_server = yolo::http::server::start_detection(std::filesystem::path(*weights_path), detector_args, yolo::http::server::DEFAULT_NUM_DETECTION_WORKERS, port))
+			{
+				getchar(); // just wait for a key fow now. server will stay active until then.
+			}
+		}
+
+		if(auto v = find_arg_values<2>(argc, argv, "--quantize"))
+		{
+			if(v->at(0) != nullptr && v->at(1) != nullptr)
+			{
+				if(auto report = yolo::v3::quantize(v->at(0), v->at(1)))
+				{
+					std::cout << "quantized " << report->num_quantized_layers << " of " << report->num_convolutional_layers << " convolutional layers to '" << report->artifact_path.string() << "'" << std::endl;
+					std::cout << "mAP@0.5 fp32: " << report->map_fp32 << " ( " << report->fp32_ms_per_image << " ms/image )" << std::endl;
+					std::cout << "mAP@0.5 int8: " << report->map_int8 << " ( " << report->int8_ms_per_image << " ms/image )" << std::endl;
+					std::cout << "mAP delta:    " << report->map_delta << std::endl;
+				}
+			}
+		}
+
+		if(auto v = find_arg_values<2>(argc, argv, "--prune"))
+		{
+			if(v->at(0) != nullptr && v->at(1) != nullptr)
+			{
+				yolo::v3::prune_args args;
+				if(const auto ratio = find_arg_values<3>(argc, argv, "--prune"); ratio->at(2) != nullptr)
+				{
+					args.ratio = (float)atof(ratio->at(2));
+				}
+				if(auto report = yolo::v3::prune(v->at(0), v->at(1), args))
+				{
+					std::cout << "pruned " << report->num_pruned_channels << " of " << report->num_channels << " channels to '" << report->weights_path.string() << "'" << std::endl;
+					std::cout << "BFLOPs: " << report->bflops_before << " -> " << report->bflops_after << std::endl;
+				}
+			}
+		}
+
+		if(find_arg(argc, argv, "--benchmark_kernels"))
+		{
+			std::cout << "kernels: " << elementwise_isa() << std::endl;
+			for(const auto& v : benchmark_elementwise())
+			{
+				std::cout << v.name << ": " << v.darknet_ms << " ms -> " << v.simd_ms << " ms ( x" << v.darknet_ms / std::max(v.simd_ms, 1e-6) << " )" << std::endl;
+			}
 		}
 
 		//yolo::obtain_trainingdata_google_open_images("/home/jesse/MainSVN/catwatch_data/open_images", "Cat", 10000);
@@ -177,6 +323,21 @@ namespace yolo::internal
 	{
 		return cstr == nullptr ? std::nullopt : std::make_optional(cstr);
 	}
+
+	static std::vector<uint32_t> parse_indices(const char* cstr)
+	{
+		std::vector<uint32_t> v;
+		std::stringstream stream(str(cstr));
+		std::string index;
+		while(std::getline(stream, index, ','))
+		{
+			if(!index.empty())
+			{
+				v.push_back((uint32_t)atoi(index.c_str()));
+			}
+		}
+		return v;
+	}
 }
 
 
@@ -1,4 +1,4 @@
-#include "image.hpp"
+#include <yolo.hpp>
 
 #define STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
@@ -11,12 +11,24 @@
 #include <stb_image_resize.h>
 #include <stb_image_write.h>
 
-
-#if 0
 namespace yolo
 {
 	void log(const std::string_view& message);
 
+	static bool from_stbi(stbi_uc* p_pixels, int width, int height, image& target)
+	{
+		if(p_pixels == nullptr)
+		{
+			return false;
+		}
+		target.width_px = (uint32_t)width;
+		target.height_px = (uint32_t)height;
+		target.format = image_format::rgb;
+		target.data.assign(p_pixels, p_pixels + ((size_t)width * (size_t)height * 3));
+		stbi_image_free(p_pixels);
+		return true;
+	}
+
 	std::optional<image> image::load(const std::filesystem::path& filepath)
 	{
 		image v;
@@ -29,7 +41,30 @@ namespace yolo
 
 	bool image::load(const std::filesystem::path& filepath, image& target)
 	{
+		int width = 0;
+		int height = 0;
+		int channels_in_file = 0;
+		stbi_uc* p_pixels = stbi_load(filepath.string().c_str(), &width, &height, &channels_in_file, 3); // a statement of its own: as an argument of 'from_stbi', it could run after 'width' and 'height' are read
+		if(!from_stbi(p_pixels, width, height, target))
+		{
+			log("Failed to load image '" + filepath.string() + "': " + std::string(stbi_failure_reason()));
+			return false;
+		}
+		return true;
+	}
 
+	std::optional<image> image::load_from_memory(const uint8_t* data, size_t num_bytes)
+	{
+		image v;
+		int width = 0;
+		int height = 0;
+		int channels_in_file = 0;
+		stbi_uc* p_pixels = stbi_load_from_memory(data, (int)num_bytes, &width, &height, &channels_in_file, 3); // a statement of its own: as an argument of 'from_stbi', it could run after 'width' and 'height' are read
+		if(!from_stbi(p_pixels, width, height, v))
+		{
+			log("Failed to decode image: " + std::string(stbi_failure_reason()));
+			return std::nullopt;
+		}
+		return v;
 	}
 }
-#endif
\ No newline at end of file
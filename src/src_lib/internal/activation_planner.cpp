@@ -0,0 +1,84 @@
+#include "activation_planner.hpp"
+#include <limits>
+#include <algorithm>
+
+namespace yolo::internal
+{
+	/// slots are aligned to a cache line
+	static constexpr size_t s_slot_alignment_floats = 16;
+
+	activation_plan plan_activations(const std::vector<activation_interval>& intervals)
+	{
+		struct slot
+		{
+			size_t 		num_floats = 0;
+			uint32_t 	free_after = 0; 	// last use of the interval that was assigned last
+			bool 		is_used = false;
+		};
+		std::vector<slot> slots;
+		std::vector<size_t> slot_per_interval(intervals.size(), 0);
+
+		for(size_t i=0; i<intervals.size(); i++)
+		{
+			const auto& interval = intervals[i];
+			const size_t num_floats = (interval.num_floats + s_slot_alignment_floats - 1) / s_slot_alignment_floats * s_slot_alignment_floats;
+
+			// release the slots of everything that is not read anymore
+			for(auto& s : slots)
+			{
+				if(s.is_used && s.free_after < interval.first_use)
+				{
+					s.is_used = false;
+				}
+			}
+
+			// best fit, otherwise grow the largest free slot ( so the arena grows as little as possible )
+			size_t best = std::numeric_limits<size_t>::max();
+			size_t largest = std::numeric_limits<size_t>::max();
+			for(size_t j=0; j<slots.size(); j++)
+			{
+				if(slots[j].is_used)
+				{
+					continue;
+				}
+				if(slots[j].num_floats >= num_floats && (best == std::numeric_limits<size_t>::max() || slots[j].num_floats < slots[best].num_floats))
+				{
+					best = j;
+				}
+				if(largest == std::numeric_limits<size_t>::max() || slots[j].num_floats > slots[largest].num_floats)
+				{
+					largest = j;
+				}
+			}
+			if(best == std::numeric_limits<size_t>::max())
+			{
+				best = largest;
+			}
+			if(best == std::numeric_limits<size_t>::max())
+			{
+				best = slots.size();
+				slots.emplace_back();
+			}
+
+			auto& s = slots[best];
+			s.num_floats = std::max(s.num_floats, num_floats);
+			s.free_after = interval.last_use;
+			s.is_used = true;
+			slot_per_interval[i] = best;
+		}
+
+		activation_plan plan;
+		std::vector<size_t> slot_offsets(slots.size(), 0);
+		for(size_t j=0; j<slots.size(); j++)
+		{
+			slot_offsets[j] = plan.num_floats;
+			plan.num_floats += slots[j].num_floats;
+		}
+		plan.offsets.resize(intervals.size());
+		for(size_t i=0; i<intervals.size(); i++)
+		{
+			plan.offsets[i] = slot_offsets[slot_per_interval[i]];
+		}
+		return plan;
+	}
+}
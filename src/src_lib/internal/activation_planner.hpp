@@ -0,0 +1,32 @@
+#ifndef ALL_YOLO_ACTIVATION_PLANNER_HPP
+#define ALL_YOLO_ACTIVATION_PLANNER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace yolo::internal
+{
+	/// an activation buffer that is written by step 'first_use', and read up to ( and including ) step 'last_use'
+	struct activation_interval
+	{
+		size_t 		num_floats = 0;
+		uint32_t 	first_use = 0;
+		uint32_t 	last_use = 0;
+	};
+
+	struct activation_plan
+	{
+		/// offset ( in floats ) in the arena per interval
+		std::vector<size_t> offsets;
+		/// total size of the arena in floats
+		size_t 				num_floats = 0;
+	};
+
+	/// assigns the intervals to slots in a single arena, where intervals that are never alive at the same time share a slot.
+	/// slots are reused best fit ( the smallest free slot that is large enough ), and grown if none is.
+	/// \param intervals must be sorted by 'first_use'
+	activation_plan plan_activations(const std::vector<activation_interval>& intervals);
+}
+
+#endif //ALL_YOLO_ACTIVATION_PLANNER_HPP
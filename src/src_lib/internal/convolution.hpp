@@ -0,0 +1,74 @@
+#ifndef ALL_YOLO_CONVOLUTION_HPP
+#define ALL_YOLO_CONVOLUTION_HPP
+
+#include <memory>
+#include <vector>
+#include "int8_gemm.hpp"
+#include "winograd.hpp"
+
+struct layer;
+
+namespace yolo::internal
+{
+	struct int8_convolution;
+
+	/// what the overridden convolutions of a network use besides their layer, by layer index ( nullptr for the layers that do not use it ).
+	/// owned by the network, a replica that shares the weights shares these as well
+	struct convolution_data
+	{
+		std::vector<std::shared_ptr<const winograd_filters>> 	winograd;
+		std::vector<std::shared_ptr<const int8_convolution>> 	int8;
+	};
+
+	/// darknet only passes a layer and the network state to a forward pass, so the overridden convolutions that run on the calling thread
+	/// find their 'convolution_data' here, while this lives. without a scope they fall back to the im2col / gemm pass
+	class convolution_scope
+	{
+		public:
+			explicit convolution_scope(const convolution_data& data);
+			~convolution_scope();
+
+			convolution_scope(const convolution_scope&) = delete;
+			convolution_scope& operator=(const convolution_scope&) = delete;
+
+		private:
+			const convolution_data* m_p_previous;
+	};
+
+	/// replaces the forward pass of a [convolutional] layer with one that runs on 'gemm' instead of darknet's gemm ( inference only, training keeps darknet's passes ).
+	/// 1x1 convolutions with stride 1 use the activations as they are, without im2col.
+	/// 3x3 convolutions with stride 1 use Winograd F(2x2, 3x3) in the forward pass, with filters that are transformed here ( so only call this once the weights are loaded ),
+	/// unless 'data' has them for the layer already.
+	/// \param layer_index of 'l' in its network
+	/// \param data of the network, gets what the layer uses from now on
+	/// \return false if the layer uses options that are not supported ( binary / xnor weights, antialiasing, ... ), in which case it keeps darknet's passes
+	bool override_convolution(layer& l, uint32_t layer_index, convolution_data& data);
+
+	/// \return true if 'override_convolution' accepts the layer ( only looks at the layer options, not at the weights )
+	bool can_override_convolution(const layer& l);
+
+	/// makes the convolution before the [shortcut] 'shortcut' add the residual in its epilogue ( bias, activation and residual in a single pass while the output is in cache ).
+	/// the shortcut's own forward pass does nothing from now on, so its output must be the output of the convolution before it,
+	/// which must be overridden ( see 'can_override_convolution' ), and must not be read by anything else.
+	void fuse_shortcut(layer& shortcut);
+
+	/// int8 weights of a convolution, and the scale its ( float ) input is quantized with
+	struct int8_convolution
+	{
+		float 			input_scale = 1.0f;
+		int8_weights 	weights;
+	};
+
+	/// \return true if 'quantize_convolution' accepts the layer ( an overridden convolution with the batchnorm folded into the weights, without groups or dilation )
+	bool can_quantize_convolution(const layer& l);
+
+	/// \return true if 'quantize_convolution' accepts the layer with the given weights ( their shape matches the layer )
+	bool can_quantize_convolution(const layer& l, const int8_convolution& convolution);
+
+	/// runs the forward pass of the convolution on 'int8_gemm': the input is quantized to uint8 while it is laid out in columns, and the output is dequantized to float again.
+	/// \param data of the network, keeps 'convolution' for the layer
+	/// \return false if 'can_quantize_convolution' does not accept the layer, in which case it is left as it is
+	bool quantize_convolution(layer& l, uint32_t layer_index, const std::shared_ptr<const int8_convolution>& convolution, convolution_data& data);
+}
+
+#endif //ALL_YOLO_CONVOLUTION_HPP
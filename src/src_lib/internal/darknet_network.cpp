@@ -0,0 +1,940 @@
+#include <darknet.h>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <optional>
+#include <algorithm>
+#include <limits>
+#include "darknet_network.hpp"
+#include "internal.hpp"
+#include "preprocess.hpp"
+#include "mapped_file.hpp"
+#include "activation_planner.hpp"
+#include "convolution.hpp"
+#include "elementwise.hpp"
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	/// the logistic of the [yolo] layers is done while decoding ( only for the cells that pass the threshold )
+	static void forward_yolo_layer_skip(layer, network_state)
+	{
+	}
+
+	/// layers that none of the selected [yolo] heads depend on ( see 'select_heads' )
+	static void forward_unused_layer_skip(layer, network_state)
+	{
+	}
+
+	darknet_network::darknet_network(::network* p_network)
+		: m_p_network(p_network)
+	{
+		m_input.resize((size_t)batch() * width() * height() * channels(), 0.0f);
+		share_activations();
+
+		for(int i=1; i<m_p_network->n; i++)
+		{
+			layer& l = m_p_network->layers[i];
+			if(l.type != YOLO)
+			{
+				continue;
+			}
+			l.forward = forward_yolo_layer_skip;
+			borrow(l.output, m_p_network->layers[i-1].output);
+
+			yolo_head head = {
+					.p_output 	= l.output,
+					.outputs 	= (uint32_t)l.outputs,
+					.width 		= (uint32_t)l.w,
+					.height 	= (uint32_t)l.h,
+					.classes 	= (uint32_t)l.classes,
+					.scale_x_y 	= l.scale_x_y,
+					.anchors 	= {}
+			};
+			for(int n=0; n<l.n; n++)
+			{
+				const int anchor = l.mask != nullptr ? l.mask[n] : n;
+				head.anchors.emplace_back(l.biases[2*anchor], l.biases[2*anchor + 1]);
+			}
+			m_heads.push_back(std::move(head));
+		}
+	}
+
+	/// the inputs of the [route] layer are written straight into its output
+	static void forward_route_layer_skip(layer, network_state)
+	{
+	}
+
+	void darknet_network::share_activations()
+	{
+		const int n = m_p_network->n;
+		for(int i=0; i<n; i++)
+		{
+			switch(m_p_network->layers[i].type)
+			{
+				case CONVOLUTIONAL:
+				case ROUTE:
+				case SHORTCUT:
+				case UPSAMPLE:
+				case MAXPOOL:
+				case YOLO:
+					break;
+				default:
+					return; // might keep pointers to outputs the planner does not know about
+			}
+		}
+
+		// the output of a layer is read by the next one, and by the [route] and [shortcut] layers that refer to it.
+		// the outputs the [yolo] layers decode, and the network output, are read after the forward pass, so they keep their own buffer.
+		std::vector<uint32_t> last_use(n, 0);
+		std::vector<bool> keep_own(n, false);
+		for(int i=0; i<n; i++)
+		{
+			const layer& l = m_p_network->layers[i];
+			last_use[i] = (uint32_t)std::min(i + 1, n - 1);
+			if(l.type == ROUTE || l.type == SHORTCUT)
+			{
+				for(int j=0; j<l.n; j++)
+				{
+					const int index = l.input_layers[j];
+					last_use[index] = std::max(last_use[index], (uint32_t)i);
+				}
+			}
+			if(l.type == YOLO)
+			{
+				keep_own[i] = true;
+				keep_own[i-1] = true;
+			}
+		}
+		keep_own[n-1] = true;
+
+		// [route] layers do not copy: a single input is used as it is, and the inputs of a concatenation write into their channel slice of its output.
+		// with more than one image per batch the slices are interleaved per image, so concatenations are only done in place for batch 1.
+		// 'parent' / 'offset' point a layer's output into the output of another layer.
+		std::vector<int> parent(n);
+		std::vector<size_t> offset(n, 0);
+		std::vector<bool> is_in_slice(n, false);
+		for(int i=0; i<n; i++)
+		{
+			parent[i] = i;
+		}
+		auto root = [&](int index)
+		{
+			while(parent[index] != index)
+			{
+				index = parent[index];
+			}
+			return index;
+		};
+
+		// a [shortcut] right after a convolution is added by the epilogue of that convolution, in its output
+		for(int i=1; i<n; i++)
+		{
+			layer& l = m_p_network->layers[i];
+			const layer& previous = m_p_network->layers[i-1];
+			if(l.type != SHORTCUT || l.n != 1 || l.nweights != 0 || l.activation != LINEAR || l.outputs != previous.outputs || l.input_sizes[0] != l.outputs)
+			{
+				continue;
+			}
+			if(!can_override_convolution(previous) || keep_own[i-1] || last_use[i-1] != (uint32_t)i || l.input_layers[0] == i-1)
+			{
+				continue;
+			}
+			parent[i] = i-1;
+			fuse_shortcut(l);
+		}
+
+		for(int i=0; i<n; i++)
+		{
+			layer& l = m_p_network->layers[i];
+			if(l.type != ROUTE || l.groups > 1 || l.output == nullptr)
+			{
+				continue;
+			}
+			if(l.n == 1)
+			{
+				const int index = l.input_layers[0];
+				if(m_p_network->layers[index].outputs != l.outputs)
+				{
+					continue;
+				}
+				parent[i] = index;
+			}
+			else
+			{
+				if(l.batch != 1 || keep_own[i])
+				{
+					continue;
+				}
+				// the input may share the output of another layer ( a single input [route], or a fused [shortcut] ), then that one is placed in the slice
+				bool can_slice = true;
+				std::vector<int> roots;
+				for(int j=0; j<l.n; j++)
+				{
+					int index = l.input_layers[j];
+					const int input_root = root(index);
+					for(; index != input_root; index = parent[index])
+					{
+						can_slice = can_slice && !is_in_slice[index] && !keep_own[index];
+					}
+					can_slice = can_slice && !keep_own[input_root] && m_p_network->layers[input_root].outputs == l.input_sizes[j];
+					can_slice = can_slice && std::find(roots.begin(), roots.end(), input_root) == roots.end();
+					roots.push_back(input_root);
+				}
+				if(!can_slice)
+				{
+					continue;
+				}
+				size_t slice_offset = 0;
+				for(int j=0; j<l.n; j++)
+				{
+					const int index = roots[j];
+					parent[index] = i;
+					offset[index] = slice_offset;
+					is_in_slice[index] = true;
+					slice_offset += (size_t)l.input_sizes[j];
+				}
+			}
+			l.forward = forward_route_layer_skip;
+		}
+
+		// layers that share a buffer, by the layer that owns it
+		std::vector<int> owner(n);
+		for(int i=0; i<n; i++)
+		{
+			int index = i;
+			size_t total_offset = 0;
+			while(parent[index] != index)
+			{
+				total_offset += offset[index];
+				index = parent[index];
+			}
+			owner[i] = index;
+			offset[i] = total_offset;
+		}
+		std::vector<uint32_t> first_use(n, std::numeric_limits<uint32_t>::max());
+		for(int i=0; i<n; i++)
+		{
+			const int o = owner[i];
+			first_use[o] = std::min(first_use[o], (uint32_t)i);
+			last_use[o] = std::max(last_use[o], last_use[i]);
+			keep_own[o] = keep_own[o] || keep_own[i];
+		}
+
+		std::vector<activation_interval> intervals;
+		std::vector<int> interval_owners;
+		std::vector<size_t> owner_order;
+		for(int i=0; i<n; i++)
+		{
+			if(owner[i] == i)
+			{
+				owner_order.push_back((size_t)i);
+			}
+		}
+		std::sort(owner_order.begin(), owner_order.end(), [&](size_t a, size_t b) { return first_use[a] < first_use[b]; });
+		for(size_t i : owner_order)
+		{
+			const layer& l = m_p_network->layers[i];
+			if(keep_own[i] || l.output == nullptr)
+			{
+				continue;
+			}
+			intervals.push_back({.num_floats = (size_t)l.outputs * l.batch, .first_use = first_use[i], .last_use = last_use[i]});
+			interval_owners.push_back((int)i);
+		}
+
+		const auto plan = plan_activations(intervals);
+		m_activations.assign(plan.num_floats, 0.0f);
+		std::vector<float*> buffers(n, nullptr);
+		for(int i=0; i<n; i++)
+		{
+			buffers[i] = m_p_network->layers[i].output;
+		}
+		for(size_t k=0; k<interval_owners.size(); k++)
+		{
+			buffers[interval_owners[k]] = m_activations.data() + plan.offsets[k];
+		}
+		for(int i=0; i<n; i++)
+		{
+			layer& l = m_p_network->layers[i];
+			float* p_output = buffers[owner[i]] + offset[i];
+			if(l.output != nullptr && p_output != l.output)
+			{
+				borrow(l.output, p_output);
+			}
+		}
+
+		// [shortcut] keeps pointers to the outputs it adds, taken while parsing
+		for(int i=0; i<n; i++)
+		{
+			layer& l = m_p_network->layers[i];
+			if(l.type != SHORTCUT || l.layers_output == nullptr)
+			{
+				continue;
+			}
+			for(int j=0; j<l.n; j++)
+			{
+				l.layers_output[j] = m_p_network->layers[l.input_layers[j]].output;
+			}
+		}
+	}
+
+	darknet_network::~darknet_network()
+	{
+		for(float** p_field : m_borrowed)
+		{
+			*p_field = nullptr;
+		}
+		free_network_ptr(m_p_network);
+	}
+
+	static ::network* parse_network(const cfg::cfg& model_cfg)
+	{
+		// darknet only parses from file
+		const std::filesystem::path cfg_filepath = generate_unique_temp_filename("model", "cfg");
+		if(!model_cfg.save(cfg_filepath))
+		{
+			return nullptr;
+		}
+		std::string cfg_filepath_str = cfg_filepath.string();
+
+		auto* p_network = (::network*)xcalloc(1, sizeof(::network));
+		*p_network = parse_network_cfg_custom(cfg_filepath_str.data(), 0, 1);
+		std::filesystem::remove(cfg_filepath);
+		if(p_network->n <= 0)
+		{
+			log("Failed to parse the network cfg");
+			free_network_ptr(p_network);
+			return nullptr;
+		}
+		return p_network;
+	}
+
+	std::unique_ptr<darknet_network> darknet_network::load(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath)
+	{
+		if(!std::filesystem::exists(weights_filepath))
+		{
+			log("Failed to find weights '" + weights_filepath.string() + "'");
+			return nullptr;
+		}
+
+		auto* p_network = parse_network(model_cfg);
+		if(p_network == nullptr)
+		{
+			return nullptr;
+		}
+		auto p_result = std::unique_ptr<darknet_network>(new darknet_network(p_network));
+		if(!p_result->map_weights(weights_filepath))
+		{
+			log("Loading '" + weights_filepath.string() + "' without memory mapping");
+			std::string weights_filepath_str = weights_filepath.string();
+			load_weights(p_network, weights_filepath_str.data());
+			fuse_conv_batchnorm(*p_network);
+		}
+		p_result->prepare_convolutions();
+		return p_result;
+	}
+
+	/// layers without any weights in the weights file
+	static bool has_no_weights(const layer& l)
+	{
+		switch(l.type)
+		{
+			case ROUTE:
+			case UPSAMPLE:
+			case MAXPOOL:
+			case YOLO:
+			case REORG:
+			case DROPOUT:
+			case COST:
+			case AVGPOOL:
+			case SOFTMAX:
+				return true;
+			case SHORTCUT:
+				return l.nweights == 0;
+			default:
+				return false;
+		}
+	}
+
+	/// byte offsets of the arrays of a convolutional layer in a .weights file
+	struct conv_offsets
+	{
+		int 	layer_index;
+		size_t 	biases;
+		size_t 	batchnorm;
+		size_t 	weights;
+	};
+
+	/// \return std::nullopt if the weights can not be used as they are on disk
+	static std::optional<std::vector<conv_offsets>> find_conv_offsets(const ::network& network, const mapped_file& file)
+	{
+		// header, same as darknet's 'load_weights_upto'
+		int32_t version[3] = {0, 0, 0};
+		if(file.size() < sizeof(version))
+		{
+			return std::nullopt;
+		}
+		memcpy(version, file.data(), sizeof(version));
+		const int32_t major = version[0];
+		const int32_t minor = version[1];
+		if(major > 1000 || minor > 1000)
+		{
+			return std::nullopt; // transposed weights
+		}
+		size_t offset = sizeof(version) + (((major * 10 + minor) >= 2) ? sizeof(uint64_t) : sizeof(int32_t));
+
+		std::vector<conv_offsets> convs;
+		for(int i=0; i<network.n; i++)
+		{
+			const layer& l = network.layers[i];
+			if(l.dontload)
+			{
+				continue;
+			}
+			if(l.type != CONVOLUTIONAL)
+			{
+				if(!has_no_weights(l))
+				{
+					return std::nullopt;
+				}
+				continue;
+			}
+			if(l.binary || l.xnor || l.flipped || (l.batch_normalize && l.dontloadscales))
+			{
+				return std::nullopt;
+			}
+			conv_offsets v = { .layer_index = i, .biases = offset, .batchnorm = 0, .weights = 0 };
+			offset += (size_t)l.n * sizeof(float);
+			if(l.batch_normalize)
+			{
+				v.batchnorm = offset;
+				offset += (size_t)l.n * 3 * sizeof(float);
+			}
+			v.weights = offset;
+			offset += (size_t)l.nweights * sizeof(float);
+			convs.push_back(v);
+		}
+		if(offset > file.size())
+		{
+			log("The weights file is smaller than the network expects");
+			return std::nullopt;
+		}
+		return convs;
+	}
+
+	/// header of the fused weights file, followed by the biases and weights of each convolutional layer
+	struct fused_header
+	{
+		char 		magic[8];
+		uint64_t 	key; 			// 'fused_key' of the weights file and layers it was made from
+		uint64_t 	shapes_key; 	// 'shapes_key' of the layers
+		uint64_t 	weights_size; 	// size and modification time of the weights file. while these match, the file is not read to check 'key'
+		int64_t 	weights_time;
+		uint64_t 	num_floats;
+	};
+	static constexpr char s_fused_magic[8] = {'y', 'o', 'l', 'o', 'f', 'u', 's', '2'};
+
+	static uint64_t mix(uint64_t hash, uint64_t value)
+	{
+		hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+		return hash * 0xff51afd7ed558ccdull;
+	}
+
+	/// hash of the shapes of the layers the weights are loaded into
+	static uint64_t shapes_key(const ::network& network, const std::vector<conv_offsets>& convs)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		for(const auto& v : convs)
+		{
+			const layer& l = network.layers[v.layer_index];
+			hash = mix(hash, (uint64_t)v.layer_index);
+			hash = mix(hash, (uint64_t)l.n);
+			hash = mix(hash, (uint64_t)l.nweights);
+			hash = mix(hash, (uint64_t)l.batch_normalize);
+		}
+		return hash;
+	}
+
+	/// hash of the weights file contents, on top of 'shapes_key'. reads all of the file
+	static uint64_t fused_key(uint64_t shapes_key, const mapped_file& file)
+	{
+		uint64_t hash = shapes_key;
+		const size_t num_words = file.size() / sizeof(uint64_t);
+		for(size_t i=0; i<num_words; i++)
+		{
+			uint64_t word;
+			memcpy(&word, file.data() + i * sizeof(uint64_t), sizeof(word));
+			hash = mix(hash, word);
+		}
+		for(size_t i=num_words * sizeof(uint64_t); i<file.size(); i++)
+		{
+			hash = mix(hash, file.data()[i]);
+		}
+		return hash;
+	}
+
+	static size_t fused_num_floats(const ::network& network, const std::vector<conv_offsets>& convs)
+	{
+		size_t num_floats = 0;
+		for(const auto& v : convs)
+		{
+			const layer& l = network.layers[v.layer_index];
+			num_floats += (size_t)l.n + (size_t)l.nweights;
+		}
+		return num_floats;
+	}
+
+	/// folds the batchnorm into the weights and biases, the same way darknet's 'fuse_conv_batchnorm' does
+	static std::vector<float> fuse_batchnorm(const ::network& network, const std::vector<conv_offsets>& convs, const mapped_file& file)
+	{
+		auto p = [&](size_t byte_offset) { return (const float*)(file.data() + byte_offset); };
+
+		std::vector<float> fused(fused_num_floats(network, convs));
+		float* p_target = fused.data();
+		for(const auto& v : convs)
+		{
+			const layer& l = network.layers[v.layer_index];
+			const size_t filter_size = (size_t)l.nweights / (size_t)l.n;
+			float* p_biases = p_target;
+			float* p_weights = p_target + l.n;
+			memcpy(p_biases, p(v.biases), (size_t)l.n * sizeof(float));
+			memcpy(p_weights, p(v.weights), (size_t)l.nweights * sizeof(float));
+			if(l.batch_normalize)
+			{
+				const float* p_scales = p(v.batchnorm);
+				const float* p_rolling_mean = p_scales + l.n;
+				const float* p_rolling_variance = p_rolling_mean + l.n;
+				for(int f=0; f<l.n; f++)
+				{
+					const float precomputed = p_scales[f] / sqrtf(p_rolling_variance[f] + .00001f);
+					p_biases[f] = p_biases[f] - p_rolling_mean[f] * precomputed;
+					float* p_filter = p_weights + (size_t)f * filter_size;
+					for(size_t i=0; i<filter_size; i++)
+					{
+						p_filter[i] *= precomputed;
+					}
+				}
+			}
+			p_target += l.n + l.nweights;
+		}
+		return fused;
+	}
+
+	/// writes to a temporary file next to 'filepath' first, so other processes never map a partially written file
+	static bool write_fused(const std::filesystem::path& filepath, const fused_header& header, const float* p_fused)
+	{
+		std::filesystem::path tmp_filepath = filepath;
+		tmp_filepath += generate_unique_temp_filename("", "tmp").filename();
+		{
+			std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+			file.write((const char*)&header, sizeof(header));
+			file.write((const char*)p_fused, (std::streamsize)(header.num_floats * sizeof(float)));
+			if(!file.good())
+			{
+				std::error_code ec;
+				std::filesystem::remove(tmp_filepath, ec);
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tmp_filepath, filepath, ec);
+		if(ec)
+		{
+			std::filesystem::remove(tmp_filepath, ec);
+			return false;
+		}
+		return true;
+	}
+
+	/// \param header the layers to match: 'shapes_key' and 'num_floats'
+	/// \param p_target receives the header of the file
+	/// \return nullptr if there is no fused weights file for the layers
+	static std::shared_ptr<mapped_file> open_fused(const std::filesystem::path& filepath, const fused_header& header, fused_header* p_target)
+	{
+		if(!std::filesystem::exists(filepath))
+		{
+			return nullptr;
+		}
+		auto p_file = mapped_file::open(filepath);
+		if(p_file == nullptr || p_file->size() != sizeof(fused_header) + header.num_floats * sizeof(float))
+		{
+			return nullptr;
+		}
+		memcpy(p_target, p_file->data(), sizeof(fused_header));
+		if(memcmp(p_target->magic, s_fused_magic, sizeof(s_fused_magic)) != 0 || p_target->shapes_key != header.shapes_key || p_target->num_floats != header.num_floats)
+		{
+			return nullptr;
+		}
+		return p_file;
+	}
+
+	bool darknet_network::map_weights(const std::filesystem::path& weights_filepath)
+	{
+		auto p_weights = mapped_file::open(weights_filepath);
+		if(p_weights == nullptr)
+		{
+			return false;
+		}
+		const auto convs = find_conv_offsets(*m_p_network, *p_weights);
+		if(!convs.has_value())
+		{
+			return false;
+		}
+
+		// the batchnorm folded into the weights is cached next to them, so it only needs to be done once per weights file. while the size and the
+		// modification time of the weights file match the cache, its key is taken from the cache as well, so the weights are not read at all
+		std::error_code ec;
+		const auto weights_time = std::filesystem::last_write_time(weights_filepath, ec);
+		fused_header header = {
+			.magic 			= {},
+			.key 			= 0,
+			.shapes_key 	= shapes_key(*m_p_network, *convs),
+			.weights_size 	= p_weights->size(),
+			.weights_time 	= ec ? 0 : (int64_t)weights_time.time_since_epoch().count(),
+			.num_floats 	= fused_num_floats(*m_p_network, *convs)
+		};
+		memcpy(header.magic, s_fused_magic, sizeof(s_fused_magic));
+		std::filesystem::path fused_filepath = weights_filepath;
+		fused_filepath += ".fused";
+
+		const float* p_fused = nullptr;
+		fused_header cached = {};
+		auto p_fused_file = open_fused(fused_filepath, header, &cached);
+		const bool is_same_file = p_fused_file != nullptr && cached.weights_size == header.weights_size && cached.weights_time == header.weights_time;
+		header.key = is_same_file ? cached.key : fused_key(header.shapes_key, *p_weights);
+		if(p_fused_file != nullptr && cached.key == header.key)
+		{
+			p_fused = (const float*)(p_fused_file->data() + sizeof(fused_header));
+			if(!is_same_file)
+			{
+				// copied or touched, but the same weights: the cache gets the new time, so the next load does not read them again
+				write_fused(fused_filepath, header, p_fused);
+			}
+			m_borrowed_owners.push_back(std::move(p_fused_file));
+		}
+		else
+		{
+			auto p_fused_data = std::make_shared<std::vector<float>>(fuse_batchnorm(*m_p_network, *convs, *p_weights));
+			if(write_fused(fused_filepath, header, p_fused_data->data()) && (p_fused_file = open_fused(fused_filepath, header, &cached)) != nullptr && cached.key == header.key)
+			{
+				p_fused = (const float*)(p_fused_file->data() + sizeof(fused_header));
+				m_borrowed_owners.push_back(std::move(p_fused_file));
+			}
+			else
+			{
+				log("Failed to write '" + fused_filepath.string() + "', the fused weights are not shared with other processes");
+				p_fused = p_fused_data->data();
+				m_borrowed_owners.push_back(std::move(p_fused_data));
+			}
+		}
+		m_weights_key = header.key;
+
+		// point the layers into the fused weights. they are read-only, which is fine as inference never writes to the weights
+		for(const auto& v : *convs)
+		{
+			layer& l = m_p_network->layers[v.layer_index];
+			borrow(l.biases, (float*)p_fused);
+			borrow(l.weights, (float*)p_fused + l.n);
+			l.batch_normalize = 0;
+			p_fused += l.n + l.nweights;
+		}
+		return true;
+	}
+
+	std::unique_ptr<darknet_network> darknet_network::load_replica(const cfg::cfg& model_cfg, const std::shared_ptr<const darknet_network>& source, bool copy_weights)
+	{
+		auto* p_network = parse_network(model_cfg);
+		if(p_network == nullptr)
+		{
+			return nullptr;
+		}
+		if(p_network->n != source->m_p_network->n)
+		{
+			log("Failed to create replica: the cfg does not match the source network");
+			free_network_ptr(p_network);
+			return nullptr;
+		}
+
+		auto p_replica = std::unique_ptr<darknet_network>(new darknet_network(p_network));
+		p_replica->m_weights_key = source->m_weights_key;
+		for(int i=0; i<p_network->n; i++)
+		{
+			const layer& l = p_network->layers[i];
+			const layer& src = source->m_p_network->layers[i];
+			if(l.type == CONVOLUTIONAL && (l.nweights != src.nweights || l.n != src.n))
+			{
+				log("Failed to create replica: layer " + std::to_string(i) + " does not match the source network");
+				return nullptr;
+			}
+		}
+
+		// the copy is a single block, filled layer by layer in the same order as it is borrowed below
+		std::shared_ptr<std::vector<float>> p_copy;
+		if(copy_weights)
+		{
+			p_copy = std::make_shared<std::vector<float>>();
+			for(int i=0; i<p_network->n; i++)
+			{
+				const layer& src = source->m_p_network->layers[i];
+				if(src.type == CONVOLUTIONAL)
+				{
+					p_copy->insert(p_copy->end(), src.weights, src.weights + src.nweights);
+					p_copy->insert(p_copy->end(), src.biases, src.biases + src.n);
+					if(src.batch_normalize)
+					{
+						p_copy->insert(p_copy->end(), src.scales, src.scales + src.n);
+						p_copy->insert(p_copy->end(), src.rolling_mean, src.rolling_mean + src.n);
+						p_copy->insert(p_copy->end(), src.rolling_variance, src.rolling_variance + src.n);
+					}
+				}
+			}
+			p_replica->m_borrowed_owners.push_back(p_copy);
+		}
+		else
+		{
+			p_replica->m_borrowed_owners.push_back(source);
+			p_replica->m_convolutions = source->m_convolutions; // the same weights, so the same Winograd filters
+		}
+
+		float* p_next = p_copy != nullptr ? p_copy->data() : nullptr;
+		auto borrow = [&](float*& field, float* p_source, int count)
+		{
+			if(p_next == nullptr)
+			{
+				p_replica->borrow(field, p_source);
+				return;
+			}
+			p_replica->borrow(field, p_next);
+			p_next += count;
+		};
+		for(int i=0; i<p_network->n; i++)
+		{
+			layer& l = p_network->layers[i];
+			const layer& src = source->m_p_network->layers[i];
+			if(l.type != CONVOLUTIONAL)
+			{
+				continue;
+			}
+			l.batch_normalize = src.batch_normalize; // the source has its batchnorm fused into the weights
+			borrow(l.weights, src.weights, l.nweights);
+			borrow(l.biases, src.biases, l.n);
+			if(src.batch_normalize || p_next == nullptr)
+			{
+				borrow(l.scales, src.scales, l.n);
+				borrow(l.rolling_mean, src.rolling_mean, l.n);
+				borrow(l.rolling_variance, src.rolling_variance, l.n);
+			}
+		}
+		p_replica->prepare_convolutions();
+		return p_replica;
+	}
+
+	void darknet_network::prepare_convolutions()
+	{
+		for(int i=0; i<m_p_network->n; i++)
+		{
+			override_convolution(m_p_network->layers[i], (uint32_t)i, m_convolutions);
+			override_elementwise_layer(m_p_network->layers[i]);
+		}
+	}
+
+	void darknet_network::borrow(float*& field, float* data)
+	{
+		if(data == nullptr)
+		{
+			return;
+		}
+		free(field);
+		field = data;
+		m_borrowed.push_back(&field);
+	}
+
+	uint32_t darknet_network::width() const
+	{
+		return (uint32_t)m_p_network->w;
+	}
+
+	uint32_t darknet_network::height() const
+	{
+		return (uint32_t)m_p_network->h;
+	}
+
+	uint32_t darknet_network::channels() const
+	{
+		return (uint32_t)m_p_network->c;
+	}
+
+	uint32_t darknet_network::batch() const
+	{
+		return (uint32_t)m_p_network->batch;
+	}
+
+	float* darknet_network::input(uint32_t batch_index)
+	{
+		return &m_input[(size_t)batch_index * width() * height() * channels()];
+	}
+
+	void darknet_network::set_input(const image& source, bool letter_box, uint32_t batch_index)
+	{
+		to_network_input(source.data.data(), source.width_px, source.height_px, input(batch_index), width(), height(), letter_box);
+	}
+
+	void darknet_network::predict()
+	{
+		convolution_scope scope(m_convolutions);
+		network_predict_ptr(m_p_network, m_input.data());
+	}
+
+	void darknet_network::predict(const layer_observer& observer)
+	{
+		// same as darknet's 'forward_network'
+		convolution_scope scope(m_convolutions);
+		network_state state = {};
+		state.net = *m_p_network;
+		state.index = 0;
+		state.input = m_input.data();
+		state.truth = nullptr;
+		state.train = 0;
+		state.delta = nullptr;
+		state.workspace = m_p_network->workspace;
+		for(int i=0; i<m_p_network->n; i++)
+		{
+			state.index = i;
+			layer& l = m_p_network->layers[i];
+			observer((uint32_t)i, l, state.input);
+			l.forward(l, state);
+			state.input = l.output;
+		}
+	}
+
+	const ::network& darknet_network::darknet() const
+	{
+		return *m_p_network;
+	}
+
+	uint64_t darknet_network::weights_key() const
+	{
+		return m_weights_key;
+	}
+
+	bool darknet_network::use_int8(const int8_model& model)
+	{
+		if(m_weights_key == 0 || model.weights_key != m_weights_key)
+		{
+			log("The int8 model was made for other weights");
+			return false;
+		}
+		for(const auto& v : model.layers)
+		{
+			if(v.layer_index >= (uint32_t)m_p_network->n || !can_quantize_convolution(m_p_network->layers[v.layer_index], *v.p_convolution))
+			{
+				log("The int8 model does not match layer " + std::to_string(v.layer_index));
+				return false;
+			}
+		}
+		for(const auto& v : model.layers)
+		{
+			if(m_p_network->layers[v.layer_index].forward != forward_unused_layer_skip)
+			{
+				quantize_convolution(m_p_network->layers[v.layer_index], v.layer_index, v.p_convolution, m_convolutions);
+			}
+		}
+		return true;
+	}
+
+	bool darknet_network::select_heads(const std::vector<uint32_t>& heads)
+	{
+		const int n = m_p_network->n;
+		std::vector<int> yolo_layers;
+		for(int i=0; i<n; i++)
+		{
+			if(m_p_network->layers[i].type == YOLO)
+			{
+				yolo_layers.push_back(i);
+			}
+		}
+		if(heads.empty())
+		{
+			log("No [yolo] heads selected");
+			return false;
+		}
+		std::vector<bool> is_used(n, false);
+		for(uint32_t head : heads)
+		{
+			if(head >= yolo_layers.size() || head >= m_heads.size())
+			{
+				log("The network has no [yolo] head " + std::to_string(head) + " ( it has " + std::to_string(yolo_layers.size()) + " )");
+				return false;
+			}
+			is_used[yolo_layers[head]] = true;
+		}
+
+		// a layer reads the output of the one before it, except for [route], which only reads its inputs. [shortcut] reads both
+		for(int i=n-1; i>=0; i--)
+		{
+			const layer& l = m_p_network->layers[i];
+			if(!is_used[i])
+			{
+				continue;
+			}
+			if(l.type == ROUTE || l.type == SHORTCUT)
+			{
+				for(int j=0; j<l.n; j++)
+				{
+					is_used[l.input_layers[j]] = true;
+				}
+			}
+			if(l.type != ROUTE && i > 0)
+			{
+				is_used[i-1] = true;
+			}
+		}
+
+		float bflops_skipped = 0.0f, bflops_total = 0.0f;
+		for(int i=0; i<n; i++)
+		{
+			layer& l = m_p_network->layers[i];
+			bflops_total += l.bflops;
+			if(!is_used[i])
+			{
+				l.forward = forward_unused_layer_skip;
+				bflops_skipped += l.bflops;
+			}
+		}
+
+		std::vector<yolo_head> selected;
+		for(uint32_t i=0; i<m_heads.size(); i++)
+		{
+			if(std::find(heads.begin(), heads.end(), i) != heads.end())
+			{
+				selected.push_back(std::move(m_heads[i]));
+			}
+		}
+		m_heads = std::move(selected);
+		log("Running " + std::to_string(m_heads.size()) + " of " + std::to_string(yolo_layers.size()) + " [yolo] heads, skipping " + std::to_string(bflops_skipped) + " of " + std::to_string(bflops_total) + " BFLOPs");
+		return true;
+	}
+
+	void darknet_network::decode(const std::pair<uint32_t, uint32_t>& source_size, const box_args& args, box_candidates& target, uint32_t batch_index) const
+	{
+		const decode_args decode_args = {
+				.network_size 	= {width(), height()},
+				.source_size 	= source_size,
+				.letter_box 	= args.letter_box,
+				.thresh 		= args.thresh
+		};
+		decode_yolo_heads(m_heads, batch_index, decode_args, target);
+	}
+
+	void darknet_network::get_detections(const std::pair<uint32_t, uint32_t>& source_size, const box_args& args, std::vector<detection>& target, uint32_t batch_index)
+	{
+		decode(source_size, args, m_candidates, batch_index);
+		nms(m_candidates, args.nms_thresh);
+		to_detections(m_candidates, target);
+	}
+}
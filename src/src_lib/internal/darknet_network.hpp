@@ -0,0 +1,123 @@
+#ifndef ALL_YOLO_DARKNET_NETWORK_HPP
+#define ALL_YOLO_DARKNET_NETWORK_HPP
+
+#include <memory>
+#include <vector>
+#include <filesystem>
+#include <functional>
+#include <yolo.hpp>
+#include "cfg.hpp"
+#include "yolo_decode.hpp"
+#include "quantization.hpp"
+#include "convolution.hpp"
+
+struct network;
+struct layer;
+
+namespace yolo::internal
+{
+	struct box_args
+	{
+		float thresh = 0.25f;
+		float nms_thresh = 0.45f;
+		bool letter_box = false;
+	};
+
+	/// darknet network that is parsed and loaded once, and kept in memory for inference.
+	/// Not thread safe.
+	class darknet_network
+	{
+		public:
+			~darknet_network();
+
+			/// Inference only: the batchnorm is folded into the weights and biases of the convolutional layers. The fused weights are cached in '<weights>.fused'
+			/// ( keyed by a hash of the weights, which is only taken again when their size or modification time changed ), which is memory mapped read-only, so processes that load the same weights share the memory.
+			/// Falls back to darknet's 'load_weights' ( which copies the weights ) if the file layout does not allow mapping.
+			/// \param model_cfg a 'testing' cfg ( see 's_cfg_yolov3' )
+			/// \return nullptr if parsing the cfg or loading the weights failed
+			static std::unique_ptr<darknet_network> load(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath);
+
+			/// creates a network with its own activations, but that uses the ( read-only ) weights of 'source'
+			/// \param model_cfg must describe the same layers as the cfg 'source' was loaded with ( the batch size may differ )
+			/// \param copy_weights gives the replica its own copy of the weights, allocated by the calling thread ( so it ends up on the NUMA node that thread runs on )
+			static std::unique_ptr<darknet_network> load_replica(const cfg::cfg& model_cfg, const std::shared_ptr<const darknet_network>& source, bool copy_weights = false);
+
+			[[nodiscard]] uint32_t 	width() const;
+			[[nodiscard]] uint32_t 	height() const;
+			[[nodiscard]] uint32_t 	channels() const;
+			[[nodiscard]] uint32_t 	batch() const;
+
+									/// planar input of the network for the given batch item ( channels * height * width floats, range 0 - 1 )
+			[[nodiscard]] float* 	input(uint32_t batch_index = 0);
+
+									/// scales 'source' to the network size, and writes it to the input of the given batch item
+			void 					set_input(const image& source, bool letter_box, uint32_t batch_index = 0);
+
+									/// runs the forward pass over the whole input
+			void 					predict();
+
+									/// called right before the forward pass of each layer, with the input of that layer
+			using layer_observer = std::function<void(uint32_t layer_index, const ::layer& l, const float* p_input)>;
+
+									/// same as 'predict', but lets 'observer' look at the input of every layer ( used to calibrate the quantization )
+			void 					predict(const layer_observer& observer);
+
+									/// the underlying darknet network, to inspect the layers
+			[[nodiscard]] const ::network& darknet() const;
+
+									/// hash of the weights file and the layers it was loaded into. 0 if the weights were not memory mapped ( see 'load' )
+			[[nodiscard]] uint64_t 	weights_key() const;
+
+									/// runs the convolutions of 'model' in int8 ( see 'quantize_convolution' ), except the ones 'select_heads' skips
+									/// \return false if the model was made for other weights, or does not match the layers, in which case nothing is changed
+			bool 					use_int8(const int8_model& model);
+
+									/// only runs the [yolo] layers in 'heads' ( indices in cfg order ), and the layers they depend on. The other layers are skipped from then on.
+									/// done once, after loading ( and before 'use_int8' )
+									/// \return false if 'heads' is empty or a head does not exist, in which case nothing is changed
+			bool 					select_heads(const std::vector<uint32_t>& heads);
+
+									/// the first half of 'get_detections': decodes the boxes above the threshold, without the non maximum suppression ( see 'nms' )
+									/// \param source_size size ( width, height ) of the image that was passed to 'set_input'
+			void 					decode(const std::pair<uint32_t, uint32_t>& source_size, const box_args& args, box_candidates& target, uint32_t batch_index = 0) const;
+
+									/// \param source_size size ( width, height ) of the image that was passed to 'set_input'
+			void 					get_detections(const std::pair<uint32_t, uint32_t>& source_size, const box_args& args, std::vector<detection>& target, uint32_t batch_index = 0);
+
+		private:
+			explicit darknet_network(::network* p_network);
+
+									/// frees the array 'field' points to, and points it to 'data' instead ( which is not freed together with the network )
+			void 					borrow(float*& field, float* data);
+
+									/// assigns the layer outputs that are only read for a short while ( see 'plan_activations' ) to slots in 'm_activations' that are reused across layers
+			void 					share_activations();
+
+									/// replaces darknet's convolutions ( see 'override_convolution' ), once the weights are in place, and the [upsample] / [shortcut] passes ( see 'override_elementwise_layer' )
+			void 					prepare_convolutions();
+
+									/// points the convolutional layers to the fused weights, creating '<weights>.fused' first if needed
+									/// \return false if the weights file layout does not match the network, in which case nothing is changed
+			bool 					map_weights(const std::filesystem::path& weights_filepath);
+
+			::network* 				m_p_network;
+			std::vector<float> 		m_input;
+			std::vector<float> 		m_activations;
+			uint64_t 				m_weights_key = 0;
+
+									/// layer fields that point to data owned by something else. nulled before the network is freed
+			std::vector<float**> 	m_borrowed;
+
+									/// keeps the owners of the borrowed data alive
+			std::vector<std::shared_ptr<const void>> m_borrowed_owners;
+
+									/// of the overridden convolutions ( see 'override_convolution' ), made current for the forward pass
+			convolution_data 		m_convolutions;
+
+									/// the [yolo] layers. their forward pass is skipped, the logits of the layer before are decoded directly
+			std::vector<yolo_head> 	m_heads;
+			box_candidates 			m_candidates;
+	};
+}
+
+#endif //ALL_YOLO_DARKNET_NETWORK_HPP
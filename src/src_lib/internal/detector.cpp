@@ -0,0 +1,305 @@
+#include <map>
+#include "detector.hpp"
+#include "topology.hpp"
+#include "tiling.hpp"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::v3
+{
+	detector::detector(std::unique_ptr<detector_internal>&& v) : m_internal(std::move(v)) {}
+	detector::~detector() = default;
+
+	std::vector<detection> detector::detect(const image& image)
+	{
+		return detect_async(image).get();
+	}
+
+	std::future<std::vector<detection>> detector::detect_async(image image)
+	{
+		return m_internal->detect_async(std::move(image));
+	}
+
+	std::vector<detection> detector::detect_tiled(const image& image, const tile_args& args)
+	{
+		return m_internal->detect_tiled(image, args);
+	}
+
+	std::optional<std::vector<detection>> detector::detect(const std::filesystem::path& image_filepath)
+	{
+		auto v = image::load(image_filepath);
+		if(!v.has_value())
+		{
+			return std::nullopt;
+		}
+		return detect_async(std::move(*v)).get();
+	}
+
+	detector_metrics detector::metrics() const
+	{
+		return m_internal->metrics();
+	}
+
+	static uint32_t threads_per_replica(const detector_args& args)
+	{
+		if(args.threads_per_replica != 0)
+		{
+			return args.threads_per_replica;
+		}
+		return std::max(1u, (uint32_t)topology().cores.size() / std::max(args.replicas, 1u)); // hyper-threads only get in each others way in the gemm
+	}
+
+	detector_internal::detector_internal(std::vector<std::shared_ptr<yolo::internal::darknet_network>>&& networks, std::vector<replica_placement>&& placement, const detector_args& args)
+		: m_args(args)
+		, m_threads_per_replica(threads_per_replica(args))
+		, m_queue(networks.size())
+	{
+		m_metrics.max_batch_size = networks.front()->batch();
+		m_metrics.max_batch_wait_us = m_args.max_batch_wait_us;
+		m_metrics.replicas = (uint32_t)networks.size();
+		m_metrics.threads_per_replica = m_threads_per_replica;
+		m_metrics.placement = std::move(placement);
+
+		m_replicas.resize(networks.size());
+		for(size_t i=0; i<networks.size(); i++)
+		{
+			m_replicas[i].p_network = std::move(networks[i]);
+		}
+		for(size_t i=0; i<m_replicas.size(); i++)
+		{
+			m_replicas[i].p_thread = std::make_unique<std::thread>([this, i](){thread_main(i);});
+		}
+	}
+
+	detector_internal::~detector_internal()
+	{
+		m_queue.close();
+		for(auto& v : m_replicas)
+		{
+			v.p_thread->join();
+		}
+	}
+
+	std::unique_ptr<detector_internal> detector_internal::create(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath, const detector_args& args, const std::optional<std::filesystem::path>& int8_filepath)
+	{
+		const uint32_t num_replicas = std::max(args.replicas, 1u);
+		std::vector<replica_placement> placement;
+		if(args.pin_threads)
+		{
+			placement = yolo::internal::place_groups(topology(), num_replicas, threads_per_replica(args));
+		}
+
+		// each network is created on the cores it will run on, so its activations are allocated on that NUMA node ( first touch ).
+		// the first network of each node gets its own copy of the weights, the others on that node share it
+		std::vector<std::shared_ptr<yolo::internal::darknet_network>> networks;
+		std::map<uint32_t, std::shared_ptr<yolo::internal::darknet_network>> node_networks;
+		for(uint32_t i=0; i<num_replicas; i++)
+		{
+			std::shared_ptr<yolo::internal::darknet_network> p_network;
+			auto load = [&]()
+			{
+				if(networks.empty())
+				{
+					p_network = yolo::internal::darknet_network::load(model_cfg, weights_filepath);
+				}
+				else if(placement.empty())
+				{
+					p_network = yolo::internal::darknet_network::load_replica(model_cfg, networks.front());
+				}
+				else if(auto it = node_networks.find(placement[i].numa_node); it != node_networks.end())
+				{
+					p_network = yolo::internal::darknet_network::load_replica(model_cfg, it->second);
+				}
+				else
+				{
+					p_network = yolo::internal::darknet_network::load_replica(model_cfg, networks.front(), true);
+				}
+			};
+			if(placement.empty())
+			{
+				load();
+			}
+			else
+			{
+				yolo::internal::run_pinned(placement[i].cpus, load);
+				node_networks.try_emplace(placement[i].numa_node, p_network);
+			}
+			if(p_network == nullptr)
+			{
+				return nullptr;
+			}
+			networks.push_back(std::move(p_network));
+		}
+		if(!placement.empty())
+		{
+			log("Pinned " + std::to_string(num_replicas) + " replica(s) of " + std::to_string(threads_per_replica(args)) + " thread(s) over " + std::to_string(node_networks.size()) + " NUMA node(s)");
+		}
+
+		// the heads first, so the layers they skip are not quantized
+		if(!args.heads.empty())
+		{
+			for(auto& p_network : networks)
+			{
+				if(!p_network->select_heads(args.heads))
+				{
+					return nullptr;
+				}
+			}
+		}
+		if(int8_filepath.has_value())
+		{
+			auto model = yolo::internal::int8_model::load(*int8_filepath, networks.front()->weights_key());
+			bool ok = model.has_value();
+			for(size_t i=0; i<networks.size() && ok; i++)
+			{
+				ok = networks[i]->use_int8(*model); // only the first can fail, all networks have the same layers
+			}
+			if(ok)
+			{
+				log("Running " + std::to_string(model->layers.size()) + " convolutions in int8 ( " + std::string(yolo::internal::int8_isa()) + " )");
+			}
+			else
+			{
+				log("Failed to use the int8 model '" + int8_filepath->string() + "', falling back to float");
+			}
+		}
+		return std::unique_ptr<detector_internal>(new detector_internal(std::move(networks), std::move(placement), args));
+	}
+
+	std::future<std::vector<detection>> detector_internal::detect_async(image&& image)
+	{
+		detect_request request = {
+				.source 	= std::move(image),
+				.promise 	= {},
+				.queued_at 	= std::chrono::steady_clock::now()
+		};
+		auto future = request.promise.get_future();
+
+		if(request.source.format != image_format::rgb || request.source.width_px == 0 || request.source.height_px == 0 || request.source.data.size() < (size_t)request.source.width_px * request.source.height_px * 3)
+		{
+			log("detect: image must be rgb, not empty, and contain width * height * 3 bytes");
+			request.promise.set_value({});
+			return future;
+		}
+
+		m_queue.push(std::move(request));
+		return future;
+	}
+
+	std::vector<detection> detector_internal::detect_tiled(const image& image, const tile_args& args)
+	{
+		if(image.format != image_format::rgb || image.width_px == 0 || image.height_px == 0 || image.data.size() < (size_t)image.width_px * image.height_px * 3)
+		{
+			log("detect_tiled: image must be rgb, not empty, and contain width * height * 3 bytes");
+			return {};
+		}
+		const yolo::internal::darknet_network& network = *m_replicas.front().p_network;
+		const uint32_t tile_width = args.tile_size_px != 0 ? args.tile_size_px : network.width();
+		const uint32_t tile_height = args.tile_size_px != 0 ? args.tile_size_px : network.height();
+		const auto tiles = yolo::internal::make_tiles(image.width_px, image.height_px, tile_width, tile_height, args.overlap);
+
+		// all tiles are queued before waiting for any, so they run in parallel
+		std::vector<std::future<std::vector<detection>>> results;
+		results.reserve(tiles.size() + 1);
+		for(const auto& tile : tiles)
+		{
+			results.push_back(detect_async(yolo::internal::crop(image, tile)));
+		}
+		const bool full_frame_pass = args.full_frame_pass && tiles.size() > 1;
+		if(full_frame_pass)
+		{
+			results.push_back(detect_async(yolo::image(image)));
+		}
+
+		std::vector<yolo::internal::tile_detection> detections;
+		for(size_t i=0; i<tiles.size(); i++)
+		{
+			yolo::internal::add_tile_detections(results[i].get(), tiles[i], image.width_px, image.height_px, detections);
+		}
+		if(full_frame_pass)
+		{
+			yolo::internal::add_tile_detections(results.back().get(), {.x = 0, .y = 0, .width = image.width_px, .height = image.height_px}, image.width_px, image.height_px, detections);
+		}
+		return yolo::internal::merge_tile_detections(std::move(detections), m_args.nms_thresh, args.cut_thresh);
+	}
+
+	detector_metrics detector_internal::metrics() const
+	{
+		std::lock_guard lock(m_mutex);
+		return m_metrics;
+	}
+
+	void detector_internal::thread_main(size_t replica_index)
+	{
+		if(!m_metrics.placement.empty())
+		{
+			yolo::internal::pin_openmp_threads(m_metrics.placement[replica_index].cpus);
+		}
+		else
+		{
+#ifdef _OPENMP
+			omp_set_num_threads((int)m_threads_per_replica); // only affects the parallel regions started from this thread
+#endif
+		}
+		yolo::internal::darknet_network& network = *m_replicas[replica_index].p_network;
+		const size_t max_batch_size = network.batch();
+		const auto max_wait = std::chrono::microseconds(m_args.max_batch_wait_us);
+		std::vector<detect_request> batch;
+		batch.reserve(max_batch_size);
+
+		while(m_queue.pop(replica_index, batch, max_batch_size, max_wait))
+		{
+			run_batch(network, batch);
+			batch.clear();
+		}
+	}
+
+	void detector_internal::run_batch(yolo::internal::darknet_network& network, std::vector<detect_request>& batch)
+	{
+		const auto start = std::chrono::steady_clock::now();
+
+		for(size_t i=0; i<batch.size(); i++)
+		{
+			network.set_input(batch[i].source, m_args.letter_box, (uint32_t)i);
+		}
+		network.predict();
+
+		const yolo::internal::box_args box_args = {
+				.thresh 		= m_args.thresh,
+				.nms_thresh 	= m_args.nms_thresh,
+				.letter_box 	= m_args.letter_box
+		};
+
+		std::vector<std::vector<detection>> results(batch.size());
+		for(size_t i=0; i<batch.size(); i++)
+		{
+			network.get_detections({batch[i].source.width_px, batch[i].source.height_px}, box_args, results[i], (uint32_t)i);
+		}
+
+		const auto end = std::chrono::steady_clock::now();
+		{
+			std::lock_guard lock(m_mutex);
+			for(const auto& v : batch)
+			{
+				m_total_queue_wait_us += (double)std::chrono::duration_cast<std::chrono::microseconds>(start - v.queued_at).count();
+			}
+			m_total_batch_us += (double)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+			m_metrics.num_images += batch.size();
+			m_metrics.num_batches++;
+			m_metrics.average_batch_size = (float)((double)m_metrics.num_images / (double)m_metrics.num_batches);
+			m_metrics.average_queue_wait_us = (float)(m_total_queue_wait_us / (double)m_metrics.num_images);
+			m_metrics.average_batch_us = (float)(m_total_batch_us / (double)m_metrics.num_batches);
+		}
+
+		for(size_t i=0; i<batch.size(); i++)
+		{
+			batch[i].promise.set_value(std::move(results[i]));
+		}
+	}
+}
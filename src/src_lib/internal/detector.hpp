@@ -0,0 +1,63 @@
+#ifndef ALL_YOLO_DETECTOR_HPP
+#define ALL_YOLO_DETECTOR_HPP
+
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <yolo.hpp>
+#include "cfg.hpp"
+#include "darknet_network.hpp"
+#include "work_stealing_queue.hpp"
+
+namespace yolo::v3
+{
+	struct detect_request
+	{
+		image 									source;
+		std::promise<std::vector<detection>> 	promise;
+		std::chrono::steady_clock::time_point 	queued_at;
+	};
+
+	class detector_internal
+	{
+		public:
+			~detector_internal();
+
+			/// \param model_cfg testing cfg, loaded with a batch size of 'args.max_batch_size'. it is loaded 'args.replicas' times, all sharing the weights of the first
+			/// \param int8_filepath int8 model written by 'quantize' ( see 'detector_args::int8' ). the networks stay in float if it can not be used
+			/// \return nullptr if loading the network failed
+			static std::unique_ptr<detector_internal> create(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath, const detector_args& args, const std::optional<std::filesystem::path>& int8_filepath);
+
+			std::future<std::vector<detection>> detect_async(image&& image);
+
+			std::vector<detection> detect_tiled(const image& image, const tile_args& args);
+
+			[[nodiscard]] detector_metrics metrics() const;
+
+		private:
+			struct replica
+			{
+				std::shared_ptr<yolo::internal::darknet_network> 	p_network;
+				std::unique_ptr<std::thread> 						p_thread;
+			};
+
+			/// \param placement per network, or empty to leave the threads to the OS
+			detector_internal(std::vector<std::shared_ptr<yolo::internal::darknet_network>>&& networks, std::vector<replica_placement>&& placement, const detector_args& args);
+
+			void thread_main(size_t replica_index);
+			void run_batch(yolo::internal::darknet_network& network, std::vector<detect_request>& batch);
+
+			const detector_args 								m_args;
+			const uint32_t 										m_threads_per_replica;
+			std::vector<replica> 								m_replicas;
+			yolo::internal::work_stealing_queue<detect_request> m_queue;
+
+			mutable std::mutex 									m_mutex;
+
+			detector_metrics 									m_metrics;
+			double 												m_total_queue_wait_us = 0.0;
+			double 												m_total_batch_us = 0.0;
+	};
+}
+
+#endif //ALL_YOLO_DETECTOR_HPP
@@ -0,0 +1,582 @@
+#include <darknet.h>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <optional>
+#include "blas.h"
+#include "activations.h"
+#include "upsample_layer.h"
+#include "shortcut_layer.h"
+#include "elementwise.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#if defined(__GNUC__) && !defined(__clang__)
+// GCC 12 warns about the _mm512_undefined_ps() in the AVX-512 intrinsics with -O2 ( GCC bug 105593 )
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#define ELEMENTWISE_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define ELEMENTWISE_NEON
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo::internal
+{
+	using bias_activation_fn = void(*)(float* p_values, size_t n, float bias, gemm_epilogue::activation act);
+	using add_fn = void(*)(const float* a, const float* b, float* p_target, size_t n);
+	using upsample_row_2x_fn = void(*)(const float* p_input, size_t width, float scale, float* p_target);
+
+	struct kernels
+	{
+		bias_activation_fn 	bias_activation;
+		add_fn 				add;
+		upsample_row_2x_fn 	upsample_row_2x;
+		std::string_view 	name;
+	};
+
+	// coefficients of the exp approximation ( Cephes expf ): exp(x) = 2^n * exp(r), with |r| <= ln(2) / 2
+	static constexpr float s_exp_max = 88.3762626647949f;
+	static constexpr float s_exp_min = -87.3365447504019f;
+	static constexpr float s_log2e = 1.44269504088896341f;
+	static constexpr float s_ln2_hi = 0.693359375f;
+	static constexpr float s_ln2_lo = -2.12194440e-4f;
+	static constexpr float s_exp_p[6] = {1.9875691500E-4f, 1.3981999507E-3f, 8.3334519073E-3f, 4.1665795894E-2f, 1.6666665459E-1f, 5.0000001201E-1f};
+
+	static float activate(float v, gemm_epilogue::activation act)
+	{
+		switch(act)
+		{
+			case gemm_epilogue::activation::linear: 	return v;
+			case gemm_epilogue::activation::leaky: 		return v > 0.0f ? v : 0.1f * v; // same slope as darknet's leaky
+			case gemm_epilogue::activation::relu: 		return v > 0.0f ? v : 0.0f;
+			case gemm_epilogue::activation::logistic: 	return 1.0f / (1.0f + std::exp(-v));
+		}
+		return v;
+	}
+
+	static void bias_activation_scalar(float* p_values, size_t n, float bias, gemm_epilogue::activation act)
+	{
+		for(size_t i=0; i<n; i++)
+		{
+			p_values[i] = activate(p_values[i] + bias, act);
+		}
+	}
+
+	static void add_scalar(const float* a, const float* b, float* p_target, size_t n)
+	{
+		for(size_t i=0; i<n; i++)
+		{
+			p_target[i] = a[i] + b[i];
+		}
+	}
+
+	static void upsample_row_2x_scalar(const float* p_input, size_t width, float scale, float* p_target)
+	{
+		for(size_t x=0; x<width; x++)
+		{
+			p_target[2*x] = p_target[2*x + 1] = p_input[x] * scale;
+		}
+	}
+
+#ifdef ELEMENTWISE_X86
+	__attribute__((target("avx2,fma")))
+	static __m256 exp_avx2(__m256 x)
+	{
+		x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(s_exp_min)), _mm256_set1_ps(s_exp_max));
+		const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(s_log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(s_ln2_hi), x);
+		r = _mm256_fnmadd_ps(n, _mm256_set1_ps(s_ln2_lo), r);
+		__m256 p = _mm256_set1_ps(s_exp_p[0]);
+		for(size_t i=1; i<6; i++)
+		{
+			p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(s_exp_p[i]));
+		}
+		p = _mm256_add_ps(_mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r), _mm256_set1_ps(1.0f));
+		const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+		return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+	}
+
+	template<gemm_epilogue::activation Act>
+	__attribute__((target("avx2,fma")))
+	static void bias_activation_avx2_impl(float* p_values, size_t n, float bias)
+	{
+		const __m256 b = _mm256_set1_ps(bias);
+		const __m256 slope = _mm256_set1_ps(0.1f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		size_t i = 0;
+		for(; i+8<=n; i+=8)
+		{
+			__m256 v = _mm256_add_ps(_mm256_loadu_ps(&p_values[i]), b);
+			if constexpr(Act == gemm_epilogue::activation::leaky)
+			{
+				v = _mm256_max_ps(v, _mm256_mul_ps(v, slope));
+			}
+			else if constexpr(Act == gemm_epilogue::activation::relu)
+			{
+				v = _mm256_max_ps(v, zero);
+			}
+			else if constexpr(Act == gemm_epilogue::activation::logistic)
+			{
+				v = _mm256_div_ps(one, _mm256_add_ps(one, exp_avx2(_mm256_sub_ps(zero, v))));
+			}
+			_mm256_storeu_ps(&p_values[i], v);
+		}
+		bias_activation_scalar(&p_values[i], n - i, bias, Act);
+	}
+
+	__attribute__((target("avx2,fma")))
+	static void bias_activation_avx2(float* p_values, size_t n, float bias, gemm_epilogue::activation act)
+	{
+		switch(act)
+		{
+			case gemm_epilogue::activation::linear: 	bias_activation_avx2_impl<gemm_epilogue::activation::linear>(p_values, n, bias); break;
+			case gemm_epilogue::activation::leaky: 		bias_activation_avx2_impl<gemm_epilogue::activation::leaky>(p_values, n, bias); break;
+			case gemm_epilogue::activation::relu: 		bias_activation_avx2_impl<gemm_epilogue::activation::relu>(p_values, n, bias); break;
+			case gemm_epilogue::activation::logistic: 	bias_activation_avx2_impl<gemm_epilogue::activation::logistic>(p_values, n, bias); break;
+		}
+	}
+
+	__attribute__((target("avx2,fma")))
+	static void add_avx2(const float* a, const float* b, float* p_target, size_t n)
+	{
+		size_t i = 0;
+		for(; i+8<=n; i+=8)
+		{
+			_mm256_storeu_ps(&p_target[i], _mm256_add_ps(_mm256_loadu_ps(&a[i]), _mm256_loadu_ps(&b[i])));
+		}
+		add_scalar(&a[i], &b[i], &p_target[i], n - i);
+	}
+
+	__attribute__((target("avx2,fma")))
+	static void upsample_row_2x_avx2(const float* p_input, size_t width, float scale, float* p_target)
+	{
+		const __m256 s = _mm256_set1_ps(scale);
+		size_t x = 0;
+		for(; x+8<=width; x+=8)
+		{
+			const __m256 v = _mm256_mul_ps(_mm256_loadu_ps(&p_input[x]), s);
+			const __m256 lo = _mm256_unpacklo_ps(v, v); // 0 0 1 1 | 4 4 5 5
+			const __m256 hi = _mm256_unpackhi_ps(v, v); // 2 2 3 3 | 6 6 7 7
+			_mm256_storeu_ps(&p_target[2*x], _mm256_permute2f128_ps(lo, hi, 0x20));
+			_mm256_storeu_ps(&p_target[2*x + 8], _mm256_permute2f128_ps(lo, hi, 0x31));
+		}
+		upsample_row_2x_scalar(&p_input[x], width - x, scale, &p_target[2*x]);
+	}
+
+	__attribute__((target("avx512f")))
+	static __m512 exp_avx512(__m512 x)
+	{
+		x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(s_exp_min)), _mm512_set1_ps(s_exp_max));
+		const __m512 n = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(s_log2e)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+		__m512 r = _mm512_fnmadd_ps(n, _mm512_set1_ps(s_ln2_hi), x);
+		r = _mm512_fnmadd_ps(n, _mm512_set1_ps(s_ln2_lo), r);
+		__m512 p = _mm512_set1_ps(s_exp_p[0]);
+		for(size_t i=1; i<6; i++)
+		{
+			p = _mm512_fmadd_ps(p, r, _mm512_set1_ps(s_exp_p[i]));
+		}
+		p = _mm512_add_ps(_mm512_fmadd_ps(p, _mm512_mul_ps(r, r), r), _mm512_set1_ps(1.0f));
+		return _mm512_scalef_ps(p, n);
+	}
+
+	template<gemm_epilogue::activation Act>
+	__attribute__((target("avx512f")))
+	static void bias_activation_avx512_impl(float* p_values, size_t n, float bias)
+	{
+		const __m512 b = _mm512_set1_ps(bias);
+		const __m512 slope = _mm512_set1_ps(0.1f);
+		const __m512 zero = _mm512_setzero_ps();
+		const __m512 one = _mm512_set1_ps(1.0f);
+		for(size_t i=0; i<n; i+=16)
+		{
+			const __mmask16 mask = n - i >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (n - i)) - 1);
+			__m512 v = _mm512_add_ps(_mm512_maskz_loadu_ps(mask, &p_values[i]), b);
+			if constexpr(Act == gemm_epilogue::activation::leaky)
+			{
+				v = _mm512_max_ps(v, _mm512_mul_ps(v, slope));
+			}
+			else if constexpr(Act == gemm_epilogue::activation::relu)
+			{
+				v = _mm512_max_ps(v, zero);
+			}
+			else if constexpr(Act == gemm_epilogue::activation::logistic)
+			{
+				v = _mm512_div_ps(one, _mm512_add_ps(one, exp_avx512(_mm512_sub_ps(zero, v))));
+			}
+			_mm512_mask_storeu_ps(&p_values[i], mask, v);
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	static void bias_activation_avx512(float* p_values, size_t n, float bias, gemm_epilogue::activation act)
+	{
+		switch(act)
+		{
+			case gemm_epilogue::activation::linear: 	bias_activation_avx512_impl<gemm_epilogue::activation::linear>(p_values, n, bias); break;
+			case gemm_epilogue::activation::leaky: 		bias_activation_avx512_impl<gemm_epilogue::activation::leaky>(p_values, n, bias); break;
+			case gemm_epilogue::activation::relu: 		bias_activation_avx512_impl<gemm_epilogue::activation::relu>(p_values, n, bias); break;
+			case gemm_epilogue::activation::logistic: 	bias_activation_avx512_impl<gemm_epilogue::activation::logistic>(p_values, n, bias); break;
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	static void add_avx512(const float* a, const float* b, float* p_target, size_t n)
+	{
+		for(size_t i=0; i<n; i+=16)
+		{
+			const __mmask16 mask = n - i >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << (n - i)) - 1);
+			_mm512_mask_storeu_ps(&p_target[i], mask, _mm512_add_ps(_mm512_maskz_loadu_ps(mask, &a[i]), _mm512_maskz_loadu_ps(mask, &b[i])));
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	static void upsample_row_2x_avx512(const float* p_input, size_t width, float scale, float* p_target)
+	{
+		const __m512 s = _mm512_set1_ps(scale);
+		const __m512i lo_index = _mm512_set_epi32(7, 7, 6, 6, 5, 5, 4, 4, 3, 3, 2, 2, 1, 1, 0, 0);
+		const __m512i hi_index = _mm512_set_epi32(15, 15, 14, 14, 13, 13, 12, 12, 11, 11, 10, 10, 9, 9, 8, 8);
+		size_t x = 0;
+		for(; x+16<=width; x+=16)
+		{
+			const __m512 v = _mm512_mul_ps(_mm512_loadu_ps(&p_input[x]), s);
+			_mm512_storeu_ps(&p_target[2*x], _mm512_permutexvar_ps(lo_index, v));
+			_mm512_storeu_ps(&p_target[2*x + 16], _mm512_permutexvar_ps(hi_index, v));
+		}
+		upsample_row_2x_avx2(&p_input[x], width - x, scale, &p_target[2*x]);
+	}
+#endif
+
+#ifdef ELEMENTWISE_NEON
+	static float32x4_t exp_neon(float32x4_t x)
+	{
+		x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(s_exp_min)), vdupq_n_f32(s_exp_max));
+		const float32x4_t n = vrndnq_f32(vmulq_f32(x, vdupq_n_f32(s_log2e)));
+		float32x4_t r = vfmsq_f32(x, n, vdupq_n_f32(s_ln2_hi));
+		r = vfmsq_f32(r, n, vdupq_n_f32(s_ln2_lo));
+		float32x4_t p = vdupq_n_f32(s_exp_p[0]);
+		for(size_t i=1; i<6; i++)
+		{
+			p = vfmaq_f32(vdupq_n_f32(s_exp_p[i]), p, r);
+		}
+		p = vaddq_f32(vfmaq_f32(r, p, vmulq_f32(r, r)), vdupq_n_f32(1.0f));
+		const int32x4_t exponent = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+		return vmulq_f32(p, vreinterpretq_f32_s32(exponent));
+	}
+
+	template<gemm_epilogue::activation Act>
+	static void bias_activation_neon_impl(float* p_values, size_t n, float bias)
+	{
+		const float32x4_t b = vdupq_n_f32(bias);
+		const float32x4_t one = vdupq_n_f32(1.0f);
+		size_t i = 0;
+		for(; i+4<=n; i+=4)
+		{
+			float32x4_t v = vaddq_f32(vld1q_f32(&p_values[i]), b);
+			if constexpr(Act == gemm_epilogue::activation::leaky)
+			{
+				v = vmaxq_f32(v, vmulq_n_f32(v, 0.1f));
+			}
+			else if constexpr(Act == gemm_epilogue::activation::relu)
+			{
+				v = vmaxq_f32(v, vdupq_n_f32(0.0f));
+			}
+			else if constexpr(Act == gemm_epilogue::activation::logistic)
+			{
+				v = vdivq_f32(one, vaddq_f32(one, exp_neon(vnegq_f32(v))));
+			}
+			vst1q_f32(&p_values[i], v);
+		}
+		bias_activation_scalar(&p_values[i], n - i, bias, Act);
+	}
+
+	static void bias_activation_neon(float* p_values, size_t n, float bias, gemm_epilogue::activation act)
+	{
+		switch(act)
+		{
+			case gemm_epilogue::activation::linear: 	bias_activation_neon_impl<gemm_epilogue::activation::linear>(p_values, n, bias); break;
+			case gemm_epilogue::activation::leaky: 		bias_activation_neon_impl<gemm_epilogue::activation::leaky>(p_values, n, bias); break;
+			case gemm_epilogue::activation::relu: 		bias_activation_neon_impl<gemm_epilogue::activation::relu>(p_values, n, bias); break;
+			case gemm_epilogue::activation::logistic: 	bias_activation_neon_impl<gemm_epilogue::activation::logistic>(p_values, n, bias); break;
+		}
+	}
+
+	static void add_neon(const float* a, const float* b, float* p_target, size_t n)
+	{
+		size_t i = 0;
+		for(; i+4<=n; i+=4)
+		{
+			vst1q_f32(&p_target[i], vaddq_f32(vld1q_f32(&a[i]), vld1q_f32(&b[i])));
+		}
+		add_scalar(&a[i], &b[i], &p_target[i], n - i);
+	}
+
+	static void upsample_row_2x_neon(const float* p_input, size_t width, float scale, float* p_target)
+	{
+		size_t x = 0;
+		for(; x+4<=width; x+=4)
+		{
+			const float32x4_t v = vmulq_n_f32(vld1q_f32(&p_input[x]), scale);
+			vst2q_f32(&p_target[2*x], (float32x4x2_t){{v, v}}); // interleaves: v0 v0 v1 v1 ...
+		}
+		upsample_row_2x_scalar(&p_input[x], width - x, scale, &p_target[2*x]);
+	}
+#endif
+
+	static const kernels& select_kernels()
+	{
+		static const kernels s_kernels = []()
+		{
+#ifdef ELEMENTWISE_X86
+			if(__builtin_cpu_supports("avx512f"))
+			{
+				return kernels{bias_activation_avx512, add_avx512, upsample_row_2x_avx512, "avx512"};
+			}
+			if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			{
+				return kernels{bias_activation_avx2, add_avx2, upsample_row_2x_avx2, "avx2"};
+			}
+#endif
+#ifdef ELEMENTWISE_NEON
+			return kernels{bias_activation_neon, add_neon, upsample_row_2x_neon, "neon"};
+#endif
+			return kernels{bias_activation_scalar, add_scalar, upsample_row_2x_scalar, "scalar"};
+		}();
+		return s_kernels;
+	}
+
+	std::string_view elementwise_isa()
+	{
+		return select_kernels().name;
+	}
+
+	void bias_activation(float* p_values, size_t n, float bias, gemm_epilogue::activation act)
+	{
+		select_kernels().bias_activation(p_values, n, bias, act);
+	}
+
+	void add(const float* a, const float* b, float* p_target, size_t n)
+	{
+		select_kernels().add(a, b, p_target, n);
+	}
+
+	void upsample_row(const float* p_input, size_t width, size_t stride, float scale, float* p_target)
+	{
+		if(stride == 2)
+		{
+			select_kernels().upsample_row_2x(p_input, width, scale, p_target);
+			return;
+		}
+		for(size_t x=0; x<width * stride; x++)
+		{
+			p_target[x] = p_input[x / stride] * scale;
+		}
+	}
+
+	/// the elementwise passes are split in chunks that fit in L2, so each thread streams its own part
+	static constexpr int64_t s_chunk_size = 16 * 1024;
+
+	std::optional<gemm_epilogue::activation> epilogue_activation(const layer& l)
+	{
+		switch(l.activation)
+		{
+			case LINEAR: 	return gemm_epilogue::activation::linear;
+			case LEAKY: 	return gemm_epilogue::activation::leaky;
+			case RELU: 		return gemm_epilogue::activation::relu;
+			case LOGISTIC: 	return gemm_epilogue::activation::logistic;
+			default: 		return std::nullopt;
+		}
+	}
+
+	static void forward_upsample_layer_simd(layer l, network_state state)
+	{
+		const int64_t num_rows = (int64_t)l.batch * l.c * l.h;
+		const size_t out_width = (size_t)l.w * l.stride;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int64_t row=0; row<num_rows; row++)
+		{
+			// input row 'row' becomes 'stride' output rows
+			float* p_target = &l.output[(size_t)row * l.stride * out_width];
+			upsample_row(&state.input[(size_t)row * l.w], (size_t)l.w, (size_t)l.stride, l.scale, p_target);
+			for(int s=1; s<l.stride; s++)
+			{
+				std::copy(p_target, p_target + out_width, p_target + s * out_width);
+			}
+		}
+	}
+
+	/// only the plain case: 1 input layer of the same shape, without weights ( anything else goes to darknet's pass )
+	static void forward_shortcut_layer_simd(layer l, network_state state)
+	{
+		const layer& from = state.net.layers[l.index];
+		if(l.n != 1 || l.nweights != 0 || from.w != l.w || from.h != l.h || from.c != l.c)
+		{
+			forward_shortcut_layer(l, state);
+			return;
+		}
+		const gemm_epilogue::activation act = *epilogue_activation(l);
+		const int64_t n = (int64_t)l.outputs * l.batch;
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int64_t i=0; i<n; i+=s_chunk_size)
+		{
+			const size_t count = (size_t)std::min(s_chunk_size, n - i);
+			add(&state.input[i], &from.output[i], &l.output[i], count);
+			if(act != gemm_epilogue::activation::linear)
+			{
+				bias_activation(&l.output[i], count, 0.0f, act);
+			}
+		}
+	}
+
+	bool override_elementwise_layer(layer& l)
+	{
+		if(l.type == UPSAMPLE && l.forward == forward_upsample_layer && !l.reverse && l.stride > 0)
+		{
+			l.forward = forward_upsample_layer_simd;
+			return true;
+		}
+		if(l.type == SHORTCUT && l.forward == forward_shortcut_layer && epilogue_activation(l).has_value())
+		{
+			l.forward = forward_shortcut_layer_simd;
+			return true;
+		}
+		return false;
+	}
+
+	template<typename Fn>
+	static double time_ms(uint32_t iterations, Fn&& fn)
+	{
+		fn(); // warm up
+		const auto start = std::chrono::steady_clock::now();
+		for(uint32_t i=0; i<iterations; i++)
+		{
+			fn();
+		}
+		return (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0 / iterations;
+	}
+
+	std::vector<kernel_benchmark> benchmark_elementwise(uint32_t iterations)
+	{
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> distribution(-4.0f, 4.0f);
+		auto random_vector = [&](size_t n)
+		{
+			std::vector<float> v(n);
+			for(auto& x : v)
+			{
+				x = distribution(random);
+			}
+			return v;
+		};
+		std::vector<kernel_benchmark> results;
+
+		// [upsample] stride 2 of the second head ( 256 x 13 x 13 -> 26 x 26 ) and the third ( 128 x 26 x 26 -> 52 x 52 )
+		for(const auto& [c, size] : {std::pair<int, int>{256, 13}, std::pair<int, int>{128, 26}})
+		{
+			layer l = {};
+			l.type = UPSAMPLE;
+			l.batch = 1;
+			l.c = l.out_c = c;
+			l.w = l.h = size;
+			l.out_w = l.out_h = size * 2;
+			l.stride = 2;
+			l.scale = 1.0f;
+			l.outputs = l.out_c * l.out_w * l.out_h;
+			auto input = random_vector((size_t)c * size * size);
+			std::vector<float> output((size_t)l.outputs);
+			l.output = output.data();
+			network_state state = {};
+			state.input = input.data();
+			kernel_benchmark v;
+			v.name = "upsample " + std::to_string(c) + "x" + std::to_string(size) + "x" + std::to_string(size);
+			v.darknet_ms = time_ms(iterations, [&](){ fill_cpu(l.outputs, 0, l.output, 1); upsample_cpu(state.input, l.w, l.h, l.c, l.batch, l.stride, 1, l.scale, l.output); });
+			v.simd_ms = time_ms(iterations, [&](){ forward_upsample_layer_simd(l, state); });
+			results.push_back(std::move(v));
+		}
+
+		// [shortcut] of the first residual blocks ( 64 x 208 x 208 ) and the third stage ( 256 x 52 x 52 )
+		for(const auto& [c, size] : {std::pair<int, int>{64, 208}, std::pair<int, int>{256, 52}})
+		{
+			const size_t n = (size_t)c * size * size;
+			auto input = random_vector(n);
+			auto from_output = random_vector(n);
+			std::vector<float> output(n);
+			// layers[0] is the layer the shortcut adds, layers[1] the [shortcut] itself
+			layer layers[2] = {};
+			for(auto& l : layers)
+			{
+				l.batch = 1;
+				l.c = l.out_c = c;
+				l.w = l.h = l.out_w = l.out_h = size;
+				l.outputs = (int)n;
+			}
+			layers[0].output = from_output.data();
+			layer& l = layers[1];
+			l.type = SHORTCUT;
+			l.index = 0;
+			l.n = 1;
+			l.activation = LINEAR;
+			l.output = output.data();
+			network_state state = {};
+			state.input = input.data();
+			state.net.layers = layers;
+			state.net.n = 2;
+			kernel_benchmark v;
+			v.name = "shortcut " + std::to_string(c) + "x" + std::to_string(size) + "x" + std::to_string(size);
+			v.darknet_ms = time_ms(iterations, [&](){ forward_shortcut_layer(l, state); });
+			v.simd_ms = time_ms(iterations, [&](){ forward_shortcut_layer_simd(l, state); });
+			results.push_back(std::move(v));
+		}
+
+		// leaky after the first convolution ( 32 x 416 x 416 ), and the logistic over the smallest and the largest [yolo] input ( 3 anchors of 85 values for 80 classes )
+		struct activation_shape
+		{
+			const char* 				name;
+			ACTIVATION 					activation;
+			gemm_epilogue::activation 	act;
+			size_t 						n;
+		};
+		const activation_shape activation_shapes[] = {{"leaky 32x416x416", LEAKY, gemm_epilogue::activation::leaky, (size_t)32 * 416 * 416},
+													   {"logistic 255x13x13", LOGISTIC, gemm_epilogue::activation::logistic, (size_t)255 * 13 * 13},
+													   {"logistic 255x52x52", LOGISTIC, gemm_epilogue::activation::logistic, (size_t)255 * 52 * 52}};
+		for(const auto& [name, activation, act, n] : activation_shapes)
+		{
+			const auto source = random_vector(n);
+			std::vector<float> values(n);
+			kernel_benchmark v;
+			v.name = name;
+			v.darknet_ms = time_ms(iterations, [&]()
+			{
+				std::copy(source.begin(), source.end(), values.begin());
+				activate_array_cpu_custom(values.data(), (int)n, activation);
+			});
+			v.simd_ms = time_ms(iterations, [&]()
+			{
+				std::copy(source.begin(), source.end(), values.begin());
+#ifdef _OPENMP
+				#pragma omp parallel for schedule(static)
+#endif
+				for(int64_t i=0; i<(int64_t)n; i+=s_chunk_size)
+				{
+					bias_activation(&values[i], (size_t)std::min(s_chunk_size, (int64_t)n - i), 0.0f, act);
+				}
+			});
+			results.push_back(std::move(v));
+		}
+		return results;
+	}
+}
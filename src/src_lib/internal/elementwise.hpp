@@ -0,0 +1,47 @@
+#ifndef ALL_YOLO_ELEMENTWISE_HPP
+#define ALL_YOLO_ELEMENTWISE_HPP
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <string_view>
+#include "gemm.hpp"
+
+struct layer;
+
+namespace yolo::internal
+{
+	// single threaded kernels ( AVX-512, AVX2 or NEON, picked at runtime ), so they can be called from within a parallel region ( like the gemm epilogue )
+
+	/// p_values[i] = act(p_values[i] + bias)
+	void 				bias_activation(float* p_values, size_t n, float bias, gemm_epilogue::activation act);
+
+	/// p_target[i] = a[i] + b[i]. p_target may be a or b
+	void 				add(const float* a, const float* b, float* p_target, size_t n);
+
+	/// nearest neighbour upsampling of a single row: p_target[x] = p_input[x / stride] * scale, for x in range 0 - width * stride
+	void 				upsample_row(const float* p_input, size_t width, size_t stride, float scale, float* p_target);
+
+						/// name of the instruction set the kernels dispatched to on this machine
+	std::string_view 	elementwise_isa();
+
+	/// \return the activation of the layer as the kernels above ( and the gemm epilogue ) have it. nullopt for the ones they do not have ( swish, mish, ... )
+	std::optional<gemm_epilogue::activation> epilogue_activation(const layer& l);
+
+	/// replaces the forward pass of [upsample] and [shortcut] layers with ones that run on the kernels above, spread over the OpenMP threads.
+	/// The outputs are the same as darknet's, so darknet's backward passes stay as they are.
+	/// \return false if the layer is of another type, or uses options that are not supported ( in which case it keeps darknet's pass )
+	bool 				override_elementwise_layer(layer& l);
+
+	struct kernel_benchmark
+	{
+		std::string name;
+		double 		darknet_ms = 0.0;
+		double 		simd_ms = 0.0;
+	};
+
+	/// times darknet's loops against the kernels above, on the shapes yolov3 runs them on ( 416x416 input )
+	std::vector<kernel_benchmark> benchmark_elementwise(uint32_t iterations = 20);
+}
+
+#endif //ALL_YOLO_ELEMENTWISE_HPP
@@ -0,0 +1,384 @@
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "gemm.hpp"
+#include "elementwise.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GEMM_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GEMM_NEON
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo::internal
+{
+	/// computes a full mr * nr tile of c from a packed a panel ( kc * mr ) and a packed b panel ( kc * nr )
+	using microkernel_fn = void(*)(size_t kc, const float* a, const float* b, float* c, size_t ldc, bool accumulate);
+
+	struct kernels
+	{
+		microkernel_fn 		microkernel;
+		size_t 				mr; 	// rows of a tile
+		size_t 				nr; 	// columns of a tile
+		size_t 				mc; 	// rows of a block of a ( kept in L2 )
+		size_t 				nc; 	// columns of a block of b ( kept in L3 )
+		size_t 				kc; 	// depth of both blocks
+		std::string_view 	name;
+	};
+
+	static void microkernel_scalar(size_t kc, const float* a, const float* b, float* c, size_t ldc, bool accumulate)
+	{
+		constexpr size_t mr = 4;
+		constexpr size_t nr = 4;
+		float acc[mr][nr] = {};
+		for(size_t p=0; p<kc; p++)
+		{
+			for(size_t i=0; i<mr; i++)
+			{
+				for(size_t j=0; j<nr; j++)
+				{
+					acc[i][j] += a[p*mr + i] * b[p*nr + j];
+				}
+			}
+		}
+		for(size_t i=0; i<mr; i++)
+		{
+			for(size_t j=0; j<nr; j++)
+			{
+				c[i*ldc + j] = accumulate ? c[i*ldc + j] + acc[i][j] : acc[i][j];
+			}
+		}
+	}
+
+#ifdef GEMM_X86
+	__attribute__((target("avx2,fma")))
+	static void microkernel_avx2(size_t kc, const float* a, const float* b, float* c, size_t ldc, bool accumulate)
+	{
+		constexpr size_t mr = 6;
+		__m256 acc[mr][2];
+		for(size_t i=0; i<mr; i++)
+		{
+			acc[i][0] = _mm256_setzero_ps();
+			acc[i][1] = _mm256_setzero_ps();
+		}
+		for(size_t p=0; p<kc; p++)
+		{
+			const __m256 b0 = _mm256_load_ps(&b[p*16]);
+			const __m256 b1 = _mm256_load_ps(&b[p*16 + 8]);
+			for(size_t i=0; i<mr; i++)
+			{
+				const __m256 ai = _mm256_broadcast_ss(&a[p*mr + i]);
+				acc[i][0] = _mm256_fmadd_ps(ai, b0, acc[i][0]);
+				acc[i][1] = _mm256_fmadd_ps(ai, b1, acc[i][1]);
+			}
+		}
+		for(size_t i=0; i<mr; i++)
+		{
+			float* ci = &c[i*ldc];
+			if(accumulate)
+			{
+				acc[i][0] = _mm256_add_ps(acc[i][0], _mm256_loadu_ps(ci));
+				acc[i][1] = _mm256_add_ps(acc[i][1], _mm256_loadu_ps(ci + 8));
+			}
+			_mm256_storeu_ps(ci, acc[i][0]);
+			_mm256_storeu_ps(ci + 8, acc[i][1]);
+		}
+	}
+
+	__attribute__((target("avx512f")))
+	static void microkernel_avx512(size_t kc, const float* a, const float* b, float* c, size_t ldc, bool accumulate)
+	{
+		constexpr size_t mr = 12;
+		__m512 acc[mr][2];
+		for(size_t i=0; i<mr; i++)
+		{
+			acc[i][0] = _mm512_setzero_ps();
+			acc[i][1] = _mm512_setzero_ps();
+		}
+		for(size_t p=0; p<kc; p++)
+		{
+			const __m512 b0 = _mm512_load_ps(&b[p*32]);
+			const __m512 b1 = _mm512_load_ps(&b[p*32 + 16]);
+			for(size_t i=0; i<mr; i++)
+			{
+				const __m512 ai = _mm512_set1_ps(a[p*mr + i]);
+				acc[i][0] = _mm512_fmadd_ps(ai, b0, acc[i][0]);
+				acc[i][1] = _mm512_fmadd_ps(ai, b1, acc[i][1]);
+			}
+		}
+		for(size_t i=0; i<mr; i++)
+		{
+			float* ci = &c[i*ldc];
+			if(accumulate)
+			{
+				acc[i][0] = _mm512_add_ps(acc[i][0], _mm512_loadu_ps(ci));
+				acc[i][1] = _mm512_add_ps(acc[i][1], _mm512_loadu_ps(ci + 16));
+			}
+			_mm512_storeu_ps(ci, acc[i][0]);
+			_mm512_storeu_ps(ci + 16, acc[i][1]);
+		}
+	}
+#endif
+
+#ifdef GEMM_NEON
+	static void microkernel_neon(size_t kc, const float* a, const float* b, float* c, size_t ldc, bool accumulate)
+	{
+		constexpr size_t mr = 8;
+		float32x4_t acc[mr][2];
+		for(size_t i=0; i<mr; i++)
+		{
+			acc[i][0] = vdupq_n_f32(0.0f);
+			acc[i][1] = vdupq_n_f32(0.0f);
+		}
+		for(size_t p=0; p<kc; p++)
+		{
+			const float32x4_t b0 = vld1q_f32(&b[p*8]);
+			const float32x4_t b1 = vld1q_f32(&b[p*8 + 4]);
+			const float32x4_t a0 = vld1q_f32(&a[p*mr]);
+			const float32x4_t a1 = vld1q_f32(&a[p*mr + 4]);
+			acc[0][0] = vfmaq_laneq_f32(acc[0][0], b0, a0, 0); acc[0][1] = vfmaq_laneq_f32(acc[0][1], b1, a0, 0);
+			acc[1][0] = vfmaq_laneq_f32(acc[1][0], b0, a0, 1); acc[1][1] = vfmaq_laneq_f32(acc[1][1], b1, a0, 1);
+			acc[2][0] = vfmaq_laneq_f32(acc[2][0], b0, a0, 2); acc[2][1] = vfmaq_laneq_f32(acc[2][1], b1, a0, 2);
+			acc[3][0] = vfmaq_laneq_f32(acc[3][0], b0, a0, 3); acc[3][1] = vfmaq_laneq_f32(acc[3][1], b1, a0, 3);
+			acc[4][0] = vfmaq_laneq_f32(acc[4][0], b0, a1, 0); acc[4][1] = vfmaq_laneq_f32(acc[4][1], b1, a1, 0);
+			acc[5][0] = vfmaq_laneq_f32(acc[5][0], b0, a1, 1); acc[5][1] = vfmaq_laneq_f32(acc[5][1], b1, a1, 1);
+			acc[6][0] = vfmaq_laneq_f32(acc[6][0], b0, a1, 2); acc[6][1] = vfmaq_laneq_f32(acc[6][1], b1, a1, 2);
+			acc[7][0] = vfmaq_laneq_f32(acc[7][0], b0, a1, 3); acc[7][1] = vfmaq_laneq_f32(acc[7][1], b1, a1, 3);
+		}
+		for(size_t i=0; i<mr; i++)
+		{
+			float* ci = &c[i*ldc];
+			if(accumulate)
+			{
+				acc[i][0] = vaddq_f32(acc[i][0], vld1q_f32(ci));
+				acc[i][1] = vaddq_f32(acc[i][1], vld1q_f32(ci + 4));
+			}
+			vst1q_f32(ci, acc[i][0]);
+			vst1q_f32(ci + 4, acc[i][1]);
+		}
+	}
+#endif
+
+	static const kernels& select_kernels()
+	{
+		static const kernels s_kernels = []()
+		{
+#ifdef GEMM_X86
+			if(__builtin_cpu_supports("avx512f"))
+			{
+				return kernels{microkernel_avx512, 12, 32, 96, 512, 256, "avx512"};
+			}
+			if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			{
+				return kernels{microkernel_avx2, 6, 16, 72, 512, 256, "avx2"};
+			}
+#endif
+#ifdef GEMM_NEON
+			return kernels{microkernel_neon, 8, 8, 64, 256, 256, "neon"};
+#endif
+			return kernels{microkernel_scalar, 4, 4, 64, 256, 256, "scalar"};
+		}();
+		return s_kernels;
+	}
+
+	std::string_view gemm_isa()
+	{
+		return select_kernels().name;
+	}
+
+	gemm_epilogue gemm_epilogue::offset(size_t row, size_t column) const
+	{
+		gemm_epilogue v = *this;
+		v.p_bias = p_bias != nullptr ? p_bias + row : nullptr;
+		v.p_residual = p_residual != nullptr ? p_residual + row * ld_residual + column : nullptr;
+		return v;
+	}
+
+	void gemm_epilogue::apply(float* p_row, size_t num_columns) const
+	{
+		bias_activation(p_row, num_columns, p_bias != nullptr ? *p_bias : 0.0f, act);
+		if(p_residual != nullptr)
+		{
+			add(p_row, p_residual, p_row, num_columns);
+		}
+	}
+
+	/// a row major matrix
+	struct matrix_view
+	{
+		const float* 	p;
+		size_t 			ld;
+
+		[[nodiscard]] const float& 	at(size_t row, size_t column) const { return p[row*ld + column]; }
+		[[nodiscard]] matrix_view 	offset(size_t row, size_t column) const { return {&at(row, column), ld}; }
+	};
+
+	/// rows [0, rows) of a, depth [0, depth), into panels of mr rows: panel[p][i], padded with zeros
+	static void pack_a(const matrix_view& a, size_t rows, size_t depth, size_t mr, float* p_target)
+	{
+		for(size_t i0=0; i0<rows; i0+=mr)
+		{
+			const size_t num_rows = std::min(mr, rows - i0);
+			for(size_t p=0; p<depth; p++)
+			{
+				size_t i = 0;
+				for(; i<num_rows; i++)
+				{
+					p_target[i] = a.at(i0 + i, p);
+				}
+				for(; i<mr; i++)
+				{
+					p_target[i] = 0.0f;
+				}
+				p_target += mr;
+			}
+		}
+	}
+
+	/// columns [0, columns) of b, depth [0, depth), into panels of nr columns: panel[p][j], padded with zeros
+	static void pack_b(const matrix_view& b, size_t columns, size_t depth, size_t nr, float* p_target)
+	{
+		for(size_t j0=0; j0<columns; j0+=nr)
+		{
+			const size_t num_columns = std::min(nr, columns - j0);
+			for(size_t p=0; p<depth; p++)
+			{
+				memcpy(p_target, &b.at(p, j0), num_columns * sizeof(float));
+				std::fill(p_target + num_columns, p_target + nr, 0.0f);
+				p_target += nr;
+			}
+		}
+	}
+
+	/// packing buffers, per thread. 64 byte aligned, the microkernels use aligned loads of b
+	struct pack_buffers
+	{
+		std::vector<float> 	storage;
+		float* 				p_a = nullptr;
+		float* 				p_b = nullptr;
+
+		void reserve(size_t num_a, size_t num_b)
+		{
+			constexpr size_t alignment = 16; // floats
+			const size_t num_a_aligned = (num_a + alignment - 1) / alignment * alignment;
+			if(storage.size() < num_a_aligned + num_b + alignment)
+			{
+				storage.resize(num_a_aligned + num_b + alignment);
+			}
+			const size_t misalignment = ((uintptr_t)storage.data() / sizeof(float)) % alignment;
+			p_a = storage.data() + (misalignment == 0 ? 0 : alignment - misalignment);
+			p_b = p_a + num_a_aligned;
+		}
+	};
+
+	/// c[rows, columns] = a[rows, k] * b[k, columns] ( + c )
+	static void gemm_block(const kernels& kern, size_t rows, size_t columns, size_t k, const matrix_view& a, const matrix_view& b, float* c, size_t ldc, bool accumulate, const gemm_epilogue* p_epilogue)
+	{
+		thread_local pack_buffers t_buffers;
+		const size_t rows_padded = (rows + kern.mr - 1) / kern.mr * kern.mr;
+		const size_t columns_padded = (columns + kern.nr - 1) / kern.nr * kern.nr;
+		t_buffers.reserve(rows_padded * kern.kc, columns_padded * kern.kc);
+
+		float edge[32 * 32]; // a single tile, for the tiles at the bottom/right edge of c
+		for(size_t p0=0; p0<k; p0+=kern.kc)
+		{
+			const size_t depth = std::min(kern.kc, k - p0);
+			const bool accumulate_tile = accumulate || p0 > 0;
+			const bool is_last_depth = p0 + depth >= k;
+			pack_a(a.offset(0, p0), rows, depth, kern.mr, t_buffers.p_a);
+			pack_b(b.offset(p0, 0), columns, depth, kern.nr, t_buffers.p_b);
+
+			for(size_t j0=0; j0<columns; j0+=kern.nr)
+			{
+				const float* p_b_panel = &t_buffers.p_b[j0 * depth];
+				const size_t num_columns = std::min(kern.nr, columns - j0);
+				for(size_t i0=0; i0<rows; i0+=kern.mr)
+				{
+					const float* p_a_panel = &t_buffers.p_a[i0 * depth];
+					const size_t num_rows = std::min(kern.mr, rows - i0);
+					float* p_c = &c[i0*ldc + j0];
+					if(num_rows == kern.mr && num_columns == kern.nr)
+					{
+						kern.microkernel(depth, p_a_panel, p_b_panel, p_c, ldc, accumulate_tile);
+					}
+					else
+					{
+						kern.microkernel(depth, p_a_panel, p_b_panel, edge, kern.nr, false);
+						for(size_t i=0; i<num_rows; i++)
+						{
+							for(size_t j=0; j<num_columns; j++)
+							{
+								p_c[i*ldc + j] = accumulate_tile ? p_c[i*ldc + j] + edge[i*kern.nr + j] : edge[i*kern.nr + j];
+							}
+						}
+					}
+					if(is_last_depth && p_epilogue != nullptr)
+					{
+						const gemm_epilogue tile_epilogue = p_epilogue->offset(i0, j0);
+						for(size_t i=0; i<num_rows; i++)
+						{
+							tile_epilogue.offset(i, 0).apply(&p_c[i*ldc], num_columns);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void gemm(size_t m, size_t n, size_t k, const float* a, size_t lda, const float* b, size_t ldb, float* c, size_t ldc, bool accumulate, const gemm_epilogue* p_epilogue)
+	{
+		if(m == 0 || n == 0)
+		{
+			return;
+		}
+		if(k == 0)
+		{
+			if(!accumulate)
+			{
+				for(size_t i=0; i<m; i++)
+				{
+					std::fill(&c[i*ldc], &c[i*ldc] + n, 0.0f);
+				}
+			}
+			for(size_t i=0; i<m && p_epilogue != nullptr; i++)
+			{
+				p_epilogue->offset(i, 0).apply(&c[i*ldc], n);
+			}
+			return;
+		}
+		const kernels& kern = select_kernels();
+		const matrix_view a_view{a, lda};
+		const matrix_view b_view{b, ldb};
+
+#ifdef _OPENMP
+		const size_t num_threads = (size_t)omp_get_max_threads();
+#else
+		const size_t num_threads = 1;
+#endif
+		// the late layers have few columns, so split them finer to keep all threads busy
+		const size_t num_row_blocks = (m + kern.mc - 1) / kern.mc;
+		const size_t min_column_blocks = (num_threads * 2 + num_row_blocks - 1) / num_row_blocks;
+		size_t nc = std::min(kern.nc, (n + min_column_blocks - 1) / min_column_blocks);
+		nc = std::max(kern.nr, (nc + kern.nr - 1) / kern.nr * kern.nr);
+		const size_t num_column_blocks = (n + nc - 1) / nc;
+		const int64_t num_blocks = (int64_t)(num_row_blocks * num_column_blocks);
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic) if(num_threads > 1 && num_blocks > 1)
+#endif
+		for(int64_t block=0; block<num_blocks; block++)
+		{
+			const size_t i0 = ((size_t)block % num_row_blocks) * kern.mc;
+			const size_t j0 = ((size_t)block / num_row_blocks) * nc;
+			const gemm_epilogue block_epilogue = p_epilogue != nullptr ? p_epilogue->offset(i0, j0) : gemm_epilogue{};
+			gemm_block(kern, std::min(kern.mc, m - i0), std::min(nc, n - j0), k, a_view.offset(i0, 0), b_view.offset(0, j0), &c[i0*ldc + j0], ldc, accumulate, p_epilogue != nullptr ? &block_epilogue : nullptr);
+		}
+	}
+}
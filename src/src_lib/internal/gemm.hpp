@@ -0,0 +1,41 @@
+#ifndef ALL_YOLO_GEMM_HPP
+#define ALL_YOLO_GEMM_HPP
+
+#include <cstddef>
+#include <string_view>
+
+namespace yolo::internal
+{
+	/// applied to each tile of c right after its last product, while it is still in cache: c = activation(c + bias[row]) + residual
+	struct gemm_epilogue
+	{
+		enum class activation
+		{
+			linear,
+			leaky,
+			relu,
+			logistic
+		};
+
+		const float* 	p_bias = nullptr; 		// per row of c, or nullptr
+		activation 		act = activation::linear;
+		const float* 	p_residual = nullptr; 	// same shape as c, or nullptr
+		size_t 			ld_residual = 0;
+
+		/// the same epilogue for the sub-matrix of c that starts at ( row, column )
+		[[nodiscard]] gemm_epilogue offset(size_t row, size_t column) const;
+
+		/// applies the epilogue to 'num_columns' values of a single row of c
+		void apply(float* p_row, size_t num_columns) const;
+	};
+
+	/// c = a * b ( + c if 'accumulate' ), all row major. a is m * k, b is k * n, and c is m * n.
+	/// Cache blocked, with a and b packed into panels for a register blocked microkernel ( AVX-512, AVX2/FMA or NEON, picked at runtime ).
+	/// The blocks are spread over the OpenMP threads of the calling thread ( see 'omp_set_num_threads' ).
+	void 				gemm(size_t m, size_t n, size_t k, const float* a, size_t lda, const float* b, size_t ldb, float* c, size_t ldc, bool accumulate, const gemm_epilogue* p_epilogue = nullptr);
+
+						/// name of the instruction set 'gemm' dispatched to on this machine
+	std::string_view 	gemm_isa();
+}
+
+#endif //ALL_YOLO_GEMM_HPP
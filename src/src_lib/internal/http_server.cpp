@@ -1,10 +1,11 @@
-#ifdef MINIZIP_FOUND
 #define CPPHTTPLIB_THREAD_POOL_COUNT 2
 #include <yolo.hpp>
 #include <httplib.h>
 #include "http_server.hpp"
 #include "internal.hpp"
+#ifdef MINIZIP_FOUND
 #include "zip.hpp"
+#endif
 
 namespace yolo
 {
@@ -31,11 +32,40 @@ namespace yolo::http::server
 	{
 		m_p_server = std::make_unique<httplib::Server>();
 
+		const size_t num_workers = std::max(1u, m_init_args.num_workers);
+		m_p_server->new_task_queue = [num_workers]() { return new httplib::ThreadPool(num_workers); };
+
 		m_p_server->Get("/test", [](const httplib::Request&, httplib::Response& res)
 		{
 			res.set_content("If you see this, the server is running", "text/plain");
 		});
 
+		// a detection server has no data source or weights folder, so it only serves '/detect'
+		if(m_init_args.p_detector != nullptr)
+		{
+			add_detection_routes();
+		}
+		else
+		{
+			add_training_routes();
+		}
+	}
+
+	void server_internal_thread::add_detection_routes()
+	{
+		m_p_server->set_keep_alive_max_count(std::numeric_limits<size_t>::max());
+		m_p_server->set_keep_alive_timeout(60);
+
+		m_p_server->Post("/detect", [this](const httplib::Request& req, httplib::Response& res)
+		{
+			std::string json;
+			handle_detect(req.body, json, res.status);
+			res.set_content(json, "application/json");
+		});
+	}
+
+	void server_internal_thread::add_training_routes()
+	{
 		m_p_server->Get("/get_data_source", [this](const httplib::Request&, httplib::Response& res)
 		{
 			std::stringstream ss;
@@ -68,6 +98,7 @@ namespace yolo::http::server
 			res.set_content(ss.str(), "text/plain");
 		});
 
+#ifdef MINIZIP_FOUND
 		m_p_server->Get("/get_images", [this](const httplib::Request& t, httplib::Response& res)
 		{
 			if(!t.has_param("from"))
@@ -166,6 +197,7 @@ namespace yolo::http::server
 				res.status = 204;
 			}
 		});
+#endif
 
 		m_p_server->Post("/upload", [&](const httplib::Request &req, httplib::Response &res, const httplib::ContentReader &content_reader)
 		{
@@ -210,6 +242,41 @@ namespace yolo::http::server
 		});
 	}
 
+	static void append_json(std::stringstream& ss, const detection& v)
+	{
+		ss 	<< "{\"class_id\":" << v.class_id
+			<< ",\"confidence\":" << v.confidence
+			<< ",\"x\":" << v.x
+			<< ",\"y\":" << v.y
+			<< ",\"w\":" << v.w
+			<< ",\"h\":" << v.h
+			<< "}";
+	}
+
+	void server_internal_thread::handle_detect(const std::string& body, std::string& json_out, int& status_out)
+	{
+		const auto image = image::load_from_memory((const uint8_t*)body.data(), body.size());
+		if(!image.has_value())
+		{
+			json_out = "{\"error\":\"failed to decode the image. the body must be a jpg or png\"}";
+			status_out = 400;
+			return;
+		}
+
+		const auto detections = m_init_args.p_detector->detect(*image);
+
+		std::stringstream ss;
+		ss << "{\"width\":" << image->width_px << ",\"height\":" << image->height_px << ",\"detections\":[";
+		for(size_t i=0; i<detections.size(); i++)
+		{
+			ss << (i == 0 ? "" : ",");
+			append_json(ss, detections[i]);
+		}
+		ss << "]}";
+		json_out = ss.str();
+		status_out = 200;
+	}
+
 	void server_internal_thread::handle_file_upload(const std::string& name, const std::string& filename, const std::string& content_type, const std::vector<uint8_t>& content)
 	{
 		log("/upload invoked with name: '" + name + "', filename: '" + filename + "', content_type: '" + content_type + "' num bytes: " + std::to_string(content.size()));
@@ -338,5 +405,3 @@ namespace yolo::http::server
 	}
 
 }
-
-#endif
\ No newline at end of file
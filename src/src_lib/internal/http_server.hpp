@@ -1,8 +1,6 @@
 #ifndef ALL_YOLO_SERVER_HPP
 #define ALL_YOLO_SERVER_HPP
 
-#ifdef MINIZIP_FOUND
-
 #include <memory>
 #include <filesystem>
 #include <thread>
@@ -25,6 +23,12 @@ namespace yolo::http::server
 		std::filesystem::path chart_png_path;
 		std::optional<std::filesystem::path> latest_weights_filepath;
 		unsigned int port = http::server::server::DEFAULT_PORT;
+
+		/// if set, only '/detect' ( and '/test' ) is served, using this detector
+		std::shared_ptr<v3::detector> p_detector = nullptr;
+
+		/// amount of connections that are handled concurrently
+		unsigned int num_workers = 2;
 	};
 
 	class server_internal
@@ -53,6 +57,10 @@ namespace yolo::http::server
 			void close();
 
 		private:
+			void add_detection_routes();
+			void add_training_routes();
+
+			void handle_detect(const std::string& body, std::string& json_out, int& status_out);
 			void handle_file_upload(const std::string& name, const std::string& filename, const std::string& content_type, const std::vector<uint8_t>& content);
 
 			const init_args& m_init_args;
@@ -60,5 +68,4 @@ namespace yolo::http::server
 	};
 }
 
-#endif
 #endif //ALL_YOLO_SERVER_HPP
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cmath>
+#include "int8_gemm.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define INT8_GEMM_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define INT8_GEMM_NEON
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo::internal
+{
+	/// tile of 4 rows * 2 columns: out[r * 2 + c] = sum(w[r][k] * (a[c][k] - 128))
+	using dot_4x2_fn = void(*)(const int8_t* const* w, const int32_t* w_sums, const uint8_t* const* a, size_t depth, int32_t* out);
+
+	struct kernels
+	{
+		dot_4x2_fn 			dot_4x2;
+		std::string_view 	name;
+	};
+
+	static void dot_4x2_scalar(const int8_t* const* w, const int32_t*, const uint8_t* const* a, size_t depth, int32_t* out)
+	{
+		for(size_t r=0; r<4; r++)
+		{
+			for(size_t c=0; c<2; c++)
+			{
+				int32_t sum = 0;
+				for(size_t k=0; k<depth; k++)
+				{
+					sum += (int32_t)w[r][k] * ((int32_t)a[c][k] - s_int8_zero_point);
+				}
+				out[r*2 + c] = sum;
+			}
+		}
+	}
+
+#ifdef INT8_GEMM_X86
+	__attribute__((target("avx2")))
+	static int32_t horizontal_sum(__m256i v)
+	{
+		const __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+		const __m128i sum_2 = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		return _mm_cvtsi128_si32(_mm_add_epi32(sum_2, _mm_shuffle_epi32(sum_2, _MM_SHUFFLE(2, 3, 0, 1))));
+	}
+
+	/// widens to int16 ( (a - 128) fits ), and multiplies with madd, so nothing saturates
+	__attribute__((target("avx2")))
+	static void dot_4x2_avx2(const int8_t* const* w, const int32_t*, const uint8_t* const* a, size_t depth, int32_t* out)
+	{
+		const __m128i sign = _mm_set1_epi8((char)0x80);
+		__m256i acc[4][2];
+		for(size_t r=0; r<4; r++)
+		{
+			acc[r][0] = _mm256_setzero_si256();
+			acc[r][1] = _mm256_setzero_si256();
+		}
+		for(size_t k=0; k<depth; k+=16)
+		{
+			// a - 128 == a ^ 0x80 as int8
+			const __m256i a0 = _mm256_cvtepi8_epi16(_mm_xor_si128(_mm_loadu_si128((const __m128i*)&a[0][k]), sign));
+			const __m256i a1 = _mm256_cvtepi8_epi16(_mm_xor_si128(_mm_loadu_si128((const __m128i*)&a[1][k]), sign));
+			for(size_t r=0; r<4; r++)
+			{
+				const __m256i wr = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)&w[r][k]));
+				acc[r][0] = _mm256_add_epi32(acc[r][0], _mm256_madd_epi16(wr, a0));
+				acc[r][1] = _mm256_add_epi32(acc[r][1], _mm256_madd_epi16(wr, a1));
+			}
+		}
+		for(size_t r=0; r<4; r++)
+		{
+			out[r*2 + 0] = horizontal_sum(acc[r][0]);
+			out[r*2 + 1] = horizontal_sum(acc[r][1]);
+		}
+	}
+
+	/// vpdpbusd multiplies uint8 with int8 directly, so the zero point is taken out afterwards with the weight sums
+	__attribute__((target("avx512f,avx512vl,avx512bw,avx512vnni,avx2")))
+	static void dot_4x2_vnni(const int8_t* const* w, const int32_t* w_sums, const uint8_t* const* a, size_t depth, int32_t* out)
+	{
+		__m256i acc[4][2];
+		for(size_t r=0; r<4; r++)
+		{
+			acc[r][0] = _mm256_setzero_si256();
+			acc[r][1] = _mm256_setzero_si256();
+		}
+		for(size_t k=0; k<depth; k+=32)
+		{
+			const __m256i a0 = _mm256_loadu_si256((const __m256i*)&a[0][k]);
+			const __m256i a1 = _mm256_loadu_si256((const __m256i*)&a[1][k]);
+			for(size_t r=0; r<4; r++)
+			{
+				const __m256i wr = _mm256_loadu_si256((const __m256i*)&w[r][k]);
+				acc[r][0] = _mm256_dpbusd_epi32(acc[r][0], a0, wr);
+				acc[r][1] = _mm256_dpbusd_epi32(acc[r][1], a1, wr);
+			}
+		}
+		for(size_t r=0; r<4; r++)
+		{
+			out[r*2 + 0] = horizontal_sum(acc[r][0]) - s_int8_zero_point * w_sums[r];
+			out[r*2 + 1] = horizontal_sum(acc[r][1]) - s_int8_zero_point * w_sums[r];
+		}
+	}
+#endif
+
+#if defined(INT8_GEMM_NEON) && defined(__ARM_FEATURE_DOTPROD)
+	static void dot_4x2_neon(const int8_t* const* w, const int32_t*, const uint8_t* const* a, size_t depth, int32_t* out)
+	{
+		const uint8x16_t sign = vdupq_n_u8(0x80);
+		int32x4_t acc[4][2];
+		for(size_t r=0; r<4; r++)
+		{
+			acc[r][0] = vdupq_n_s32(0);
+			acc[r][1] = vdupq_n_s32(0);
+		}
+		for(size_t k=0; k<depth; k+=16)
+		{
+			const int8x16_t a0 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(&a[0][k]), sign));
+			const int8x16_t a1 = vreinterpretq_s8_u8(veorq_u8(vld1q_u8(&a[1][k]), sign));
+			for(size_t r=0; r<4; r++)
+			{
+				const int8x16_t wr = vld1q_s8(&w[r][k]);
+				acc[r][0] = vdotq_s32(acc[r][0], wr, a0);
+				acc[r][1] = vdotq_s32(acc[r][1], wr, a1);
+			}
+		}
+		for(size_t r=0; r<4; r++)
+		{
+			out[r*2 + 0] = vaddvq_s32(acc[r][0]);
+			out[r*2 + 1] = vaddvq_s32(acc[r][1]);
+		}
+	}
+#endif
+
+	static const kernels& select_kernels()
+	{
+		static const kernels s_kernels = []()
+		{
+#ifdef INT8_GEMM_X86
+			if(__builtin_cpu_supports("avx512vnni") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512bw"))
+			{
+				return kernels{dot_4x2_vnni, "avx512vnni"};
+			}
+			if(__builtin_cpu_supports("avx2"))
+			{
+				return kernels{dot_4x2_avx2, "avx2"};
+			}
+#endif
+#if defined(INT8_GEMM_NEON) && defined(__ARM_FEATURE_DOTPROD)
+			return kernels{dot_4x2_neon, "neon-dotprod"};
+#endif
+			return kernels{dot_4x2_scalar, "scalar"};
+		}();
+		return s_kernels;
+	}
+
+	std::string_view int8_isa()
+	{
+		return select_kernels().name;
+	}
+
+	int8_weights int8_weights::quantize(const float* p_weights, uint32_t rows, uint32_t depth)
+	{
+		std::vector<int8_t> data((size_t)rows * ((depth + s_int8_depth_alignment - 1) / s_int8_depth_alignment * s_int8_depth_alignment), 0);
+		std::vector<float> scales(rows, 0.0f);
+		const size_t depth_padded = data.size() / std::max(rows, 1u);
+		for(size_t r=0; r<rows; r++)
+		{
+			const float* p_row = &p_weights[r * depth];
+			float max_abs = 0.0f;
+			for(size_t k=0; k<depth; k++)
+			{
+				max_abs = std::max(max_abs, std::fabs(p_row[k]));
+			}
+			scales[r] = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+			for(size_t k=0; k<depth; k++)
+			{
+				data[r * depth_padded + k] = (int8_t)std::clamp((int)std::lround(p_row[k] / scales[r]), -127, 127);
+			}
+		}
+		return from_quantized(std::move(data), std::move(scales), rows, depth);
+	}
+
+	int8_weights int8_weights::from_quantized(std::vector<int8_t>&& data, std::vector<float>&& scales, uint32_t rows, uint32_t depth)
+	{
+		int8_weights v;
+		v.rows = rows;
+		v.depth = depth;
+		v.depth_padded = (uint32_t)((depth + s_int8_depth_alignment - 1) / s_int8_depth_alignment * s_int8_depth_alignment);
+		v.data = std::move(data);
+		v.scales = std::move(scales);
+		v.sums.assign(rows, 0);
+		for(size_t r=0; r<rows; r++)
+		{
+			for(size_t k=0; k<v.depth_padded; k++)
+			{
+				v.sums[r] += v.data[r * v.depth_padded + k];
+			}
+		}
+		return v;
+	}
+
+	void quantize_columns(const float* p_input, uint32_t channels, uint32_t height, uint32_t width, uint32_t size, uint32_t stride, uint32_t pad, uint32_t output_width, uint32_t output_height, float scale, uint8_t* p_target, size_t depth_padded)
+	{
+		const float inverse_scale = 1.0f / scale;
+		const int64_t num_pixels = (int64_t)output_width * output_height;
+		const size_t depth = (size_t)channels * size * size;
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int64_t pixel=0; pixel<num_pixels; pixel++)
+		{
+			const int64_t oy = pixel / output_width;
+			const int64_t ox = pixel % output_width;
+			uint8_t* p_row = &p_target[(size_t)pixel * depth_padded];
+			size_t k = 0;
+			for(size_t c=0; c<channels; c++)
+			{
+				const float* p_channel = &p_input[c * width * height];
+				for(size_t ky=0; ky<size; ky++)
+				{
+					const int64_t y = oy * stride - pad + (int64_t)ky;
+					for(size_t kx=0; kx<size; kx++)
+					{
+						const int64_t x = ox * stride - pad + (int64_t)kx;
+						uint8_t q = (uint8_t)s_int8_zero_point; // zero padding
+						if(y >= 0 && y < height && x >= 0 && x < width)
+						{
+							const float v = std::nearbyint(p_channel[y * width + x] * inverse_scale) + (float)s_int8_zero_point;
+							q = (uint8_t)std::clamp(v, 0.0f, 255.0f);
+						}
+						p_row[k++] = q;
+					}
+				}
+			}
+			std::fill(p_row + depth, p_row + depth_padded, (uint8_t)s_int8_zero_point);
+		}
+	}
+
+	void int8_gemm(const int8_weights& weights, const uint8_t* p_columns, size_t num_columns, float input_scale, float* c, size_t ldc, const gemm_epilogue* p_epilogue)
+	{
+		const kernels& kern = select_kernels();
+		constexpr size_t block_columns = 64;
+		const int64_t num_blocks = (int64_t)((num_columns + block_columns - 1) / block_columns);
+		const size_t rows = weights.rows;
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(dynamic)
+#endif
+		for(int64_t block=0; block<num_blocks; block++)
+		{
+			const size_t j0 = (size_t)block * block_columns;
+			const size_t j1 = std::min(j0 + block_columns, num_columns);
+			for(size_t r0=0; r0<rows; r0+=4)
+			{
+				// the rows / columns past the end repeat the last one, and are not stored
+				const int8_t* w[4];
+				int32_t w_sums[4];
+				for(size_t r=0; r<4; r++)
+				{
+					const size_t row = std::min(r0 + r, rows - 1);
+					w[r] = &weights.data[row * weights.depth_padded];
+					w_sums[r] = weights.sums[row];
+				}
+				for(size_t j=j0; j<j1; j+=2)
+				{
+					const uint8_t* a[2] = {&p_columns[j * weights.depth_padded], &p_columns[std::min(j + 1, j1 - 1) * weights.depth_padded]};
+					int32_t out[8];
+					kern.dot_4x2(w, w_sums, a, weights.depth_padded, out);
+					for(size_t r=0; r<4 && r0 + r < rows; r++)
+					{
+						const float scale = weights.scales[r0 + r] * input_scale;
+						c[(r0 + r) * ldc + j] = (float)out[r*2] * scale;
+						if(j + 1 < j1)
+						{
+							c[(r0 + r) * ldc + j + 1] = (float)out[r*2 + 1] * scale;
+						}
+					}
+				}
+			}
+			if(p_epilogue != nullptr)
+			{
+				for(size_t r=0; r<rows; r++)
+				{
+					p_epilogue->offset(r, j0).apply(&c[r * ldc + j0], j1 - j0);
+				}
+			}
+		}
+	}
+}
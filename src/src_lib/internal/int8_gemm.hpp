@@ -0,0 +1,48 @@
+#ifndef ALL_YOLO_INT8_GEMM_HPP
+#define ALL_YOLO_INT8_GEMM_HPP
+
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include "gemm.hpp"
+
+namespace yolo::internal
+{
+	/// depth of the quantized weights and columns is padded to a multiple of this ( with zero weights )
+	static constexpr size_t s_int8_depth_alignment = 32;
+
+	/// quantized activations are uint8 with this zero point: q = clamp(round(v / scale) + 128, 0, 255)
+	static constexpr int32_t s_int8_zero_point = 128;
+
+	/// weights quantized per row ( output channel ), symmetric: w = data * scale
+	struct int8_weights
+	{
+		uint32_t 				rows = 0;
+		uint32_t 				depth = 0;
+		uint32_t 				depth_padded = 0;
+		std::vector<int8_t> 	data; 		// rows * depth_padded
+		std::vector<float> 		scales; 	// per row
+		std::vector<int32_t> 	sums; 		// per row, sum of 'data'
+
+		/// \param p_weights rows * depth floats
+		static int8_weights 	quantize(const float* p_weights, uint32_t rows, uint32_t depth);
+
+		/// \param data rows * depth_padded, from an earlier 'quantize'
+		static int8_weights 	from_quantized(std::vector<int8_t>&& data, std::vector<float>&& scales, uint32_t rows, uint32_t depth);
+	};
+
+	/// quantizes the input of a convolution into columns ( one row of 'depth_padded' bytes per output pixel, the layout the int8 kernels take ), like im2col
+	/// \param p_input channels * height * width
+	/// \param p_target output_width * output_height * depth_padded
+	void 				quantize_columns(const float* p_input, uint32_t channels, uint32_t height, uint32_t width, uint32_t size, uint32_t stride, uint32_t pad, uint32_t output_width, uint32_t output_height, float scale, uint8_t* p_target, size_t depth_padded);
+
+	/// c[row][column] = sum(weights[row][k] * (columns[column][k] - 128)) * weights.scales[row] * input_scale, followed by the epilogue.
+	/// Uses VNNI ( AVX-512 ), AVX2 or NEON dot product instructions when available. The columns are spread over the OpenMP threads.
+	/// \param p_columns num_columns * weights.depth_padded, see 'quantize_columns'
+	void 				int8_gemm(const int8_weights& weights, const uint8_t* p_columns, size_t num_columns, float input_scale, float* c, size_t ldc, const gemm_epilogue* p_epilogue);
+
+						/// name of the instruction set 'int8_gemm' dispatched to on this machine
+	std::string_view 	int8_isa();
+}
+
+#endif //ALL_YOLO_INT8_GEMM_HPP
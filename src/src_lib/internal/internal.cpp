@@ -11,7 +11,6 @@
 #include "zip.hpp"
 #include "option_list.h"
 #include "data.h"
-#include "demo.h"
 #include "utils.h"
 
 #ifdef GPU_SHOW_INFO
@@ -240,7 +239,7 @@ namespace yolo
 		//	path;
 		//}
 
-		static std::filesystem::path generate_unique_temp_filename(const std::string& base_name, const std::string& extension)
+		std::filesystem::path generate_unique_temp_filename(const std::string& base_name, const std::string& extension)
 		{
 			const uint64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 			static uint64_t s_uid = now;
@@ -297,90 +296,6 @@ namespace yolo
 			return true;
 		}
 
-		bool start_darknet_demo(const cfg::cfg& model_cfg, const std::filesystem::path& weights, const std::filesystem::path& source, const darknet_demo_args& args)
-		{
-			common_darknet_args base_args("", model_cfg, weights);
-
-			uint32_t classes = 0;
-			model_cfg.get_value("", "classes", classes);
-			if(classes == 0)
-			{
-				return false; // we can maybe also just set it to 20 ? ( like in the darknet sample, which is set by default )
-			}
-
-			// names ( the darknet way )
-			char** names = nullptr;
-			{
-				std::unordered_map<int, std::string> names_map;
-				if(args.names != std::nullopt)
-				{
-					names_map = *args.names;
-				}
-				else
-				{
-					names_map.insert({0, "."});
-				}
-				names = (char**)xcalloc(names_map.size(), sizeof(void*));
-				for(const auto& v : names_map)
-				{
-					char* name = (char*)xmalloc((v.second.size()+1) * sizeof(char));
-					strncpy(name, v.second.c_str(), (v.second.size()+1) * sizeof(char));
-					names[v.first] = name;
-				}
-			}
-
-			auto in_filename = str_to_c(source);
-			auto out_filename = str_to_c(args.out_filename.has_value() ? std::filesystem::weakly_canonical(std::filesystem::absolute(*args.out_filename)) : "");
-			auto http_post_host = str_to_c(args.http_post_host.has_value() ? std::filesystem::weakly_canonical(std::filesystem::absolute(*args.http_post_host)) : "");
-			auto prefix = str_to_c(args.prefix);
-
-			int cam_index = 0;
-			const std::string source_str = source.string();
-			if(source_str.starts_with("/dev/video"))
-			{
-				std::string substr = source_str.substr(strlen("/dev/video"));
-				char *endptr;
-				cam_index = (int)strtol(substr.c_str(), &endptr, 10);
-				if (*endptr != '\0')
-				{
-					log("Could not obtain camera index from '" + source_str + "'");
-					return false;
-				}
-				in_filename[0] = '\0';
-			}
-			else
-			{
-				in_filename = str_to_c(std::filesystem::weakly_canonical(std::filesystem::absolute(source)));
-			}
-			cam_index = 0;
-
-			demo(
-					base_args.model_cfg,
-					(char*)"/home/jesse/MainSVN/catwatch/v2/src/cmake-build-debug/object_detection_lib/src/session_1664043901/weights/model_1860.weights",
-					args.thresh,
-					args.hier_thresh,
-					cam_index,
-					in_filename[0] == '\0' ? nullptr : in_filename.data(),
-					names,
-					(int)classes,
-					args.avgframes,
-					args.frame_skip,
-					prefix.data(),
-					out_filename[0] == '\0' ? nullptr : out_filename.data(),
-				 	args.mjpeg_port,
-					args.dontdraw_bbox ? 1 : 0,
-					args.json_port,
-					args.benchmark ? 0 : args.dont_show,
-					args.ext_output ? 1 : 0,
-					args.letter_box ? 1 : 0,
-					args.time_limit_sec,
-					http_post_host[0] == '\0' ? nullptr : http_post_host.data(),
-					args.benchmark ? 1 : 0,
-					args.benchmark_layers);
-
-			return true;
-		}
-
 		static bool parse_images_list_line(std::string& line, unsigned int& index_out, std::string& image_name_out)
 		{
 			line.push_back('\0');
@@ -0,0 +1,60 @@
+#include "mapped_file.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define MAPPED_FILE_POSIX
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	mapped_file::mapped_file(const uint8_t* p_data, size_t size)
+		: m_p_data(p_data)
+		, m_size(size)
+	{
+	}
+
+	mapped_file::~mapped_file()
+	{
+#ifdef MAPPED_FILE_POSIX
+		munmap((void*)m_p_data, m_size);
+#endif
+	}
+
+	std::shared_ptr<mapped_file> mapped_file::open(const std::filesystem::path& filepath)
+	{
+#ifdef MAPPED_FILE_POSIX
+		const int fd = ::open(filepath.string().c_str(), O_RDONLY);
+		if(fd < 0)
+		{
+			log("Failed to open '" + filepath.string() + "' for mapping");
+			return nullptr;
+		}
+		struct stat st = {};
+		if(fstat(fd, &st) != 0 || st.st_size <= 0)
+		{
+			::close(fd);
+			return nullptr;
+		}
+		void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+		::close(fd); // the mapping keeps the file referenced
+		if(p == MAP_FAILED)
+		{
+			log("Failed to map '" + filepath.string() + "'");
+			return nullptr;
+		}
+		madvise(p, (size_t)st.st_size, MADV_WILLNEED); // start paging it in, the first forward pass touches all of it anyway
+		return std::shared_ptr<mapped_file>(new mapped_file((const uint8_t*)p, (size_t)st.st_size));
+#else
+		(void)filepath;
+		return nullptr;
+#endif
+	}
+}
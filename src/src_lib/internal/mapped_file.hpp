@@ -0,0 +1,31 @@
+#ifndef ALL_YOLO_MAPPED_FILE_HPP
+#define ALL_YOLO_MAPPED_FILE_HPP
+
+#include <memory>
+#include <cstdint>
+#include <filesystem>
+
+namespace yolo::internal
+{
+	/// Read-only memory mapping of a file. Processes that map the same file share its pages trough the page cache,
+	/// and nothing is read from disk until it is touched.
+	class mapped_file
+	{
+		public:
+			~mapped_file();
+
+			/// \return nullptr if the file could not be mapped ( or memory mapping is not supported on this platform )
+			static std::shared_ptr<mapped_file> open(const std::filesystem::path& filepath);
+
+			[[nodiscard]] const uint8_t* 	data() const { return m_p_data; }
+			[[nodiscard]] size_t 			size() const { return m_size; }
+
+		private:
+			mapped_file(const uint8_t* p_data, size_t size);
+
+			const uint8_t* 	m_p_data;
+			size_t 			m_size;
+	};
+}
+
+#endif //ALL_YOLO_MAPPED_FILE_HPP
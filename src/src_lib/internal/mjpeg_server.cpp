@@ -0,0 +1,249 @@
+#include <cmath>
+#include <algorithm>
+#include <httplib.h>
+#include <stb_image_write.h>
+#include "mjpeg_server.hpp"
+#include "video_pipeline.hpp"
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::http::server
+{
+	static constexpr const char* s_boundary = "frame";
+
+	mjpeg_server::mjpeg_server(std::unique_ptr<mjpeg_server_internal>&& v) : m_internal(std::move(v)) {}
+	mjpeg_server::~mjpeg_server() = default;
+
+	std::unique_ptr<mjpeg_server> mjpeg_server::start(const mjpeg_args& args)
+	{
+		auto p_internal = mjpeg_server_internal::start(args);
+		if(p_internal == nullptr)
+		{
+			return nullptr;
+		}
+		return std::unique_ptr<mjpeg_server>(new mjpeg_server(std::move(p_internal)));
+	}
+
+	void mjpeg_server::push(const v3::video_frame& frame)
+	{
+		m_internal->push(frame);
+	}
+
+	uint32_t mjpeg_server::num_clients() const
+	{
+		return m_internal->num_clients();
+	}
+
+	mjpeg_server_internal::mjpeg_server_internal(const mjpeg_args& args)
+		: m_args(args)
+		, m_p_server(std::make_unique<httplib::Server>())
+		, m_pending(std::max(args.num_encode_threads, 1u))
+	{
+		// a thread per viewer, and 1 for the page
+		const size_t num_workers = std::max(m_args.max_clients, 1u) + 1;
+		m_p_server->new_task_queue = [num_workers]() { return new httplib::ThreadPool(num_workers); };
+
+		m_p_server->Get("/", [](const httplib::Request&, httplib::Response& res)
+		{
+			res.set_content("<html><body style=\"margin:0;background:#000\"><img src=\"/stream\" style=\"width:100%\"></body></html>", "text/html");
+		});
+
+		m_p_server->Get("/stream", [this](const httplib::Request&, httplib::Response& res)
+		{
+			if(m_num_clients.fetch_add(1) >= std::max(m_args.max_clients, 1u))
+			{
+				m_num_clients.fetch_sub(1);
+				res.status = 503;
+				res.set_content("Too many viewers", "text/plain");
+				return;
+			}
+			res.set_header("Cache-Control", "no-cache");
+			auto p_last_index = std::make_shared<uint64_t>(0);
+			res.set_content_provider(std::string("multipart/x-mixed-replace; boundary=") + s_boundary, [this, p_last_index](size_t, httplib::DataSink& sink)
+			{
+				return send_next(*p_last_index, sink.write, sink.is_writable);
+			},
+			[this](bool)
+			{
+				m_num_clients.fetch_sub(1);
+			});
+		});
+
+		for(unsigned int i=0; i<std::max(m_args.num_encode_threads, 1u); i++)
+		{
+			m_encode_threads.emplace_back([this](){ encode_main(); });
+		}
+	}
+
+	mjpeg_server_internal::~mjpeg_server_internal()
+	{
+		m_stop.store(true, std::memory_order_relaxed);
+		{
+			std::lock_guard lock(m_mutex);
+			m_condition.notify_all();
+		}
+		{
+			std::lock_guard lock(m_pending_mutex);
+			m_pending_condition.notify_all();
+		}
+		m_p_server->stop();
+		if(m_p_server_thread != nullptr)
+		{
+			m_p_server_thread->join();
+		}
+		for(auto& thread : m_encode_threads)
+		{
+			thread.join();
+		}
+	}
+
+	std::unique_ptr<mjpeg_server_internal> mjpeg_server_internal::start(const mjpeg_args& args)
+	{
+		auto p_server = std::unique_ptr<mjpeg_server_internal>(new mjpeg_server_internal(args));
+		if(!p_server->m_p_server->bind_to_port("0.0.0.0", (int)args.port))
+		{
+			log("Failed to start the MJPEG server on port '" + std::to_string(args.port) + "'");
+			return nullptr;
+		}
+		httplib::Server* p_http = p_server->m_p_server.get();
+		p_server->m_p_server_thread = std::make_unique<std::thread>([p_http](){ p_http->listen_after_bind(); });
+		log("MJPEG server is running on port '" + std::to_string(args.port) + "'");
+		return p_server;
+	}
+
+	uint32_t mjpeg_server_internal::num_clients() const
+	{
+		return m_num_clients.load(std::memory_order_relaxed);
+	}
+
+	int mjpeg_server_internal::quality() const
+	{
+		// the bytes sent grow with the viewers, so each one gets a smaller frame
+		const uint32_t max_clients = std::max(m_args.max_clients, 2u);
+		const float t = std::clamp((float)(std::max(num_clients(), 1u) - 1) / (float)(max_clients - 1), 0.0f, 1.0f);
+		return std::clamp((int)std::lround((float)m_args.max_quality + t * (float)(m_args.min_quality - m_args.max_quality)), 1, 100);
+	}
+
+	float mjpeg_server_internal::fps() const
+	{
+		return std::max(m_args.max_fps / (float)std::max(num_clients(), 1u), m_args.min_fps);
+	}
+
+	void mjpeg_server_internal::push(const v3::video_frame& frame)
+	{
+		if(num_clients() == 0)
+		{
+			return;
+		}
+		uint64_t index = 0;
+		{
+			std::lock_guard lock(m_push_mutex);
+			const auto now = std::chrono::steady_clock::now();
+			const auto frame_time = std::chrono::duration<float>(1.0f / std::max(fps(), 0.1f));
+			if(now - m_last_push_at < frame_time)
+			{
+				return;
+			}
+			m_last_push_at = now;
+			index = ++m_num_pushed;
+		}
+
+		auto p_frame = std::make_unique<v3::video_frame>(frame);
+		p_frame->index = index; // numbered here, so the frames of a next pipeline come after the ones of the last
+		while(!m_pending.try_push(p_frame))
+		{
+			frame_ptr oldest;
+			m_pending.try_pop(oldest); // the encoders can not keep up, the newest frame wins
+		}
+		std::lock_guard lock(m_pending_mutex); // so an encoder can not miss it between its check and its wait
+		m_pending_condition.notify_one();
+	}
+
+	void mjpeg_server_internal::encode_main()
+	{
+		std::vector<detection> boxes;
+		std::vector<uint8_t> jpeg;
+		while(true)
+		{
+			frame_ptr p_frame;
+			{
+				std::unique_lock lock(m_pending_mutex);
+				m_pending_condition.wait(lock, [&](){ return m_stop.load(std::memory_order_relaxed) || m_pending.try_pop(p_frame); });
+			}
+			if(p_frame == nullptr)
+			{
+				break; // stopped
+			}
+
+			image& source = p_frame->source;
+			if(m_args.draw_boxes)
+			{
+				if(p_frame->tracked)
+				{
+					boxes.clear();
+					for(const auto& t : p_frame->tracks)
+					{
+						boxes.push_back(t.box);
+					}
+				}
+				else
+				{
+					boxes = p_frame->detections;
+				}
+				yolo::internal::draw_detections(source, boxes);
+			}
+
+			jpeg.clear();
+			const int ok = stbi_write_jpg_to_func([](void* p_context, void* p_data, int size)
+			{
+				auto& target = *(std::vector<uint8_t>*)p_context;
+				target.insert(target.end(), (const uint8_t*)p_data, (const uint8_t*)p_data + size);
+			}, &jpeg, (int)source.width_px, (int)source.height_px, 3, source.data.data(), quality());
+			if(ok == 0)
+			{
+				continue;
+			}
+
+			// the whole part, so a viewer gets it with a single write
+			auto p_encoded = std::make_shared<encoded_frame>();
+			p_encoded->index = p_frame->index;
+			const std::string header = std::string("--") + s_boundary + "\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(jpeg.size()) + "\r\n\r\n";
+			p_encoded->data.reserve(header.size() + jpeg.size() + 2);
+			p_encoded->data.insert(p_encoded->data.end(), header.begin(), header.end());
+			p_encoded->data.insert(p_encoded->data.end(), jpeg.begin(), jpeg.end());
+			p_encoded->data.push_back('\r');
+			p_encoded->data.push_back('\n');
+
+			std::lock_guard lock(m_mutex);
+			if(m_latest == nullptr || p_encoded->index > m_latest->index) // an other encoder can have finished a newer frame already
+			{
+				m_latest = std::move(p_encoded);
+				m_condition.notify_all();
+			}
+		}
+	}
+
+	bool mjpeg_server_internal::send_next(uint64_t& last_index, const std::function<bool(const char* p_data, size_t size)>& write, const std::function<bool()>& is_writable)
+	{
+		std::shared_ptr<const encoded_frame> p_frame;
+		{
+			std::unique_lock lock(m_mutex);
+			m_condition.wait_for(lock, std::chrono::milliseconds(200), [&](){ return m_stop.load(std::memory_order_relaxed) || (m_latest != nullptr && m_latest->index > last_index); });
+			if(m_stop.load(std::memory_order_relaxed))
+			{
+				return false;
+			}
+			if(m_latest == nullptr || m_latest->index <= last_index)
+			{
+				return is_writable(); // nothing new yet, checks whether the viewer is still there
+			}
+			p_frame = m_latest;
+		}
+		// sent outside of the lock, so a slow viewer does not hold up the others. it skips the frames that came in meanwhile
+		last_index = p_frame->index;
+		return write((const char*)p_frame->data.data(), p_frame->data.size());
+	}
+}
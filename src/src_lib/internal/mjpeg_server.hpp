@@ -0,0 +1,78 @@
+#ifndef ALL_YOLO_MJPEG_SERVER_HPP
+#define ALL_YOLO_MJPEG_SERVER_HPP
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+#include <yolo.hpp>
+#include "ring_buffer.hpp"
+
+namespace httplib
+{
+	class Server;
+}
+
+namespace yolo::http::server
+{
+	class mjpeg_server_internal
+	{
+		public:
+			~mjpeg_server_internal();
+
+			/// \return nullptr if the port could not be bound
+			static std::unique_ptr<mjpeg_server_internal> start(const mjpeg_args& args);
+
+			void push(const v3::video_frame& frame);
+			[[nodiscard]] uint32_t num_clients() const;
+
+		private:
+			/// a frame as it is sent to the viewers
+			struct encoded_frame
+			{
+				uint64_t 				index = 0; 	// in order of 'push', from 1 on
+				std::vector<uint8_t> 	data; 		// the part header, the JPEG and the trailing "\r\n"
+			};
+
+			using frame_ptr = std::unique_ptr<v3::video_frame>;
+
+			explicit mjpeg_server_internal(const mjpeg_args& args);
+
+			void encode_main();
+
+			/// sends a viewer the latest frame, once there is one newer than 'last_index'
+			/// \return false to end the response ( the viewer left, or the server stops )
+			bool send_next(uint64_t& last_index, const std::function<bool(const char* p_data, size_t size)>& write, const std::function<bool()>& is_writable);
+
+			/// \return quality and frame rate for the viewers that are connected now
+			[[nodiscard]] int 	quality() const;
+			[[nodiscard]] float fps() const;
+
+			const mjpeg_args 						m_args;
+			std::unique_ptr<httplib::Server> 		m_p_server;
+			std::unique_ptr<std::thread> 			m_p_server_thread;
+
+			/// frames waiting for an encoder, the oldest ones are dropped when the encoders can not keep up
+			yolo::internal::ring_buffer<frame_ptr> 	m_pending;
+			std::vector<std::thread> 				m_encode_threads;
+			std::atomic<bool> 						m_stop = false;
+
+			/// the encoders sleep on this until 'push' has a frame for them ( or the server stops ), so they cost nothing while nobody watches
+			std::mutex 								m_pending_mutex;
+			std::condition_variable 				m_pending_condition;
+
+			std::atomic<uint32_t> 					m_num_clients = 0;
+			std::mutex 								m_push_mutex;
+			std::chrono::steady_clock::time_point 	m_last_push_at;
+			uint64_t 								m_num_pushed = 0;
+
+			/// the latest encoded frame, shared by all viewers
+			mutable std::mutex 						m_mutex;
+			std::condition_variable 				m_condition;
+			std::shared_ptr<const encoded_frame> 	m_latest;
+	};
+}
+
+#endif //ALL_YOLO_MJPEG_SERVER_HPP
@@ -0,0 +1,413 @@
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <algorithm>
+#include <condition_variable>
+#include <curl/curl.h>
+#include "mjpeg_source.hpp"
+#include "ring_buffer.hpp"
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	static bool starts_with_no_case(std::string_view text, std::string_view prefix)
+	{
+		return text.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), text.begin(), [](char a, char b){ return tolower(a) == tolower(b); });
+	}
+
+	static std::string_view trim(std::string_view text)
+	{
+		while(!text.empty() && (text.front() == ' ' || text.front() == '\t'))
+		{
+			text.remove_prefix(1);
+		}
+		while(!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r' || text.back() == '\n'))
+		{
+			text.remove_suffix(1);
+		}
+		return text;
+	}
+
+	multipart_parser::multipart_parser(std::string_view boundary)
+		: m_delimiter("--" + std::string(boundary))
+		, m_body_end("\r\n" + m_delimiter)
+		, m_quirk_delimiter(boundary.starts_with("--") ? std::string(boundary) : std::string())
+	{
+	}
+
+	std::optional<std::string> multipart_parser::find_boundary(std::string_view content_type)
+	{
+		const size_t position = content_type.find("boundary=");
+		if(!starts_with_no_case(trim(content_type), "multipart/") || position == std::string_view::npos)
+		{
+			return std::nullopt;
+		}
+		std::string_view boundary = content_type.substr(position + strlen("boundary="));
+		boundary = trim(boundary.substr(0, boundary.find(';')));
+		if(boundary.size() >= 2 && boundary.front() == '"' && boundary.back() == '"')
+		{
+			boundary = boundary.substr(1, boundary.size() - 2);
+		}
+		if(boundary.empty())
+		{
+			return std::nullopt;
+		}
+		return std::string(boundary);
+	}
+
+	std::optional<size_t> multipart_parser::find(std::string_view needle)
+	{
+		const auto it = std::search(m_buffer.begin() + (ptrdiff_t)m_scanned, m_buffer.end(), needle.begin(), needle.end());
+		if(it != m_buffer.end())
+		{
+			return (size_t)(it - m_buffer.begin());
+		}
+		// the needle can still start in the last bytes, once the rest comes in
+		m_scanned = std::max(m_scanned, m_buffer.size() - std::min(m_buffer.size(), needle.size() - 1));
+		return std::nullopt;
+	}
+
+	void multipart_parser::consume(size_t num_bytes)
+	{
+		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + (ptrdiff_t)num_bytes);
+		m_scanned = 0;
+	}
+
+	void multipart_parser::feed(const uint8_t* p_data, size_t num_bytes, const part_callback& on_part)
+	{
+		m_buffer.insert(m_buffer.end(), p_data, p_data + num_bytes);
+		while(true)
+		{
+			switch(m_state)
+			{
+				case state::boundary:
+				{
+					if(!m_quirk_delimiter.empty())
+					{
+						// some cameras put the "--" of the delimiter in the boundary parameter already, so it is not prefixed with another "--"
+						const size_t scanned = m_scanned;
+						const auto position = find(m_delimiter);
+						m_scanned = scanned;
+						const auto quirk_position = find(m_quirk_delimiter);
+						if(!quirk_position.has_value())
+						{
+							consume(m_scanned - std::min<size_t>(m_scanned, 2)); // keeps the 2 bytes the longer delimiter can start earlier
+							return;
+						}
+						if(position != *quirk_position - 2)
+						{
+							m_delimiter = m_quirk_delimiter;
+							m_body_end = "\r\n" + m_delimiter;
+						}
+						m_quirk_delimiter.clear();
+					}
+					const auto position = find(m_delimiter);
+					if(!position.has_value())
+					{
+						consume(m_scanned); // whatever is before a delimiter is preamble, or the trailing "\r\n" of the previous part
+						return;
+					}
+					consume(*position + m_delimiter.size());
+					m_state = state::headers;
+					break;
+				}
+				case state::headers:
+				{
+					// the line the delimiter is on ends first, then the headers follow, up to an empty line
+					const auto position = find("\r\n\r\n");
+					if(!position.has_value())
+					{
+						if(m_buffer.size() > s_max_headers_size)
+						{
+							consume(m_buffer.size());
+							m_state = state::boundary;
+						}
+						return;
+					}
+					m_content_length.reset();
+					const std::string_view headers((const char*)m_buffer.data(), *position);
+					for(size_t start=0; start<headers.size(); )
+					{
+						const size_t end = std::min(headers.find("\r\n", start), headers.size());
+						const std::string_view line = headers.substr(start, end - start);
+						if(starts_with_no_case(line, "content-length:"))
+						{
+							const long long length = atoll(std::string(trim(line.substr(strlen("content-length:")))).c_str());
+							if(length > 0 && (size_t)length <= s_max_part_size)
+							{
+								m_content_length = (size_t)length;
+							}
+						}
+						start = end + 2;
+					}
+					consume(*position + 4);
+					m_state = state::body;
+					break;
+				}
+				case state::body:
+				{
+					if(m_content_length.has_value())
+					{
+						if(m_buffer.size() < *m_content_length)
+						{
+							return;
+						}
+						on_part(std::vector<uint8_t>(m_buffer.begin(), m_buffer.begin() + (ptrdiff_t)*m_content_length));
+						consume(*m_content_length);
+					}
+					else
+					{
+						const auto position = find(m_body_end);
+						if(!position.has_value())
+						{
+							if(m_buffer.size() > s_max_part_size)
+							{
+								log("Dropped an MJPEG part larger than " + std::to_string(s_max_part_size) + " bytes");
+								consume(m_buffer.size());
+								m_state = state::boundary;
+							}
+							return;
+						}
+						on_part(std::vector<uint8_t>(m_buffer.begin(), m_buffer.begin() + (ptrdiff_t)*position));
+						consume(*position);
+					}
+					m_state = state::boundary;
+					break;
+				}
+			}
+		}
+	}
+
+	/// Receives the stream on a thread of its own ( trough curl ), and decodes the JPEGs on a small pool. Latest frame wins: 'read' returns the newest
+	/// decoded frame, and the frames that were decoded ( or received ) while the pipeline was busy are skipped, so a slow pipeline never lags behind the camera.
+	class mjpeg_source : public video_source
+	{
+		public:
+			mjpeg_source(const std::string& url, uint32_t num_decode_threads)
+				: m_url(url)
+				, m_encoded(4)
+				, m_num_decode_threads(std::max(num_decode_threads, 1u))
+			{
+			}
+
+			~mjpeg_source() override
+			{
+				m_stop.store(true, std::memory_order_relaxed);
+				if(m_receive_thread.joinable())
+				{
+					m_receive_thread.join();
+				}
+				for(auto& thread : m_decode_threads)
+				{
+					thread.join();
+				}
+			}
+
+			/// \return false if the connection failed, or the response is not a multipart stream
+			bool start()
+			{
+				m_receive_thread = std::thread([this](){ receive_main(); });
+				std::unique_lock lock(m_mutex);
+				m_condition.wait(lock, [&](){ return m_connected || m_receive_done; });
+				if(!m_connected)
+				{
+					return false;
+				}
+				for(uint32_t i=0; i<m_num_decode_threads; i++)
+				{
+					m_decode_threads.emplace_back([this](){ decode_main(); });
+				}
+				return true;
+			}
+
+			bool read(image& target) override
+			{
+				std::unique_lock lock(m_mutex);
+				m_condition.wait(lock, [&](){ return m_stop.load(std::memory_order_relaxed) || m_latest_index > m_read_index || m_decoders_done == m_num_decode_threads; });
+				if(m_stop.load(std::memory_order_relaxed) || m_latest_index <= m_read_index)
+				{
+					return false;
+				}
+				std::swap(target, m_latest);
+				m_read_index = m_latest_index;
+				return true;
+			}
+
+			void interrupt() override
+			{
+				// curl is aborted from its progress callback, which it calls at least once a second, also while no data comes in
+				std::lock_guard lock(m_mutex);
+				m_stop.store(true, std::memory_order_relaxed);
+				m_condition.notify_all();
+			}
+
+		private:
+			struct encoded_frame
+			{
+				uint64_t 				index = 0;
+				std::vector<uint8_t> 	data;
+			};
+
+			static size_t header_callback(char* p_data, size_t size, size_t count, mjpeg_source* p_this)
+			{
+				const std::string_view line(p_data, size * count);
+				if(starts_with_no_case(line, "content-type:"))
+				{
+					if(auto boundary = multipart_parser::find_boundary(line.substr(strlen("content-type:"))))
+					{
+						p_this->m_parser.emplace(*boundary);
+					}
+					else
+					{
+						p_this->m_parser.reset(); // the headers of a redirect can be followed by the ones of the stream
+					}
+				}
+				return size * count;
+			}
+
+			static size_t write_callback(char* p_data, size_t size, size_t count, mjpeg_source* p_this)
+			{
+				if(p_this->m_stop.load(std::memory_order_relaxed))
+				{
+					return 0;
+				}
+				if(!p_this->m_parser.has_value())
+				{
+					log("'" + p_this->m_url + "' is not an MJPEG stream ( no multipart Content-Type )");
+					return 0;
+				}
+				if(!p_this->m_connected)
+				{
+					std::lock_guard lock(p_this->m_mutex);
+					p_this->m_connected = true;
+					p_this->m_condition.notify_all();
+				}
+				p_this->m_parser->feed((const uint8_t*)p_data, size * count, [&](std::vector<uint8_t>&& body)
+				{
+					p_this->push(std::move(body));
+				});
+				return size * count;
+			}
+
+			static int progress_callback(mjpeg_source* p_this, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+			{
+				return p_this->m_stop.load(std::memory_order_relaxed) ? 1 : 0; // aborts a stream that does not send anything
+			}
+
+			void receive_main()
+			{
+				char error[CURL_ERROR_SIZE] = {0};
+				CURL* curl = curl_easy_init();
+				if(curl != nullptr)
+				{
+					curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error);
+					curl_easy_setopt(curl, CURLOPT_URL, m_url.c_str());
+					curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+					curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+					curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
+					curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L); // gives up on a camera that stops sending, after 10 seconds
+					curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 10L);
+					curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
+					curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+					curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+					curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+					curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+					curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, progress_callback);
+					curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+					const CURLcode result = curl_easy_perform(curl);
+					if(result != CURLE_OK && !m_stop.load(std::memory_order_relaxed))
+					{
+						log("MJPEG stream '" + m_url + "' ended: " + (error[0] != '\0' ? std::string(error) : std::string(curl_easy_strerror(result))));
+					}
+					curl_easy_cleanup(curl);
+				}
+				std::lock_guard lock(m_mutex);
+				m_receive_done = true;
+				m_condition.notify_all();
+			}
+
+			void push(std::vector<uint8_t>&& data)
+			{
+				encoded_frame frame{.index = ++m_num_received, .data = std::move(data)};
+				while(!m_encoded.try_push(frame))
+				{
+					encoded_frame oldest;
+					m_encoded.try_pop(oldest); // the decoders can not keep up, so the oldest one is skipped
+				}
+			}
+
+			void decode_main()
+			{
+				idle_backoff backoff;
+				while(!m_stop.load(std::memory_order_relaxed))
+				{
+					encoded_frame frame;
+					if(!m_encoded.try_pop(frame))
+					{
+						std::unique_lock lock(m_mutex);
+						if(m_receive_done && !m_encoded.try_pop(frame))
+						{
+							break;
+						}
+					}
+					if(frame.data.empty())
+					{
+						backoff.wait();
+						continue;
+					}
+					backoff.reset();
+
+					auto decoded = image::load_from_memory(frame.data.data(), frame.data.size());
+					if(!decoded.has_value())
+					{
+						continue;
+					}
+					std::lock_guard lock(m_mutex);
+					if(frame.index > m_latest_index) // a frame decoded by an other thread can be newer already
+					{
+						m_latest = std::move(*decoded);
+						m_latest_index = frame.index;
+						m_condition.notify_all();
+					}
+				}
+				std::lock_guard lock(m_mutex);
+				m_decoders_done++;
+				m_condition.notify_all();
+			}
+
+			const std::string 				m_url;
+			std::optional<multipart_parser> m_parser; 			// of the receive thread
+			uint64_t 						m_num_received = 0; // of the receive thread
+			ring_buffer<encoded_frame> 		m_encoded;
+			const uint32_t 					m_num_decode_threads;
+			std::atomic<bool> 				m_stop = false;
+
+			std::mutex 						m_mutex;
+			std::condition_variable 		m_condition;
+			bool 							m_connected = false;
+			bool 							m_receive_done = false;
+			uint32_t 						m_decoders_done = 0;
+			image 							m_latest;
+			uint64_t 						m_latest_index = 0;
+			uint64_t 						m_read_index = 0;
+
+			std::thread 					m_receive_thread;
+			std::vector<std::thread> 		m_decode_threads;
+	};
+
+	std::unique_ptr<video_source> open_mjpeg_source(const std::string& url, uint32_t num_decode_threads)
+	{
+		auto p_source = std::make_unique<mjpeg_source>(url, num_decode_threads);
+		if(!p_source->start())
+		{
+			log("Failed to open MJPEG stream '" + url + "'");
+			return nullptr;
+		}
+		return p_source;
+	}
+}
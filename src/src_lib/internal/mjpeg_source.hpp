@@ -0,0 +1,61 @@
+#ifndef ALL_YOLO_MJPEG_SOURCE_HPP
+#define ALL_YOLO_MJPEG_SOURCE_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <string_view>
+#include "video_source.hpp"
+
+namespace yolo::internal
+{
+	/// Splits a multipart/x-mixed-replace body ( as MJPEG cameras stream it ) into its parts, as the bytes come in.
+	/// Uses the Content-Length of a part when it has one, and scans for the next boundary otherwise.
+	class multipart_parser
+	{
+		public:
+			using part_callback = std::function<void(std::vector<uint8_t>&& body)>;
+
+			/// \param boundary as in the Content-Type header
+			explicit multipart_parser(std::string_view boundary);
+
+			/// \param on_part called for every part that was completed by these bytes
+			void feed(const uint8_t* p_data, size_t num_bytes, const part_callback& on_part);
+
+			/// \return the boundary of a Content-Type header value, like "multipart/x-mixed-replace; boundary=frame". nullopt if it has none
+			static std::optional<std::string> find_boundary(std::string_view content_type);
+
+		private:
+			enum class state
+			{
+				boundary,
+				headers,
+				body
+			};
+
+			/// \return position of 'needle' in 'm_buffer', searching from 'm_scanned' on ( which is moved forward to where the search can continue next time )
+			std::optional<size_t> find(std::string_view needle);
+			void consume(size_t num_bytes);
+
+			/// a part that grows larger than this is dropped, so a broken stream can not take all memory
+			static constexpr size_t s_max_part_size = 32 * 1024 * 1024;
+			static constexpr size_t s_max_headers_size = 16 * 1024;
+
+			std::string 			m_delimiter; 		// "--" + boundary
+			std::string 			m_body_end; 		// "\r\n" + delimiter
+			std::string 			m_quirk_delimiter; 	// the boundary itself, if it starts with "--". cleared once the stream showed which of the 2 it uses
+			std::vector<uint8_t> 	m_buffer;
+			size_t 					m_scanned = 0;
+			state 					m_state = state::boundary;
+			std::optional<size_t> 	m_content_length;
+	};
+
+	/// \param url http(s) url of an MJPEG stream ( multipart/x-mixed-replace )
+	/// \param num_decode_threads threads that decode the JPEGs, so the decoding keeps up with cameras that stream more pixels than a single core can decode
+	/// \return nullptr if the connection failed, or the url is not an MJPEG stream
+	std::unique_ptr<video_source> open_mjpeg_source(const std::string& url, uint32_t num_decode_threads = 2);
+}
+
+#endif //ALL_YOLO_MJPEG_SOURCE_HPP
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstdlib>
+#include "motion_gate.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MOTION_GATE_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MOTION_GATE_NEON
+#endif
+
+namespace yolo::internal
+{
+	struct kernels
+	{
+		/// p_cell_sums[i] += sum of |a - b| over the 16 bytes of cell i, for a row of 'num_cells' cells
+		void (*add_cell_sad)(const uint8_t* a, const uint8_t* b, size_t num_cells, uint32_t* p_cell_sums);
+
+		std::string_view name;
+	};
+
+	static void add_cell_sad_scalar(const uint8_t* a, const uint8_t* b, size_t num_cells, uint32_t* p_cell_sums)
+	{
+		for(size_t cell=0; cell<num_cells; cell++)
+		{
+			uint32_t sum = 0;
+			for(size_t i=cell*16; i<(cell+1)*16; i++)
+			{
+				sum += (uint32_t)std::abs((int32_t)a[i] - (int32_t)b[i]);
+			}
+			p_cell_sums[cell] += sum;
+		}
+	}
+
+#ifdef MOTION_GATE_X86
+	__attribute__((target("sse2")))
+	static void add_cell_sad_sse2(const uint8_t* a, const uint8_t* b, size_t num_cells, uint32_t* p_cell_sums)
+	{
+		for(size_t cell=0; cell<num_cells; cell++)
+		{
+			// psadbw: the sums of both 8 byte halves, in the low bits of the 2 64 bit lanes
+			const __m128i sad = _mm_sad_epu8(_mm_loadu_si128((const __m128i*)&a[cell * 16]), _mm_loadu_si128((const __m128i*)&b[cell * 16]));
+			p_cell_sums[cell] += (uint32_t)(_mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4));
+		}
+	}
+
+	__attribute__((target("avx2")))
+	static void add_cell_sad_avx2(const uint8_t* a, const uint8_t* b, size_t num_cells, uint32_t* p_cell_sums)
+	{
+		size_t cell = 0;
+		for(; cell+2<=num_cells; cell+=2)
+		{
+			const __m256i sad = _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)&a[cell * 16]), _mm256_loadu_si256((const __m256i*)&b[cell * 16]));
+			const __m128i lo = _mm256_castsi256_si128(sad);
+			const __m128i hi = _mm256_extracti128_si256(sad, 1);
+			p_cell_sums[cell] += (uint32_t)(_mm_cvtsi128_si32(lo) + _mm_extract_epi16(lo, 4));
+			p_cell_sums[cell + 1] += (uint32_t)(_mm_cvtsi128_si32(hi) + _mm_extract_epi16(hi, 4));
+		}
+		add_cell_sad_sse2(&a[cell * 16], &b[cell * 16], num_cells - cell, &p_cell_sums[cell]);
+	}
+#endif
+
+#ifdef MOTION_GATE_NEON
+	static void add_cell_sad_neon(const uint8_t* a, const uint8_t* b, size_t num_cells, uint32_t* p_cell_sums)
+	{
+		for(size_t cell=0; cell<num_cells; cell++)
+		{
+			const uint8x16_t diff = vabdq_u8(vld1q_u8(&a[cell * 16]), vld1q_u8(&b[cell * 16]));
+			const uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(diff)));
+			p_cell_sums[cell] += (uint32_t)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+		}
+	}
+#endif
+
+	static const kernels& select_kernels()
+	{
+		static const kernels s_kernels = []()
+		{
+#ifdef MOTION_GATE_X86
+			if(__builtin_cpu_supports("avx2"))
+			{
+				return kernels{add_cell_sad_avx2, "avx2"};
+			}
+			if(__builtin_cpu_supports("sse2"))
+			{
+				return kernels{add_cell_sad_sse2, "sse2"};
+			}
+#endif
+#ifdef MOTION_GATE_NEON
+			return kernels{add_cell_sad_neon, "neon"};
+#endif
+			return kernels{add_cell_sad_scalar, "scalar"};
+		}();
+		return s_kernels;
+	}
+
+	motion_gate::motion_gate(const v3::motion_gate_args& args)
+		: m_args(args)
+	{
+	}
+
+	std::string_view motion_gate::isa()
+	{
+		return select_kernels().name;
+	}
+
+	void motion_gate::reset()
+	{
+		m_key_frame.clear();
+	}
+
+	void motion_gate::downscale(const image& frame, std::vector<uint8_t>& target) const
+	{
+		const float left = std::clamp(m_args.left, 0.0f, 1.0f) * (float)frame.width_px;
+		const float top = std::clamp(m_args.top, 0.0f, 1.0f) * (float)frame.height_px;
+		const float step_x = std::clamp(m_args.width, 0.0f, 1.0f) * (float)frame.width_px / (float)s_width;
+		const float step_y = std::clamp(m_args.height, 0.0f, 1.0f) * (float)frame.height_px / (float)m_height;
+		const auto max_x = (int32_t)frame.width_px - 1;
+		const auto max_y = (int32_t)frame.height_px - 1;
+
+		// averages 2x2 samples per pixel, which takes out most of the sensor noise without reading the whole frame
+		target.resize((size_t)s_width * m_height);
+		for(uint32_t y=0; y<m_height; y++)
+		{
+			const uint8_t* rows[2];
+			for(int32_t i=0; i<2; i++)
+			{
+				const auto sy = std::min((int32_t)(top + ((float)y + 0.25f + 0.5f * (float)i) * step_y), max_y);
+				rows[i] = &frame.data[(size_t)sy * frame.width_px * 3];
+			}
+			uint8_t* p_target = &target[(size_t)y * s_width];
+			for(uint32_t x=0; x<s_width; x++)
+			{
+				uint32_t sum = 0;
+				for(int32_t i=0; i<2; i++)
+				{
+					const auto sx = std::min((int32_t)(left + ((float)x + 0.25f + 0.5f * (float)i) * step_x), max_x);
+					for(const uint8_t* p_row : rows)
+					{
+						const uint8_t* p = &p_row[sx * 3];
+						sum += 77u * p[0] + 150u * p[1] + 29u * p[2]; // BT.601 luma, in 8 bit fixed point
+					}
+				}
+				p_target[x] = (uint8_t)(sum >> 10);
+			}
+		}
+	}
+
+	bool motion_gate::changed(const image& frame)
+	{
+		if(frame.width_px != m_source_width || frame.height_px != m_source_height)
+		{
+			// the cells stay square: the height follows the aspect ratio of the watched region, in whole cells
+			const float aspect = (std::clamp(m_args.height, 0.01f, 1.0f) * (float)frame.height_px) / (std::clamp(m_args.width, 0.01f, 1.0f) * (float)frame.width_px);
+			const auto num_rows = std::max((uint32_t)((float)s_width * aspect / (float)s_cell_size + 0.5f), 1u);
+			m_height = num_rows * s_cell_size;
+			m_source_width = frame.width_px;
+			m_source_height = frame.height_px;
+			m_key_frame.clear();
+		}
+
+		downscale(frame, m_frame);
+		bool is_changed = m_key_frame.empty() || (m_args.max_skipped_frames != 0 && m_skipped >= m_args.max_skipped_frames);
+		if(!is_changed)
+		{
+			const kernels& k = select_kernels();
+			const uint32_t num_columns = s_width / s_cell_size;
+			const auto max_cell_sum = (uint32_t)(m_args.threshold * (float)(s_cell_size * s_cell_size));
+			for(uint32_t cell_y=0; cell_y<m_height / s_cell_size && !is_changed; cell_y++)
+			{
+				m_cell_sums.assign(num_columns, 0);
+				for(uint32_t y=cell_y*s_cell_size; y<(cell_y+1)*s_cell_size; y++)
+				{
+					const size_t offset = (size_t)y * s_width;
+					k.add_cell_sad(&m_frame[offset], &m_key_frame[offset], num_columns, m_cell_sums.data());
+				}
+				is_changed = std::any_of(m_cell_sums.begin(), m_cell_sums.end(), [&](uint32_t v){ return v > max_cell_sum; });
+			}
+		}
+
+		if(is_changed)
+		{
+			std::swap(m_key_frame, m_frame);
+			m_skipped = 0;
+			return true;
+		}
+		m_skipped++;
+		return false;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef ALL_YOLO_MOTION_GATE_HPP
+#define ALL_YOLO_MOTION_GATE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include <yolo.hpp>
+
+namespace yolo::internal
+{
+	/// Change detector for the 'video_pipeline' ( see 'v3::motion_gate_args' ). Compares a downscaled gray copy of the watched region to the one of the
+	/// last key frame ( the last frame 'changed' returned true for ), with a vectorized sum of absolute differences per cell of 16x16 pixels.
+	class motion_gate
+	{
+		public:
+			explicit motion_gate(const v3::motion_gate_args& args);
+
+			/// \return true if 'frame' is to run the forward pass: a cell changed since the key frame, the size of the frames changed, or
+			///         'max_skipped_frames' were skipped. 'frame' becomes the new key frame then
+			bool 					changed(const image& frame);
+
+									/// makes the next frame a key frame, whether it changed or not
+			void 					reset();
+
+									/// name of the instruction set the differences are computed with on this machine
+			static std::string_view isa();
+
+		private:
+			void 					downscale(const image& frame, std::vector<uint8_t>& target) const;
+
+			/// width of the downscaled region, 10 cells. small enough to be cheap, large enough for a person at 20 meters
+			static constexpr uint32_t s_width = 160;
+			static constexpr uint32_t s_cell_size = 16;
+
+			const v3::motion_gate_args 	m_args;
+			uint32_t 					m_height = 0;
+			uint32_t 					m_source_width = 0;
+			uint32_t 					m_source_height = 0;
+			std::vector<uint8_t> 		m_key_frame;
+			std::vector<uint8_t> 		m_frame;
+			std::vector<uint32_t> 		m_cell_sums;
+			uint32_t 					m_skipped = 0;
+	};
+}
+
+#endif //ALL_YOLO_MOTION_GATE_HPP
@@ -0,0 +1,227 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "preprocess.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PREPROCESS_X86
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PREPROCESS_NEON
+#endif
+
+namespace yolo::internal
+{
+	/// per source column pair ( index of the 1st channel in the interleaved row ) and blend factor, for every destination column
+	struct column_table
+	{
+		std::vector<int32_t> 	x0;
+		std::vector<int32_t> 	x1;
+		std::vector<float> 		fx;
+	};
+
+	struct kernels
+	{
+		/// out[i] = r0[i] * w0 + r1[i] * w1
+		void (*blend_rows)(const uint8_t* r0, const uint8_t* r1, float w0, float w1, float* out, size_t n);
+
+		/// out_c[x] = row[x0[x]+c] * (1-fx[x]) + row[x1[x]+c] * fx[x], for c in r,g,b
+		void (*blend_columns)(const float* row, const column_table& table, float* out_r, float* out_g, float* out_b, size_t n);
+
+		std::string_view name;
+	};
+
+	static void blend_rows_scalar(const uint8_t* r0, const uint8_t* r1, float w0, float w1, float* out, size_t n)
+	{
+		for(size_t i=0; i<n; i++)
+		{
+			out[i] = (float)r0[i] * w0 + (float)r1[i] * w1;
+		}
+	}
+
+	static void blend_columns_scalar(const float* row, const column_table& table, float* out_r, float* out_g, float* out_b, size_t n)
+	{
+		for(size_t x=0; x<n; x++)
+		{
+			const float* a = &row[table.x0[x]];
+			const float* b = &row[table.x1[x]];
+			const float f = table.fx[x];
+			out_r[x] = a[0] + f * (b[0] - a[0]);
+			out_g[x] = a[1] + f * (b[1] - a[1]);
+			out_b[x] = a[2] + f * (b[2] - a[2]);
+		}
+	}
+
+#ifdef PREPROCESS_X86
+	__attribute__((target("avx2,fma")))
+	static void blend_rows_avx2(const uint8_t* r0, const uint8_t* r1, float w0, float w1, float* out, size_t n)
+	{
+		const __m256 vw0 = _mm256_set1_ps(w0);
+		const __m256 vw1 = _mm256_set1_ps(w1);
+		size_t i = 0;
+		for(; i+8<=n; i+=8)
+		{
+			const __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&r0[i])));
+			const __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&r1[i])));
+			_mm256_storeu_ps(&out[i], _mm256_fmadd_ps(b, vw1, _mm256_mul_ps(a, vw0)));
+		}
+		blend_rows_scalar(&r0[i], &r1[i], w0, w1, &out[i], n - i);
+	}
+
+	__attribute__((target("avx2,fma")))
+	static void blend_columns_avx2(const float* row, const column_table& table, float* out_r, float* out_g, float* out_b, size_t n)
+	{
+		float* outs[3] = {out_r, out_g, out_b};
+		size_t x = 0;
+		for(; x+8<=n; x+=8)
+		{
+			const __m256i i0 = _mm256_loadu_si256((const __m256i*)&table.x0[x]);
+			const __m256i i1 = _mm256_loadu_si256((const __m256i*)&table.x1[x]);
+			const __m256 f = _mm256_loadu_ps(&table.fx[x]);
+			for(int c=0; c<3; c++)
+			{
+				const __m256 a = _mm256_i32gather_ps(row + c, i0, 4);
+				const __m256 b = _mm256_i32gather_ps(row + c, i1, 4);
+				_mm256_storeu_ps(&outs[c][x], _mm256_fmadd_ps(f, _mm256_sub_ps(b, a), a));
+			}
+		}
+		for(; x<n; x++)
+		{
+			const float* a = &row[table.x0[x]];
+			const float* b = &row[table.x1[x]];
+			const float f = table.fx[x];
+			out_r[x] = a[0] + f * (b[0] - a[0]);
+			out_g[x] = a[1] + f * (b[1] - a[1]);
+			out_b[x] = a[2] + f * (b[2] - a[2]);
+		}
+	}
+#endif
+
+#ifdef PREPROCESS_NEON
+	static void blend_rows_neon(const uint8_t* r0, const uint8_t* r1, float w0, float w1, float* out, size_t n)
+	{
+		const float32x4_t vw0 = vdupq_n_f32(w0);
+		const float32x4_t vw1 = vdupq_n_f32(w1);
+		size_t i = 0;
+		for(; i+8<=n; i+=8)
+		{
+			const uint16x8_t a = vmovl_u8(vld1_u8(&r0[i]));
+			const uint16x8_t b = vmovl_u8(vld1_u8(&r1[i]));
+			const float32x4_t a_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(a)));
+			const float32x4_t a_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(a)));
+			const float32x4_t b_lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(b)));
+			const float32x4_t b_hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(b)));
+			vst1q_f32(&out[i], vmlaq_f32(vmulq_f32(a_lo, vw0), b_lo, vw1));
+			vst1q_f32(&out[i+4], vmlaq_f32(vmulq_f32(a_hi, vw0), b_hi, vw1));
+		}
+		blend_rows_scalar(&r0[i], &r1[i], w0, w1, &out[i], n - i);
+	}
+#endif
+
+	static const kernels& select_kernels()
+	{
+		static const kernels s_kernels = []()
+		{
+#ifdef PREPROCESS_X86
+			if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			{
+				return kernels{blend_rows_avx2, blend_columns_avx2, "avx2"};
+			}
+#endif
+#ifdef PREPROCESS_NEON
+			return kernels{blend_rows_neon, blend_columns_scalar, "neon"}; // no gather on neon, only the row blending is vectorized
+#endif
+			return kernels{blend_rows_scalar, blend_columns_scalar, "scalar"};
+		}();
+		return s_kernels;
+	}
+
+	std::string_view to_network_input_isa()
+	{
+		return select_kernels().name;
+	}
+
+	static void fill(float* p_dest, size_t n, float value)
+	{
+		std::fill(p_dest, p_dest + n, value);
+	}
+
+	void to_network_input(const uint8_t* p_source, uint32_t source_width, uint32_t source_height, float* p_dest, uint32_t dest_width, uint32_t dest_height, bool letter_box)
+	{
+		const kernels& k = select_kernels();
+
+		// area of the destination the image is scaled into
+		uint32_t scaled_width = dest_width;
+		uint32_t scaled_height = dest_height;
+		if(letter_box)
+		{
+			if(((float)dest_width / (float)source_width) < ((float)dest_height / (float)source_height))
+			{
+				scaled_height = (source_height * dest_width) / source_width;
+			}
+			else
+			{
+				scaled_width = (source_width * dest_height) / source_height;
+			}
+		}
+		const uint32_t offset_x = (dest_width - scaled_width) / 2;
+		const uint32_t offset_y = (dest_height - scaled_height) / 2;
+		const size_t plane_size = (size_t)dest_width * dest_height;
+
+		// same 'align corners' mapping as darknet's 'resize_image'
+		const float w_scale = scaled_width > 1 ? (float)(source_width - 1) / (float)(scaled_width - 1) : 0.0f;
+		const float h_scale = scaled_height > 1 ? (float)(source_height - 1) / (float)(scaled_height - 1) : 0.0f;
+
+		thread_local column_table s_table;
+		thread_local std::vector<float> s_row;
+		s_table.x0.resize(scaled_width);
+		s_table.x1.resize(scaled_width);
+		s_table.fx.resize(scaled_width);
+		s_row.resize((size_t)source_width * 3);
+
+		for(uint32_t x=0; x<scaled_width; x++)
+		{
+			const float sx = (float)x * w_scale;
+			const bool is_last = x == scaled_width - 1 || source_width == 1;
+			const uint32_t ix = is_last ? source_width - 1 : std::min((uint32_t)sx, source_width - 1);
+			s_table.x0[x] = (int32_t)(ix * 3);
+			s_table.x1[x] = (int32_t)((is_last ? ix : std::min(ix + 1, source_width - 1)) * 3);
+			s_table.fx[x] = is_last ? 0.0f : sx - (float)ix;
+		}
+
+		const size_t source_stride = (size_t)source_width * 3;
+		for(uint32_t y=0; y<dest_height; y++)
+		{
+			float* p_r = &p_dest[(size_t)y * dest_width];
+			float* p_g = p_r + plane_size;
+			float* p_b = p_g + plane_size;
+
+			if(y < offset_y || y >= offset_y + scaled_height)
+			{
+				fill(p_r, dest_width, 0.5f);
+				fill(p_g, dest_width, 0.5f);
+				fill(p_b, dest_width, 0.5f);
+				continue;
+			}
+
+			const uint32_t sy_index = y - offset_y;
+			const float sy = (float)sy_index * h_scale;
+			const uint32_t iy = std::min((uint32_t)sy, source_height - 1);
+			const bool is_last = sy_index == scaled_height - 1 || source_height == 1;
+			const uint32_t iy1 = is_last ? iy : std::min(iy + 1, source_height - 1);
+			const float fy = is_last ? 0.0f : sy - (float)iy;
+
+			k.blend_rows(&p_source[iy * source_stride], &p_source[iy1 * source_stride], (1.0f - fy) / 255.0f, fy / 255.0f, s_row.data(), source_stride);
+
+			fill(p_r, offset_x, 0.5f);
+			fill(p_g, offset_x, 0.5f);
+			fill(p_b, offset_x, 0.5f);
+			k.blend_columns(s_row.data(), s_table, p_r + offset_x, p_g + offset_x, p_b + offset_x, scaled_width);
+			const uint32_t remainder = dest_width - offset_x - scaled_width;
+			fill(p_r + offset_x + scaled_width, remainder, 0.5f);
+			fill(p_g + offset_x + scaled_width, remainder, 0.5f);
+			fill(p_b + offset_x + scaled_width, remainder, 0.5f);
+		}
+	}
+}
@@ -0,0 +1,19 @@
+#ifndef ALL_YOLO_PREPROCESS_HPP
+#define ALL_YOLO_PREPROCESS_HPP
+
+#include <cstdint>
+#include <string_view>
+
+namespace yolo::internal
+{
+	/// Scales the interleaved rgb8 'p_source' ( bilinear, matching darknet's 'resize_image' ) straight into the planar float layout the network takes as input ( range 0 - 1 ).
+	/// Resizing, de-interleaving and normalizing is done in a single pass, vectorized with AVX2 or NEON when available.
+	/// \param p_dest dest_width * dest_height * 3 floats
+	/// \param letter_box keeps the aspect ratio ( matching darknet's 'letterbox_image' ), the remainder is filled with 0.5
+	void 				to_network_input(const uint8_t* p_source, uint32_t source_width, uint32_t source_height, float* p_dest, uint32_t dest_width, uint32_t dest_height, bool letter_box);
+
+						/// name of the instruction set 'to_network_input' dispatched to on this machine
+	std::string_view 	to_network_input_isa();
+}
+
+#endif //ALL_YOLO_PREPROCESS_HPP
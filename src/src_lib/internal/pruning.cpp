@@ -0,0 +1,706 @@
+#include <cmath>
+#include <cstring>
+#include <charconv>
+#include <fstream>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include "pruning.hpp"
+#include "mapped_file.hpp"
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	std::string load_model_template(const std::filesystem::path& folder, const std::string_view& default_template)
+	{
+		const std::filesystem::path filepath = folder / s_model_template_filename;
+		if(!std::filesystem::exists(filepath))
+		{
+			return std::string(default_template);
+		}
+		std::ifstream file(filepath);
+		if(!file.is_open())
+		{
+			log("Failed to open '" + filepath.string() + "', using the default model");
+			return std::string(default_template);
+		}
+		return {(std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>()};
+	}
+
+	struct section
+	{
+		std::string 									name;
+		std::unordered_map<std::string, std::string> 	values;
+
+		[[nodiscard]] std::string get(const std::string& key, const std::string& default_value) const
+		{
+			auto it = values.find(key);
+			return it != values.end() ? it->second : default_value;
+		}
+
+		[[nodiscard]] int get(const std::string& key, int default_value) const
+		{
+			auto it = values.find(key);
+			return it != values.end() ? atoi(it->second.c_str()) : default_value;
+		}
+	};
+
+	static std::string trim(const std::string_view& str)
+	{
+		const size_t start = str.find_first_not_of(" \t\r");
+		if(start == std::string_view::npos)
+		{
+			return "";
+		}
+		const size_t end = str.find_last_not_of(" \t\r");
+		return std::string(str.substr(start, end - start + 1));
+	}
+
+	static std::vector<section> parse_sections(const std::vector<std::string>& lines)
+	{
+		std::vector<section> sections;
+		for(const auto& v : lines)
+		{
+			const std::string line = trim(v);
+			if(line.empty() || line[0] == '#' || line[0] == ';')
+			{
+				continue;
+			}
+			if(line[0] == '[')
+			{
+				sections.push_back({.name = trim(line.substr(1, line.find(']') - 1)), .values = {}});
+				continue;
+			}
+			const size_t equals = line.find('=');
+			if(equals != std::string::npos && !sections.empty())
+			{
+				sections.back().values[trim(line.substr(0, equals))] = trim(line.substr(equals + 1));
+			}
+		}
+		return sections;
+	}
+
+	struct model_layer
+	{
+		enum class kind
+		{
+			convolutional,
+			shortcut,
+			route,
+			upsample,
+			maxpool,
+			yolo
+		};
+
+		kind 					type = kind::convolutional;
+		bool 					batch_normalize = false;
+		std::string 			activation;
+		uint32_t 				size = 1;
+		uint32_t 				stride = 1;
+		uint32_t 				padding = 0;
+		std::vector<uint32_t> 	inputs; 	// the layers a [route] concatenates, or the 2 layers a [shortcut] adds
+
+		uint32_t 				c = 0, h = 0, w = 0;
+		uint32_t 				out_c = 0, out_h = 0, out_w = 0;
+	};
+
+	/// index of a layer given in the cfg, which is relative to 'index' when negative
+	/// \return nullopt if 'value' is not a number ( an empty entry is not layer 0 ), or not a layer before 'index'
+	static std::optional<uint32_t> layer_index(const std::string& value, uint32_t index)
+	{
+		int v = 0;
+		const auto [p_end, error] = std::from_chars(value.data(), value.data() + value.size(), v);
+		if(value.empty() || error != std::errc() || p_end != value.data() + value.size())
+		{
+			return std::nullopt;
+		}
+		const int64_t absolute = v < 0 ? (int64_t)index + v : v;
+		if(absolute < 0 || absolute >= index)
+		{
+			return std::nullopt;
+		}
+		return (uint32_t)absolute;
+	}
+
+	/// the layers and their shapes, the same way darknet's parser derives them
+	static std::optional<std::vector<model_layer>> parse_model(const cfg::cfg& model_cfg)
+	{
+		const auto sections = parse_sections(model_cfg.lines);
+		if(sections.empty() || (sections[0].name != "net" && sections[0].name != "network"))
+		{
+			log("Failed to prune: the cfg does not start with [net]");
+			return std::nullopt;
+		}
+		uint32_t c = (uint32_t)sections[0].get("channels", 0);
+		uint32_t h = (uint32_t)sections[0].get("height", 0);
+		uint32_t w = (uint32_t)sections[0].get("width", 0);
+
+		std::vector<model_layer> layers;
+		for(size_t s=1; s<sections.size(); s++)
+		{
+			const section& sec = sections[s];
+			const auto index = (uint32_t)layers.size();
+			model_layer l;
+			l.c = c;
+			l.h = h;
+			l.w = w;
+			if(sec.name == "convolutional" || sec.name == "conv")
+			{
+				if(sec.get("groups", 1) != 1 || sec.get("dilation", 1) != 1 || sec.get("binary", 0) != 0 || sec.get("xnor", 0) != 0)
+				{
+					log("Failed to prune: layer " + std::to_string(index) + " uses groups, dilation or binary weights");
+					return std::nullopt;
+				}
+				l.type = model_layer::kind::convolutional;
+				l.batch_normalize = sec.get("batch_normalize", 0) != 0;
+				l.activation = sec.get("activation", std::string("logistic"));
+				l.size = (uint32_t)sec.get("size", 1);
+				l.stride = (uint32_t)sec.get("stride", 1);
+				l.padding = sec.get("pad", 0) != 0 ? l.size / 2 : (uint32_t)sec.get("padding", 0);
+				l.out_c = (uint32_t)sec.get("filters", 1);
+				l.out_h = (h + 2 * l.padding - l.size) / l.stride + 1;
+				l.out_w = (w + 2 * l.padding - l.size) / l.stride + 1;
+			}
+			else if(sec.name == "shortcut")
+			{
+				const auto from = layer_index(sec.get("from", std::string()), index);
+				if(index == 0 || !from.has_value() || sec.values.count("weights_type") != 0)
+				{
+					log("Failed to prune: layer " + std::to_string(index) + " is a [shortcut] that is not supported");
+					return std::nullopt;
+				}
+				l.type = model_layer::kind::shortcut;
+				l.activation = sec.get("activation", std::string("linear"));
+				l.inputs = {index - 1, *from};
+				l.out_c = c;
+				l.out_h = h;
+				l.out_w = w;
+			}
+			else if(sec.name == "route")
+			{
+				l.type = model_layer::kind::route;
+				std::string value = sec.get("layers", std::string());
+				for(size_t start=0; start<=value.size();)
+				{
+					size_t end = value.find(',', start);
+					end = end == std::string::npos ? value.size() : end;
+					const auto input = layer_index(trim(value.substr(start, end - start)), index);
+					if(!input.has_value())
+					{
+						log("Failed to prune: layer " + std::to_string(index) + " routes an invalid layer");
+						return std::nullopt;
+					}
+					l.inputs.push_back(*input);
+					start = end + 1;
+				}
+				if(l.inputs.empty() || sec.get("groups", 1) != 1)
+				{
+					log("Failed to prune: layer " + std::to_string(index) + " is a [route] that is not supported");
+					return std::nullopt;
+				}
+				l.out_h = layers[l.inputs[0]].out_h;
+				l.out_w = layers[l.inputs[0]].out_w;
+				for(uint32_t input : l.inputs)
+				{
+					l.out_c += layers[input].out_c;
+				}
+			}
+			else if(sec.name == "upsample")
+			{
+				l.type = model_layer::kind::upsample;
+				l.stride = (uint32_t)sec.get("stride", 2);
+				l.out_c = c;
+				l.out_h = h * l.stride;
+				l.out_w = w * l.stride;
+			}
+			else if(sec.name == "maxpool" || sec.name == "max")
+			{
+				l.type = model_layer::kind::maxpool;
+				l.stride = (uint32_t)sec.get("stride", 1);
+				l.size = (uint32_t)sec.get("size", (int)l.stride);
+				l.padding = (uint32_t)sec.get("padding", (int)l.size - 1);
+				l.out_c = c;
+				l.out_h = (h + l.padding - l.size) / l.stride + 1;
+				l.out_w = (w + l.padding - l.size) / l.stride + 1;
+			}
+			else if(sec.name == "yolo")
+			{
+				l.type = model_layer::kind::yolo;
+				l.out_c = c;
+				l.out_h = h;
+				l.out_w = w;
+			}
+			else
+			{
+				log("Failed to prune: [" + sec.name + "] layers are not supported");
+				return std::nullopt;
+			}
+			c = l.out_c;
+			h = l.out_h;
+			w = l.out_w;
+			layers.push_back(std::move(l));
+		}
+		return layers;
+	}
+
+	/// \return nullopt for activations that do not map a constant to a known constant
+	static std::optional<float> activate(const std::string& activation, float x)
+	{
+		if(activation == "linear")
+		{
+			return x;
+		}
+		if(activation == "leaky")
+		{
+			return x > 0.0f ? x : 0.1f * x;
+		}
+		if(activation == "relu")
+		{
+			return std::max(x, 0.0f);
+		}
+		if(activation == "logistic")
+		{
+			return 1.0f / (1.0f + std::exp(-x));
+		}
+		return std::nullopt;
+	}
+
+	struct conv_weights
+	{
+		std::vector<float> biases;
+		std::vector<float> scales;
+		std::vector<float> rolling_mean;
+		std::vector<float> rolling_variance;
+		std::vector<float> weights; // [filter][channel][size * size]
+	};
+
+	/// reads the convolutions from a darknet weights file ( a header, then per convolution: biases, [scales, rolling mean, rolling variance,] weights )
+	static std::optional<std::vector<conv_weights>> read_weights(const std::vector<model_layer>& layers, const std::filesystem::path& weights_filepath)
+	{
+		auto p_file = mapped_file::open(weights_filepath);
+		if(p_file == nullptr)
+		{
+			log("Failed to open '" + weights_filepath.string() + "'");
+			return std::nullopt;
+		}
+		int32_t version[3] = {};
+		if(p_file->size() < sizeof(version))
+		{
+			log("'" + weights_filepath.string() + "' is not a weights file");
+			return std::nullopt;
+		}
+		memcpy(version, p_file->data(), sizeof(version));
+		size_t offset = sizeof(version) + ((version[0] * 10 + version[1]) >= 2 ? sizeof(uint64_t) : sizeof(uint32_t));
+
+		auto read = [&](std::vector<float>& target, size_t count)
+		{
+			if(offset + count * sizeof(float) > p_file->size())
+			{
+				return false;
+			}
+			target.resize(count);
+			memcpy(target.data(), p_file->data() + offset, count * sizeof(float));
+			offset += count * sizeof(float);
+			return true;
+		};
+
+		std::vector<conv_weights> convs(layers.size());
+		for(size_t i=0; i<layers.size(); i++)
+		{
+			const model_layer& l = layers[i];
+			if(l.type != model_layer::kind::convolutional)
+			{
+				continue;
+			}
+			conv_weights& v = convs[i];
+			bool ok = read(v.biases, l.out_c);
+			if(l.batch_normalize)
+			{
+				ok = ok && read(v.scales, l.out_c) && read(v.rolling_mean, l.out_c) && read(v.rolling_variance, l.out_c);
+			}
+			ok = ok && read(v.weights, (size_t)l.out_c * l.c * l.size * l.size);
+			if(!ok)
+			{
+				log("'" + weights_filepath.string() + "' is too small for the layers in the cfg ( at layer " + std::to_string(i) + " )");
+				return std::nullopt;
+			}
+		}
+		return convs;
+	}
+
+	static bool write_weights(const std::filesystem::path& filepath, const std::vector<model_layer>& layers, const std::vector<conv_weights>& convs)
+	{
+		std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+		const int32_t version[3] = {0, 2, 5};
+		const uint64_t seen = 0; // fine-tuning starts over, with the burn in of the learning rate
+		file.write((const char*)version, sizeof(version));
+		file.write((const char*)&seen, sizeof(seen));
+		auto write = [&](const std::vector<float>& v)
+		{
+			file.write((const char*)v.data(), (std::streamsize)(v.size() * sizeof(float)));
+		};
+		for(size_t i=0; i<layers.size(); i++)
+		{
+			if(layers[i].type != model_layer::kind::convolutional)
+			{
+				continue;
+			}
+			write(convs[i].biases);
+			if(layers[i].batch_normalize)
+			{
+				write(convs[i].scales);
+				write(convs[i].rolling_mean);
+				write(convs[i].rolling_variance);
+			}
+			write(convs[i].weights);
+		}
+		return file.good();
+	}
+
+	static float bflops(const std::vector<model_layer>& layers)
+	{
+		double flops = 0.0;
+		for(const auto& l : layers)
+		{
+			if(l.type == model_layer::kind::convolutional)
+			{
+				flops += 2.0 * l.out_c * l.c * l.size * l.size * l.out_h * l.out_w;
+			}
+		}
+		return (float)(flops / 1e9);
+	}
+
+	static uint32_t find_root(std::vector<uint32_t>& parents, uint32_t i)
+	{
+		while(parents[i] != i)
+		{
+			parents[i] = parents[parents[i]];
+			i = parents[i];
+		}
+		return i;
+	}
+
+	/// the new filter count of each pruned convolution, in the section of the template that describes it
+	static std::optional<std::string> rewrite_template(const std::string_view& model_template, const std::vector<model_layer>& layers, const std::vector<uint32_t>& original_filters)
+	{
+		std::string target;
+		int64_t layer = -2; // the first section is [net]
+		size_t start = 0;
+		while(start < model_template.size())
+		{
+			size_t end = model_template.find('\n', start);
+			end = end == std::string_view::npos ? model_template.size() : end + 1;
+			const std::string_view line = model_template.substr(start, end - start);
+			const std::string trimmed = trim(line);
+			start = end;
+
+			if(trimmed.starts_with('['))
+			{
+				layer++;
+			}
+			else if(layer >= 0 && layer < (int64_t)layers.size() && trimmed.starts_with("filters") && layers[layer].type == model_layer::kind::convolutional
+				&& layers[layer].out_c != original_filters[layer])
+			{
+				const std::string value = trim(trimmed.substr(trimmed.find('=') + 1));
+				if(value.find("${") != std::string::npos)
+				{
+					log("Failed to prune: the filters of layer " + std::to_string(layer) + " are a variable in the template");
+					return std::nullopt;
+				}
+				target += line.substr(0, line.find_first_not_of(" \t"));
+				target += "filters=" + std::to_string(layers[layer].out_c) + "\n";
+				continue;
+			}
+			target += line;
+		}
+		if(layer + 1 != (int64_t)layers.size())
+		{
+			log("Failed to prune: the template does not match the cfg");
+			return std::nullopt;
+		}
+		return target;
+	}
+
+	std::optional<v3::prune_report> prune(const cfg::cfg& model_cfg, const std::string_view& model_template, const std::filesystem::path& weights_filepath,
+										  const v3::prune_args& args, const std::filesystem::path& target_folder)
+	{
+		auto layers = parse_model(model_cfg);
+		if(!layers.has_value())
+		{
+			return std::nullopt;
+		}
+		auto convs = read_weights(*layers, weights_filepath);
+		if(!convs.has_value())
+		{
+			return std::nullopt;
+		}
+		const size_t num_layers = layers->size();
+
+		// layers that are added together by a [shortcut] must keep the same channels, so they are pruned as 1 unit
+		std::vector<uint32_t> units(num_layers);
+		std::iota(units.begin(), units.end(), 0u);
+		for(size_t i=0; i<num_layers; i++)
+		{
+			const model_layer& l = (*layers)[i];
+			if(l.type != model_layer::kind::shortcut)
+			{
+				continue;
+			}
+			for(uint32_t input : l.inputs)
+			{
+				units[find_root(units, input)] = find_root(units, (uint32_t)i);
+			}
+		}
+
+		// a unit is pruned if it only has batchnormed convolutions and shortcuts ( with activations that keep a constant a constant ), all with the same channels
+		std::vector<bool> is_prunable(num_layers, true);
+		std::vector<bool> has_convolution(num_layers, false);
+		for(size_t i=0; i<num_layers; i++)
+		{
+			const model_layer& l = (*layers)[i];
+			const uint32_t unit = find_root(units, (uint32_t)i);
+			const bool feeds_yolo = i + 1 < num_layers && (*layers)[i + 1].type == model_layer::kind::yolo;
+			if(l.type == model_layer::kind::convolutional)
+			{
+				has_convolution[unit] = true;
+				is_prunable[unit] = is_prunable[unit] && l.batch_normalize && !feeds_yolo && activate(l.activation, 0.0f).has_value() && l.out_c == (*layers)[unit].out_c;
+			}
+			else if(l.type == model_layer::kind::shortcut)
+			{
+				is_prunable[unit] = is_prunable[unit] && !feeds_yolo && activate(l.activation, 0.0f).has_value() && l.out_c == (*layers)[unit].out_c;
+			}
+			else if(unit != i) // the roots of the units are the last [shortcut] of each
+			{
+				log("Failed to prune: a [shortcut] over layer " + std::to_string(i) + " is not supported");
+				return std::nullopt;
+			}
+		}
+
+		// score of a channel of a unit: the largest |gamma| of that channel over the convolutions of the unit
+		std::vector<std::vector<float>> scores(num_layers);
+		std::vector<float> all_scores;
+		for(size_t i=0; i<num_layers; i++)
+		{
+			const model_layer& l = (*layers)[i];
+			const uint32_t unit = find_root(units, (uint32_t)i);
+			if(l.type != model_layer::kind::convolutional || !is_prunable[unit] || !has_convolution[unit])
+			{
+				continue;
+			}
+			scores[unit].resize(l.out_c, 0.0f);
+			for(uint32_t c=0; c<l.out_c; c++)
+			{
+				scores[unit][c] = std::max(scores[unit][c], std::fabs((*convs)[i].scales[c]));
+			}
+		}
+		for(const auto& v : scores)
+		{
+			all_scores.insert(all_scores.end(), v.begin(), v.end());
+		}
+		if(all_scores.empty())
+		{
+			log("Failed to prune: there are no layers with batchnorm to prune");
+			return std::nullopt;
+		}
+		std::sort(all_scores.begin(), all_scores.end());
+		const float threshold = all_scores[std::min((size_t)(std::clamp(args.ratio, 0.0f, 1.0f) * (float)all_scores.size()), all_scores.size() - 1)];
+
+		// the channels each unit keeps: the ones above the threshold, topped up to the minimum and to a multiple of 'channel_multiple' with the next best ones
+		std::vector<std::vector<bool>> unit_kept(num_layers);
+		for(size_t unit=0; unit<num_layers; unit++)
+		{
+			const auto& v = scores[unit];
+			if(v.empty())
+			{
+				continue;
+			}
+			const auto num_channels = (uint32_t)v.size();
+			auto num_kept = (uint32_t)std::count_if(v.begin(), v.end(), [&](float score){return score >= threshold;});
+			num_kept = std::max(num_kept, std::min(args.min_channels, num_channels));
+			const uint32_t multiple = std::max(args.channel_multiple, 1u);
+			num_kept = std::min((num_kept + multiple - 1) / multiple * multiple, num_channels);
+
+			std::vector<uint32_t> order(num_channels);
+			std::iota(order.begin(), order.end(), 0u);
+			std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){return v[a] > v[b];});
+			unit_kept[unit].assign(num_channels, false);
+			for(uint32_t k=0; k<num_kept; k++)
+			{
+				unit_kept[unit][order[k]] = true;
+			}
+		}
+
+		// which output channels each layer keeps, and what the removed ones would have been ( a constant, as their gamma is ~0 )
+		std::vector<std::vector<bool>> kept(num_layers);
+		std::vector<std::vector<float>> constants(num_layers);
+		const std::vector<uint32_t> original_filters = [&]()
+		{
+			std::vector<uint32_t> v(num_layers);
+			for(size_t i=0; i<num_layers; i++)
+			{
+				v[i] = (*layers)[i].out_c;
+			}
+			return v;
+		}();
+		uint32_t num_channels = 0;
+		uint32_t num_pruned_channels = 0;
+		for(size_t i=0; i<num_layers; i++)
+		{
+			model_layer& l = (*layers)[i];
+			const uint32_t unit = find_root(units, (uint32_t)i);
+			const std::vector<bool> all_input(l.c, true);
+			const std::vector<bool>& input_kept = i > 0 ? kept[i - 1] : all_input;
+			const std::vector<float> no_constants(l.c, 0.0f);
+			const std::vector<float>& input_constants = i > 0 ? constants[i - 1] : no_constants;
+
+			switch(l.type)
+			{
+				case model_layer::kind::convolutional:
+				{
+					conv_weights& v = (*convs)[i];
+					const size_t kernel = (size_t)l.size * l.size;
+
+					// the removed inputs are constants, so their share of the output moves into the bias ( or the mean the batchnorm subtracts ).
+					// this is exact away from the borders, where the padding reads zeros instead
+					for(uint32_t o=0; o<l.out_c; o++)
+					{
+						double shift = 0.0;
+						for(uint32_t c=0; c<l.c; c++)
+						{
+							if(input_kept[c] || input_constants[c] == 0.0f)
+							{
+								continue;
+							}
+							const float* p_kernel = &v.weights[((size_t)o * l.c + c) * kernel];
+							shift += (double)input_constants[c] * std::accumulate(p_kernel, p_kernel + kernel, 0.0);
+						}
+						if(l.batch_normalize)
+						{
+							v.rolling_mean[o] -= (float)shift;
+						}
+						else
+						{
+							v.biases[o] += (float)shift;
+						}
+					}
+
+					kept[i] = !unit_kept[unit].empty() ? unit_kept[unit] : std::vector<bool>(l.out_c, true);
+					constants[i].assign(l.out_c, 0.0f);
+					conv_weights pruned;
+					for(uint32_t o=0; o<l.out_c; o++)
+					{
+						if(!kept[i][o])
+						{
+							constants[i][o] = *activate(l.activation, v.biases[o]);
+							continue;
+						}
+						pruned.biases.push_back(v.biases[o]);
+						if(l.batch_normalize)
+						{
+							pruned.scales.push_back(v.scales[o]);
+							pruned.rolling_mean.push_back(v.rolling_mean[o]);
+							pruned.rolling_variance.push_back(v.rolling_variance[o]);
+						}
+						for(uint32_t c=0; c<l.c; c++)
+						{
+							if(input_kept[c])
+							{
+								const float* p_kernel = &v.weights[((size_t)o * l.c + c) * kernel];
+								pruned.weights.insert(pruned.weights.end(), p_kernel, p_kernel + kernel);
+							}
+						}
+					}
+					v = std::move(pruned);
+					num_channels += l.out_c;
+					break;
+				}
+				case model_layer::kind::shortcut:
+				{
+					kept[i] = !unit_kept[unit].empty() ? unit_kept[unit] : std::vector<bool>(l.out_c, true);
+					constants[i].assign(l.out_c, 0.0f);
+					for(uint32_t c=0; c<l.out_c; c++)
+					{
+						if(!kept[i][c])
+						{
+							constants[i][c] = *activate(l.activation, constants[l.inputs[0]][c] + constants[l.inputs[1]][c]);
+						}
+					}
+					break;
+				}
+				case model_layer::kind::route:
+				{
+					for(uint32_t input : l.inputs)
+					{
+						kept[i].insert(kept[i].end(), kept[input].begin(), kept[input].end());
+						constants[i].insert(constants[i].end(), constants[input].begin(), constants[input].end());
+					}
+					break;
+				}
+				default:
+				{
+					kept[i] = input_kept;
+					constants[i] = input_constants;
+					break;
+				}
+			}
+		}
+
+		// the new shapes
+		v3::prune_report report;
+		report.bflops_before = bflops(*layers);
+		report.num_channels = num_channels;
+		for(size_t i=0; i<num_layers; i++)
+		{
+			model_layer& l = (*layers)[i];
+			l.c = i > 0 ? (*layers)[i - 1].out_c : l.c;
+			if(l.type == model_layer::kind::route)
+			{
+				l.out_c = 0;
+				for(uint32_t input : l.inputs)
+				{
+					l.out_c += (*layers)[input].out_c;
+				}
+			}
+			else
+			{
+				l.out_c = (uint32_t)std::count(kept[i].begin(), kept[i].end(), true);
+			}
+			if(l.type == model_layer::kind::convolutional)
+			{
+				num_pruned_channels += original_filters[i] - l.out_c;
+			}
+		}
+		report.num_pruned_channels = num_pruned_channels;
+		report.bflops_after = bflops(*layers);
+
+		const auto pruned_template = rewrite_template(model_template, *layers, original_filters);
+		if(!pruned_template.has_value())
+		{
+			return std::nullopt;
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(target_folder, ec);
+		const std::filesystem::path template_filepath = target_folder / s_model_template_filename;
+		{
+			std::ofstream file(template_filepath, std::ios::trunc);
+			file << *pruned_template;
+			if(!file.good())
+			{
+				log("Failed to write '" + template_filepath.string() + "'");
+				return std::nullopt;
+			}
+		}
+		report.weights_path = target_folder / "pruned.weights";
+		if(!write_weights(report.weights_path, *layers, *convs))
+		{
+			log("Failed to write '" + report.weights_path.string() + "'");
+			return std::nullopt;
+		}
+		return report;
+	}
+}
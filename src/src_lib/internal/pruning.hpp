@@ -0,0 +1,30 @@
+#ifndef ALL_YOLO_PRUNING_HPP
+#define ALL_YOLO_PRUNING_HPP
+
+#include <string>
+#include <optional>
+#include <filesystem>
+#include <string_view>
+#include <yolo.hpp>
+#include "cfg.hpp"
+
+namespace yolo::internal
+{
+	/// name of the model template 'prune' writes next to the config. used instead of the built in yolov3 template when present ( see 'load_model_template' )
+	static constexpr const char* s_model_template_filename = "model.cfg";
+
+	/// \return the model template in 'folder' ( see 'prune' ), or 'default_template' if there is none
+	std::string load_model_template(const std::filesystem::path& folder, const std::string_view& default_template);
+
+	/// Removes the channels with the smallest batchnorm scale ( gamma ) from the convolutional layers, and the matching inputs of the layers that read them.
+	/// Convolutions that are added together by [shortcut] layers keep the same channels ( the union of what each of them keeps ).
+	/// The constant output of a removed channel ( its activated batchnorm bias ) is folded into the biases / means of the layers that read it.
+	/// \param model_cfg loaded from 'model_template', describes the layers 'weights_filepath' was trained for
+	/// \param model_template the template 'model_cfg' was loaded from. written to 'target_folder' with the new filter counts
+	/// \param target_folder receives the new template ( 's_model_template_filename' ) and 'pruned.weights'
+	/// \return nullopt if the model has layers that can not be pruned, or reading / writing failed
+	std::optional<v3::prune_report> prune(const cfg::cfg& model_cfg, const std::string_view& model_template, const std::filesystem::path& weights_filepath,
+										  const v3::prune_args& args, const std::filesystem::path& target_folder);
+}
+
+#endif //ALL_YOLO_PRUNING_HPP
@@ -0,0 +1,385 @@
+#include <darknet.h>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include "quantization.hpp"
+#include "darknet_network.hpp"
+#include "internal.hpp"
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	struct int8_header
+	{
+		char 		magic[8];
+		uint64_t 	weights_key;
+		uint32_t 	num_layers;
+		uint32_t 	reserved;
+	};
+	static constexpr char s_int8_magic[8] = {'y', 'o', 'l', 'o', 'i', 'n', 't', '8'};
+
+	/// followed by 'rows' scales, and 'rows * depth_padded' weights
+	struct int8_layer_header
+	{
+		uint32_t 	layer_index;
+		uint32_t 	rows;
+		uint32_t 	depth;
+		float 		input_scale;
+	};
+
+	bool int8_model::save(const std::filesystem::path& filepath) const
+	{
+		std::filesystem::path tmp_filepath = filepath;
+		tmp_filepath += generate_unique_temp_filename("", "tmp").filename();
+		{
+			std::ofstream file(tmp_filepath, std::ios::binary | std::ios::trunc);
+			int8_header header = { .magic = {}, .weights_key = weights_key, .num_layers = (uint32_t)layers.size(), .reserved = 0 };
+			memcpy(header.magic, s_int8_magic, sizeof(s_int8_magic));
+			file.write((const char*)&header, sizeof(header));
+			for(const auto& v : layers)
+			{
+				const int8_weights& weights = v.p_convolution->weights;
+				const int8_layer_header layer_header = { .layer_index = v.layer_index, .rows = weights.rows, .depth = weights.depth, .input_scale = v.p_convolution->input_scale };
+				file.write((const char*)&layer_header, sizeof(layer_header));
+				file.write((const char*)weights.scales.data(), (std::streamsize)(weights.scales.size() * sizeof(float)));
+				file.write((const char*)weights.data.data(), (std::streamsize)weights.data.size());
+			}
+			if(!file.good())
+			{
+				std::error_code ec;
+				std::filesystem::remove(tmp_filepath, ec);
+				return false;
+			}
+		}
+		std::error_code ec;
+		std::filesystem::rename(tmp_filepath, filepath, ec);
+		if(ec)
+		{
+			std::filesystem::remove(tmp_filepath, ec);
+			return false;
+		}
+		return true;
+	}
+
+	std::optional<int8_model> int8_model::load(const std::filesystem::path& filepath, uint64_t weights_key)
+	{
+		std::ifstream file(filepath, std::ios::binary);
+		if(!file.is_open())
+		{
+			log("Failed to open '" + filepath.string() + "'");
+			return std::nullopt;
+		}
+		int8_header header = {};
+		file.read((char*)&header, sizeof(header));
+		if(!file.good() || memcmp(header.magic, s_int8_magic, sizeof(s_int8_magic)) != 0)
+		{
+			log("'" + filepath.string() + "' is not an int8 model");
+			return std::nullopt;
+		}
+		if(header.weights_key != weights_key)
+		{
+			log("'" + filepath.string() + "' was made for other weights");
+			return std::nullopt;
+		}
+
+		int8_model model;
+		model.weights_key = header.weights_key;
+		for(uint32_t i=0; i<header.num_layers; i++)
+		{
+			int8_layer_header layer_header = {};
+			file.read((char*)&layer_header, sizeof(layer_header));
+			if(!file.good() || layer_header.rows == 0 || layer_header.depth == 0)
+			{
+				log("'" + filepath.string() + "' is truncated");
+				return std::nullopt;
+			}
+			const size_t depth_padded = (layer_header.depth + s_int8_depth_alignment - 1) / s_int8_depth_alignment * s_int8_depth_alignment;
+			std::vector<float> scales(layer_header.rows);
+			std::vector<int8_t> data((size_t)layer_header.rows * depth_padded);
+			file.read((char*)scales.data(), (std::streamsize)(scales.size() * sizeof(float)));
+			file.read((char*)data.data(), (std::streamsize)data.size());
+			if(!file.good())
+			{
+				log("'" + filepath.string() + "' is truncated");
+				return std::nullopt;
+			}
+			auto p_convolution = std::make_shared<int8_convolution>();
+			p_convolution->input_scale = layer_header.input_scale;
+			p_convolution->weights = int8_weights::from_quantized(std::move(data), std::move(scales), layer_header.rows, layer_header.depth);
+			model.layers.push_back({.layer_index = layer_header.layer_index, .p_convolution = std::move(p_convolution)});
+		}
+		return model;
+	}
+
+	std::optional<int8_model> calibrate(darknet_network& network, const annotations::annotations_collection& images)
+	{
+		const ::network& net = network.darknet();
+
+		// the first convolution sees the image itself, and the ones in front of a [yolo] layer produce the logits that are decoded
+		std::vector<bool> quantize(net.n, false);
+		bool is_first = true;
+		for(int i=0; i<net.n; i++)
+		{
+			const layer& l = net.layers[i];
+			if(l.type != CONVOLUTIONAL)
+			{
+				continue;
+			}
+			const bool feeds_yolo = i + 1 < net.n && net.layers[i + 1].type == YOLO;
+			quantize[i] = !is_first && !feeds_yolo && can_quantize_convolution(l);
+			is_first = false;
+		}
+
+		// the mean of the largest value per image is less sensitive to outliers than the largest value over all images
+		std::vector<double> sum_max_abs(net.n, 0.0);
+		size_t num_images = 0;
+		for(const auto& v : images)
+		{
+			auto source = image::load(v.filename_img);
+			if(!source.has_value())
+			{
+				continue;
+			}
+			network.set_input(*source, false);
+			network.predict([&](uint32_t layer_index, const layer& l, const float* p_input)
+			{
+				if(!quantize[layer_index])
+				{
+					return;
+				}
+				const size_t num_inputs = (size_t)l.c * l.h * l.w;
+				float max_abs = 0.0f;
+				for(size_t i=0; i<num_inputs; i++)
+				{
+					max_abs = std::max(max_abs, std::fabs(p_input[i]));
+				}
+				sum_max_abs[layer_index] += max_abs;
+			});
+			num_images++;
+		}
+		if(num_images == 0)
+		{
+			log("Failed to load any of the calibration images");
+			return std::nullopt;
+		}
+
+		int8_model model;
+		model.weights_key = network.weights_key();
+		for(int i=0; i<net.n; i++)
+		{
+			if(!quantize[i])
+			{
+				continue;
+			}
+			const layer& l = net.layers[i];
+			auto p_convolution = std::make_shared<int8_convolution>();
+			p_convolution->input_scale = std::max((float)(sum_max_abs[i] / (double)num_images) / 127.0f, 1e-8f);
+			p_convolution->weights = int8_weights::quantize(l.weights, (uint32_t)l.n, (uint32_t)(l.size * l.size * l.c));
+			model.layers.push_back({.layer_index = (uint32_t)i, .p_convolution = std::move(p_convolution)});
+		}
+		return model;
+	}
+
+	/// intersection over union of 2 boxes given by their center and size
+	static float iou(float ax, float ay, float aw, float ah, float bx, float by, float bw, float bh)
+	{
+		const float w = std::min(ax + aw / 2, bx + bw / 2) - std::max(ax - aw / 2, bx - bw / 2);
+		const float h = std::min(ay + ah / 2, by + bh / 2) - std::max(ay - ah / 2, by - bh / 2);
+		if(w <= 0.0f || h <= 0.0f)
+		{
+			return 0.0f;
+		}
+		const float intersection = w * h;
+		return intersection / (aw * ah + bw * bh - intersection);
+	}
+
+	float mean_average_precision(darknet_network& network, const annotations::annotations_collection& images, float& target_ms_per_image)
+	{
+		struct scored_detection
+		{
+			float 	confidence;
+			bool 	true_positive;
+		};
+		std::vector<std::vector<scored_detection>> per_class;
+		std::vector<size_t> num_truths;
+
+		// a low threshold, so the whole precision / recall curve is covered
+		const box_args args = { .thresh = 0.005f };
+		std::vector<detection> detections;
+		double total_ms = 0.0;
+		size_t num_images = 0;
+		for(const auto& v : images)
+		{
+			auto source = image::load(v.filename_img);
+			if(!source.has_value())
+			{
+				continue;
+			}
+			const auto start = std::chrono::steady_clock::now();
+			network.set_input(*source, args.letter_box);
+			network.predict();
+			detections.clear(); // 'get_detections' appends
+			network.get_detections({source->width_px, source->height_px}, args, detections);
+			total_ms += (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+			num_images++;
+
+			for(const auto& truth : v)
+			{
+				if(truth.class_id >= num_truths.size())
+				{
+					num_truths.resize(truth.class_id + 1, 0);
+				}
+				num_truths[truth.class_id]++;
+			}
+
+			// each truth is matched to the most confident detection that overlaps it enough
+			std::sort(detections.begin(), detections.end(), [](const detection& a, const detection& b){return a.confidence > b.confidence;});
+			std::vector<bool> matched(v.size(), false);
+			for(const auto& d : detections)
+			{
+				float best_iou = 0.5f;
+				std::optional<size_t> best;
+				for(size_t i=0; i<v.data.size(); i++)
+				{
+					const auto& truth = v.data[i];
+					if(matched[i] || truth.class_id != d.class_id)
+					{
+						continue;
+					}
+					const float overlap = iou(d.x, d.y, d.w, d.h, truth.x, truth.y, truth.w, truth.h);
+					if(overlap >= best_iou)
+					{
+						best_iou = overlap;
+						best = i;
+					}
+				}
+				if(best.has_value())
+				{
+					matched[*best] = true;
+				}
+				if(d.class_id >= per_class.size())
+				{
+					per_class.resize(d.class_id + 1);
+				}
+				per_class[d.class_id].push_back({.confidence = d.confidence, .true_positive = best.has_value()});
+			}
+		}
+		target_ms_per_image = num_images > 0 ? (float)(total_ms / (double)num_images) : 0.0f;
+
+		// area under the precision / recall curve, where the precision at each recall is the best precision at that recall or above
+		double sum_ap = 0.0;
+		size_t num_classes = 0;
+		per_class.resize(std::max(per_class.size(), num_truths.size()));
+		for(size_t c=0; c<num_truths.size(); c++)
+		{
+			if(num_truths[c] == 0)
+			{
+				continue;
+			}
+			auto& scored = per_class[c];
+			std::sort(scored.begin(), scored.end(), [](const scored_detection& a, const scored_detection& b){return a.confidence > b.confidence;});
+			std::vector<double> precision(scored.size());
+			std::vector<double> recall(scored.size());
+			size_t true_positives = 0;
+			for(size_t i=0; i<scored.size(); i++)
+			{
+				true_positives += scored[i].true_positive ? 1 : 0;
+				precision[i] = (double)true_positives / (double)(i + 1);
+				recall[i] = (double)true_positives / (double)num_truths[c];
+			}
+			for(size_t i=scored.size(); i-- > 1;)
+			{
+				precision[i - 1] = std::max(precision[i - 1], precision[i]);
+			}
+			double ap = 0.0;
+			double previous_recall = 0.0;
+			for(size_t i=0; i<scored.size(); i++)
+			{
+				ap += (recall[i] - previous_recall) * precision[i];
+				previous_recall = recall[i];
+			}
+			sum_ap += ap;
+			num_classes++;
+		}
+		return num_classes > 0 ? (float)(sum_ap / (double)num_classes) : 0.0f;
+	}
+
+	std::optional<v3::quantization_report> quantize(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath, const annotations::annotations_collection& images,
+													const v3::quantize_args& args, const std::filesystem::path& int8_filepath)
+	{
+		std::shared_ptr<darknet_network> p_network = darknet_network::load(model_cfg, weights_filepath);
+		if(p_network == nullptr)
+		{
+			return std::nullopt;
+		}
+		if(p_network->weights_key() == 0)
+		{
+			log("Failed to quantize: the int8 model is tied to memory mapped weights, and '" + weights_filepath.string() + "' could not be mapped");
+			return std::nullopt;
+		}
+
+		// the evaluation images are the ones after the calibration images, so the mAP is not measured on images the ranges were taken from
+		annotations::annotations_collection calibration_images;
+		annotations::annotations_collection evaluation_images;
+		for(size_t i=0; i<images.size(); i++)
+		{
+			if(i < args.num_calibration_images)
+			{
+				calibration_images.data.push_back(images.data[i]);
+			}
+			else if(i < (size_t)args.num_calibration_images + args.num_evaluation_images)
+			{
+				evaluation_images.data.push_back(images.data[i]);
+			}
+		}
+		if(evaluation_images.empty())
+		{
+			log("WARNING: There are no images left after the " + std::to_string(calibration_images.size()) + " calibration images, the mAP is not measured");
+		}
+
+		log("Calibrating on " + std::to_string(calibration_images.size()) + " images...");
+		auto model = calibrate(*p_network, calibration_images);
+		if(!model.has_value())
+		{
+			return std::nullopt;
+		}
+		if(!model->save(int8_filepath))
+		{
+			log("Failed to write '" + int8_filepath.string() + "'");
+			return std::nullopt;
+		}
+
+		v3::quantization_report report;
+		report.artifact_path = int8_filepath;
+		report.num_quantized_layers = (uint32_t)model->layers.size();
+		const ::network& net = p_network->darknet();
+		for(int i=0; i<net.n; i++)
+		{
+			report.num_convolutional_layers += net.layers[i].type == CONVOLUTIONAL ? 1 : 0;
+		}
+		if(evaluation_images.empty())
+		{
+			return report;
+		}
+
+		log("Measuring the mAP of the float network on " + std::to_string(evaluation_images.size()) + " images...");
+		report.map_fp32 = mean_average_precision(*p_network, evaluation_images, report.fp32_ms_per_image);
+
+		// a replica shares the weights, so the float network stays as it is
+		std::shared_ptr<darknet_network> p_int8_network = darknet_network::load_replica(model_cfg, p_network);
+		if(p_int8_network == nullptr || !p_int8_network->use_int8(*model))
+		{
+			return std::nullopt;
+		}
+		log("Measuring the mAP of the int8 network on " + std::to_string(evaluation_images.size()) + " images ( " + std::string(int8_isa()) + " )...");
+		report.map_int8 = mean_average_precision(*p_int8_network, evaluation_images, report.int8_ms_per_image);
+		report.map_delta = report.map_int8 - report.map_fp32;
+		return report;
+	}
+}
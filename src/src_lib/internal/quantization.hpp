@@ -0,0 +1,54 @@
+#ifndef ALL_YOLO_QUANTIZATION_HPP
+#define ALL_YOLO_QUANTIZATION_HPP
+
+#include <memory>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <yolo.hpp>
+#include "annotations.hpp"
+#include "convolution.hpp"
+#include "cfg.hpp"
+
+namespace yolo::internal
+{
+	class darknet_network;
+
+	struct int8_layer
+	{
+		uint32_t 								layer_index = 0;
+		std::shared_ptr<const int8_convolution> p_convolution;
+	};
+
+	/// the convolutions of a network that run in int8, for the weights with the given key ( see 'darknet_network::weights_key' )
+	struct int8_model
+	{
+		uint64_t 				weights_key = 0;
+		std::vector<int8_layer> layers;
+
+								/// \return true if the writing of the file succeeded
+		[[nodiscard]] bool 		save(const std::filesystem::path& filepath) const;
+
+								/// \return nullopt if the file could not be read, or was made for other weights
+		static std::optional<int8_model> load(const std::filesystem::path& filepath, uint64_t weights_key);
+	};
+
+	/// runs 'images' trough the ( float ) network, and quantizes the convolutions with the range of the inputs they saw.
+	/// the first convolution and the convolutions in front of the [yolo] layers stay in float, they are the most sensitive to the loss of precision.
+	/// \param network a network with a batch size of 1
+	/// \return nullopt if none of the images could be loaded
+	std::optional<int8_model> calibrate(darknet_network& network, const annotations::annotations_collection& images);
+
+	/// mAP@0.5 of the network on 'images' ( the mean over the classes of the area under the interpolated precision / recall curve )
+	/// \param network a network with a batch size of 1
+	/// \param target_ms_per_image average time of a single detection ( scaling, forward pass and decoding )
+	float mean_average_precision(darknet_network& network, const annotations::annotations_collection& images, float& target_ms_per_image);
+
+	/// calibrates an int8 model for the network, saves it to 'int8_filepath', and measures the mAP with and without it
+	/// \param model_cfg testing cfg with a batch size of 1
+	/// \return nullopt if the network could not be loaded, the calibration failed, or writing the file failed
+	std::optional<v3::quantization_report> quantize(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath, const annotations::annotations_collection& images,
+													const v3::quantize_args& args, const std::filesystem::path& int8_filepath);
+}
+
+#endif //ALL_YOLO_QUANTIZATION_HPP
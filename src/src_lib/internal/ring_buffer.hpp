@@ -0,0 +1,154 @@
+#ifndef ALL_YOLO_RING_BUFFER_HPP
+#define ALL_YOLO_RING_BUFFER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace yolo::internal
+{
+	/// Bounded lock-free multi producer / multi consumer queue ( Dmitry Vyukov's ). Each slot has a sequence number that tells whether it is free for
+	/// the producer of a given position, or filled for its consumer, so producers and consumers only contend on their own position counter.
+	/// The capacity is rounded up to a power of 2. T must be default constructible and movable.
+	template<typename T>
+	class ring_buffer
+	{
+		public:
+			explicit ring_buffer(size_t capacity)
+				: m_mask(round_up_pow2(capacity) - 1)
+				, m_slots(std::make_unique<slot[]>(m_mask + 1))
+			{
+				for(size_t i=0; i<=m_mask; i++)
+				{
+					m_slots[i].sequence.store(i, std::memory_order_relaxed);
+				}
+			}
+
+			ring_buffer(const ring_buffer&) = delete;
+			ring_buffer& operator=(const ring_buffer&) = delete;
+
+			/// \return false if the buffer is full, in which case 'item' is left as it is
+			bool try_push(T& item)
+			{
+				size_t position = m_push_position.load(std::memory_order_relaxed);
+				while(true)
+				{
+					slot& s = m_slots[position & m_mask];
+					const size_t sequence = s.sequence.load(std::memory_order_acquire);
+					const auto diff = (intptr_t)sequence - (intptr_t)position;
+					if(diff == 0)
+					{
+						if(m_push_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						{
+							s.value = std::move(item);
+							s.sequence.store(position + 1, std::memory_order_release);
+							return true;
+						}
+					}
+					else if(diff < 0)
+					{
+						return false; // the consumer of the previous round did not take this slot yet
+					}
+					else
+					{
+						position = m_push_position.load(std::memory_order_relaxed);
+					}
+				}
+			}
+
+			/// \return false if the buffer is empty
+			bool try_pop(T& target)
+			{
+				size_t position = m_pop_position.load(std::memory_order_relaxed);
+				while(true)
+				{
+					slot& s = m_slots[position & m_mask];
+					const size_t sequence = s.sequence.load(std::memory_order_acquire);
+					const auto diff = (intptr_t)sequence - (intptr_t)(position + 1);
+					if(diff == 0)
+					{
+						if(m_pop_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						{
+							target = std::move(s.value);
+							s.value = T();
+							s.sequence.store(position + m_mask + 1, std::memory_order_release);
+							return true;
+						}
+					}
+					else if(diff < 0)
+					{
+						return false;
+					}
+					else
+					{
+						position = m_pop_position.load(std::memory_order_relaxed);
+					}
+				}
+			}
+
+			[[nodiscard]] size_t capacity() const { return m_mask + 1; }
+
+		private:
+			static size_t round_up_pow2(size_t v)
+			{
+				size_t p = 1;
+				while(p < v)
+				{
+					p <<= 1;
+				}
+				return p;
+			}
+
+			struct slot
+			{
+				std::atomic<size_t> sequence;
+				T 					value;
+			};
+
+			// the counters are on their own cache lines, so producers and consumers do not invalidate each others
+			static constexpr size_t s_cache_line = 64;
+
+			const size_t 					m_mask;
+			std::unique_ptr<slot[]> 		m_slots;
+			alignas(s_cache_line) std::atomic<size_t> m_push_position = 0;
+			alignas(s_cache_line) std::atomic<size_t> m_pop_position = 0;
+	};
+
+	/// backs off while polling a 'ring_buffer': spins briefly, then yields, then sleeps, so an idle stage costs little CPU but a busy one reacts fast
+	class idle_backoff
+	{
+		public:
+			void wait()
+			{
+				if(m_count < 64)
+				{
+#if defined(__x86_64__) || defined(__i386__)
+					_mm_pause();
+#endif
+				}
+				else if(m_count < 128)
+				{
+					std::this_thread::yield();
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds(200));
+				}
+				m_count++;
+			}
+
+			void reset() { m_count = 0; }
+
+		private:
+			uint32_t m_count = 0;
+	};
+}
+
+#endif //ALL_YOLO_RING_BUFFER_HPP
@@ -0,0 +1,156 @@
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "tiling.hpp"
+
+namespace yolo::internal
+{
+	/// start positions of tiles of 'size' along an axis of 'length', overlapping by at least 'overlap' pixels
+	static std::vector<uint32_t> tile_positions(uint32_t length, uint32_t size, uint32_t overlap)
+	{
+		if(size >= length)
+		{
+			return {0};
+		}
+		const uint32_t step = std::max(1u, size - std::min(overlap, size - 1));
+		const uint32_t count = (length - size + step - 1) / step + 1;
+		std::vector<uint32_t> v(count);
+		for(uint32_t i=0; i<count; i++)
+		{
+			v[i] = (uint32_t)(((uint64_t)(length - size) * i) / (count - 1)); // spread evenly, so the first starts at 0 and the last ends at 'length'
+		}
+		return v;
+	}
+
+	std::vector<tile> make_tiles(uint32_t width, uint32_t height, uint32_t tile_width, uint32_t tile_height, float overlap)
+	{
+		overlap = std::clamp(overlap, 0.0f, 0.9f);
+		tile_width = std::min(std::max(tile_width, 1u), width);
+		tile_height = std::min(std::max(tile_height, 1u), height);
+		const auto xs = tile_positions(width, tile_width, (uint32_t)std::lround(overlap * (float)tile_width));
+		const auto ys = tile_positions(height, tile_height, (uint32_t)std::lround(overlap * (float)tile_height));
+
+		std::vector<tile> v;
+		v.reserve(xs.size() * ys.size());
+		for(uint32_t y : ys)
+		{
+			for(uint32_t x : xs)
+			{
+				v.push_back({.x = x, .y = y, .width = tile_width, .height = tile_height});
+			}
+		}
+		return v;
+	}
+
+	image crop(const image& source, const tile& region)
+	{
+		image v;
+		v.width_px = region.width;
+		v.height_px = region.height;
+		v.format = source.format;
+		v.data.resize((size_t)region.width * region.height * 3);
+		for(uint32_t y=0; y<region.height; y++)
+		{
+			const uint8_t* p_row = &source.data[(((size_t)region.y + y) * source.width_px + region.x) * 3];
+			std::memcpy(&v.data[(size_t)y * region.width * 3], p_row, (size_t)region.width * 3);
+		}
+		return v;
+	}
+
+	void add_tile_detections(const std::vector<detection>& detections, const tile& region, uint32_t image_width, uint32_t image_height, std::vector<tile_detection>& target)
+	{
+		// boxes within this many pixels of an inner tile edge count as cut
+		static constexpr float s_edge_margin_px = 2.0f;
+
+		const float scale_x = (float)region.width / (float)image_width;
+		const float scale_y = (float)region.height / (float)image_height;
+		const bool has_left = region.x > 0;
+		const bool has_top = region.y > 0;
+		const bool has_right = region.x + region.width < image_width;
+		const bool has_bottom = region.y + region.height < image_height;
+		for(const auto& d : detections)
+		{
+			const float left_px = (d.x - d.w * 0.5f) * (float)region.width;
+			const float right_px = (d.x + d.w * 0.5f) * (float)region.width;
+			const float top_px = (d.y - d.h * 0.5f) * (float)region.height;
+			const float bottom_px = (d.y + d.h * 0.5f) * (float)region.height;
+
+			tile_detection v;
+			v.value = d;
+			v.value.x = ((float)region.x + d.x * (float)region.width) / (float)image_width;
+			v.value.y = ((float)region.y + d.y * (float)region.height) / (float)image_height;
+			v.value.w = d.w * scale_x;
+			v.value.h = d.h * scale_y;
+			v.is_cut = (has_left && left_px <= s_edge_margin_px) || (has_top && top_px <= s_edge_margin_px) ||
+					   (has_right && right_px >= (float)region.width - s_edge_margin_px) || (has_bottom && bottom_px >= (float)region.height - s_edge_margin_px);
+			target.push_back(v);
+		}
+	}
+
+	/// \return ( intersection over union, intersection over the area of the smaller box )
+	static std::pair<float, float> overlap(const detection& a, const detection& b)
+	{
+		const float overlap_w = std::min(a.x + a.w * 0.5f, b.x + b.w * 0.5f) - std::max(a.x - a.w * 0.5f, b.x - b.w * 0.5f);
+		const float overlap_h = std::min(a.y + a.h * 0.5f, b.y + b.h * 0.5f) - std::max(a.y - a.h * 0.5f, b.y - b.h * 0.5f);
+		if(overlap_w <= 0.0f || overlap_h <= 0.0f)
+		{
+			return {0.0f, 0.0f};
+		}
+		const float intersection = overlap_w * overlap_h;
+		const float area_a = a.w * a.h;
+		const float area_b = b.w * b.h;
+		return {intersection / (area_a + area_b - intersection), intersection / std::min(area_a, area_b)};
+	}
+
+	std::vector<detection> merge_tile_detections(std::vector<tile_detection>&& detections, float nms_thresh, float cut_thresh)
+	{
+		std::sort(detections.begin(), detections.end(), [](const tile_detection& a, const tile_detection& b)
+		{
+			if(a.value.class_id != b.value.class_id)
+			{
+				return a.value.class_id < b.value.class_id;
+			}
+			return a.value.confidence > b.value.confidence;
+		});
+
+		std::vector<detection> v;
+		std::vector<bool> suppressed(detections.size(), false);
+		for(size_t i=0; i<detections.size(); i++)
+		{
+			if(suppressed[i])
+			{
+				continue;
+			}
+			tile_detection a = detections[i];
+			for(size_t j=i+1; j<detections.size() && detections[j].value.class_id == a.value.class_id; j++)
+			{
+				if(suppressed[j])
+				{
+					continue;
+				}
+				const tile_detection& b = detections[j];
+				const auto [iou, ios] = overlap(a.value, b.value);
+				if((a.is_cut || b.is_cut) && (iou > nms_thresh || ios > cut_thresh))
+				{
+					// the 2 are parts of the same object: the stronger one grows to cover both, so a cut box does not hide the complete one
+					const float left = std::min(a.value.x - a.value.w * 0.5f, b.value.x - b.value.w * 0.5f);
+					const float right = std::max(a.value.x + a.value.w * 0.5f, b.value.x + b.value.w * 0.5f);
+					const float top = std::min(a.value.y - a.value.h * 0.5f, b.value.y - b.value.h * 0.5f);
+					const float bottom = std::max(a.value.y + a.value.h * 0.5f, b.value.y + b.value.h * 0.5f);
+					a.value.x = (left + right) * 0.5f;
+					a.value.y = (top + bottom) * 0.5f;
+					a.value.w = right - left;
+					a.value.h = bottom - top;
+					a.is_cut = a.is_cut && b.is_cut;
+					suppressed[j] = true;
+				}
+				else if(iou > nms_thresh)
+				{
+					suppressed[j] = true;
+				}
+			}
+			v.push_back(a.value);
+		}
+		return v;
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef ALL_YOLO_TILING_HPP
+#define ALL_YOLO_TILING_HPP
+
+#include <vector>
+#include <cstdint>
+#include <yolo.hpp>
+
+namespace yolo::internal
+{
+	/// a region of an image, in pixels
+	struct tile
+	{
+		uint32_t x = 0;
+		uint32_t y = 0;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	/// covers a 'width' x 'height' image with tiles of 'tile_width' x 'tile_height' ( smaller if the image is ), that overlap by at least 'overlap' ( 0 - 1 ) of a tile.
+	/// the tiles are spread evenly, the last ones end at the right / bottom edge
+	std::vector<tile> make_tiles(uint32_t width, uint32_t height, uint32_t tile_width, uint32_t tile_height, float overlap);
+
+	/// copies the pixels of 'region' out of 'source' ( rgb )
+	image crop(const image& source, const tile& region);
+
+	/// a detection of a tile ( or of the full image ), with its box converted to coordinates of the full image
+	struct tile_detection
+	{
+		detection 	value;
+
+		/// the box touches an edge of its tile that is not an edge of the image, so the object probably continues in the next tile
+		bool 		is_cut = false;
+	};
+
+	/// \param detections in coordinates of 'region' ( range 0 - 1 )
+	void add_tile_detections(const std::vector<detection>& detections, const tile& region, uint32_t image_width, uint32_t image_height, std::vector<tile_detection>& target);
+
+	/// per class non maximum suppression over the detections of all tiles. Boxes that overlap a stronger one by more than 'nms_thresh' ( IoU ) are dropped.
+	/// When either box was cut by a tile edge, it is merged into the stronger one instead ( which grows to cover both ), also when the smaller of the 2 lies
+	/// for more than 'cut_thresh' inside the other.
+	std::vector<detection> merge_tile_detections(std::vector<tile_detection>&& detections, float nms_thresh, float cut_thresh);
+}
+
+#endif //ALL_YOLO_TILING_HPP
@@ -0,0 +1,231 @@
+#include <map>
+#include <set>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <filesystem>
+#include "topology.hpp"
+
+#ifdef __linux__
+#define TOPOLOGY_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	static std::optional<uint32_t> read_number(const std::filesystem::path& filepath)
+	{
+		std::ifstream file(filepath);
+		uint32_t v = 0;
+		if(!(file >> v))
+		{
+			return std::nullopt;
+		}
+		return v;
+	}
+
+	/// parses the kernel's cpu list format, like "0-3,8-11"
+	static std::vector<uint32_t> read_cpu_list(const std::filesystem::path& filepath)
+	{
+		std::vector<uint32_t> v;
+		std::ifstream file(filepath);
+		std::string range;
+		while(std::getline(file, range, ','))
+		{
+			uint32_t first = 0, last = 0;
+			char dash = 0;
+			std::istringstream stream(range);
+			if(!(stream >> first))
+			{
+				continue;
+			}
+			last = (stream >> dash >> last) && dash == '-' ? last : first;
+			for(uint32_t cpu=first; cpu<=last; cpu++)
+			{
+				v.push_back(cpu);
+			}
+		}
+		return v;
+	}
+
+	/// every logical cpu counts as a core, all on node 0
+	static cpu_topology flat_topology()
+	{
+		cpu_topology v;
+		v.num_logical_cpus = std::max(1u, std::thread::hardware_concurrency());
+		for(uint32_t i=0; i<v.num_logical_cpus; i++)
+		{
+			v.cores.push_back({.package = 0, .numa_node = 0, .cpus = {i}});
+		}
+		return v;
+	}
+
+	cpu_topology detect_topology()
+	{
+#ifdef TOPOLOGY_LINUX
+		const std::filesystem::path cpu_folder = "/sys/devices/system/cpu";
+		const std::filesystem::path node_folder = "/sys/devices/system/node";
+
+		cpu_set_t allowed;
+		CPU_ZERO(&allowed);
+		const bool has_affinity = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+		std::vector<uint32_t> cpus;
+		for(uint32_t cpu : read_cpu_list(cpu_folder / "online"))
+		{
+			if(!has_affinity || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+		if(cpus.empty())
+		{
+			return flat_topology();
+		}
+
+		std::map<uint32_t, uint32_t> node_of_cpu;
+		std::error_code error;
+		for(const auto& entry : std::filesystem::directory_iterator(node_folder, error))
+		{
+			const std::string name = entry.path().filename().string();
+			if(name.rfind("node", 0) != 0 || name.size() == 4 || !std::all_of(name.begin() + 4, name.end(), ::isdigit))
+			{
+				continue;
+			}
+			const auto node = (uint32_t)std::stoul(name.substr(4));
+			for(uint32_t cpu : read_cpu_list(entry.path() / "cpulist"))
+			{
+				node_of_cpu[cpu] = node;
+			}
+		}
+
+		// logical cpus with the same package and core id are hyper-threads of 1 physical core
+		std::map<std::pair<uint32_t, uint32_t>, cpu_core> cores;
+		std::set<uint32_t> nodes;
+		for(uint32_t cpu : cpus)
+		{
+			const std::filesystem::path folder = cpu_folder / ("cpu" + std::to_string(cpu)) / "topology";
+			const uint32_t package = read_number(folder / "physical_package_id").value_or(0);
+			const uint32_t core_id = read_number(folder / "core_id").value_or(cpu);
+			cpu_core& core = cores[{package, core_id}];
+			core.package = package;
+			core.numa_node = node_of_cpu.count(cpu) != 0 ? node_of_cpu[cpu] : 0;
+			core.cpus.push_back(cpu);
+			nodes.insert(core.numa_node);
+		}
+
+		cpu_topology v;
+		v.num_logical_cpus = (uint32_t)cpus.size();
+		v.num_numa_nodes = (uint32_t)nodes.size();
+		for(auto& [id, core] : cores)
+		{
+			v.cores.push_back(std::move(core));
+		}
+		std::stable_sort(v.cores.begin(), v.cores.end(), [](const cpu_core& a, const cpu_core& b){ return a.numa_node < b.numa_node; });
+		return v;
+#else
+		return flat_topology();
+#endif
+	}
+
+	std::vector<v3::replica_placement> place_groups(const cpu_topology& topology, uint32_t num_groups, uint32_t threads_per_group)
+	{
+		std::vector<std::vector<const cpu_core*>> node_cores;
+		for(const cpu_core& core : topology.cores)
+		{
+			if(node_cores.empty() || node_cores.back().front()->numa_node != core.numa_node)
+			{
+				node_cores.emplace_back();
+			}
+			node_cores.back().push_back(&core);
+		}
+		if(node_cores.empty())
+		{
+			return {};
+		}
+
+		std::vector<size_t> next(node_cores.size(), 0); // per node, the first core that is not handed out yet
+		std::vector<v3::replica_placement> v(num_groups);
+		for(uint32_t i=0; i<num_groups; i++)
+		{
+			size_t node = i % node_cores.size();
+			for(uint32_t j=0; j<threads_per_group; j++)
+			{
+				for(size_t k=0; k<node_cores.size() && next[node] >= node_cores[node].size(); k++)
+				{
+					node = (node + 1) % node_cores.size();
+				}
+				if(next[node] >= node_cores[node].size())
+				{
+					std::fill(next.begin(), next.end(), 0); // more threads than cores
+				}
+				const cpu_core& core = *node_cores[node][next[node]++];
+				if(j == 0)
+				{
+					v[i].numa_node = core.numa_node;
+				}
+				v[i].cpus.push_back(core.cpus.front());
+			}
+		}
+		return v;
+	}
+
+	bool pin_current_thread(const std::vector<uint32_t>& cpus)
+	{
+#ifdef TOPOLOGY_LINUX
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		for(uint32_t cpu : cpus)
+		{
+			if(cpu < CPU_SETSIZE)
+			{
+				CPU_SET(cpu, &set);
+			}
+		}
+		return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+		(void)cpus;
+		return false;
+#endif
+	}
+
+	bool pin_openmp_threads(const std::vector<uint32_t>& cpus)
+	{
+		if(cpus.empty())
+		{
+			return false;
+		}
+#ifdef _OPENMP
+		omp_set_num_threads((int)cpus.size()); // only affects the parallel regions started from this thread
+		bool ok = true;
+		#pragma omp parallel reduction(&&:ok)
+		{
+			ok = pin_current_thread({cpus[(size_t)omp_get_thread_num() % cpus.size()]});
+		}
+		return ok;
+#else
+		return pin_current_thread({cpus.front()});
+#endif
+	}
+
+	void run_pinned(const std::vector<uint32_t>& cpus, const std::function<void()>& fn)
+	{
+		std::thread thread([&]()
+		{
+			pin_current_thread(cpus);
+			fn();
+		});
+		thread.join();
+	}
+}
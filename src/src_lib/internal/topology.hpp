@@ -0,0 +1,31 @@
+#ifndef ALL_YOLO_TOPOLOGY_HPP
+#define ALL_YOLO_TOPOLOGY_HPP
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <yolo.hpp>
+
+namespace yolo::internal
+{
+	/// reads the cores and NUMA nodes from /sys, limited to the cpus this process may run on ( see 'yolo::topology' )
+	cpu_topology detect_topology();
+
+	/// splits the cores over 'num_groups' groups of 'threads_per_group' threads, 1 thread per core. Groups are spread over the NUMA nodes
+	/// ( group i starts on node i % num_numa_nodes ), and only take cores from the next node when theirs has none left.
+	/// Cores are handed out again from the start when there are more threads than cores.
+	std::vector<v3::replica_placement> place_groups(const cpu_topology& topology, uint32_t num_groups, uint32_t threads_per_group);
+
+	/// restricts the calling thread to 'cpus'
+	/// \return false if that is not supported on this platform, or the OS refused
+	bool pin_current_thread(const std::vector<uint32_t>& cpus);
+
+	/// sets the amount of OpenMP threads of the calling thread to 1 per cpu, and pins each of them ( and the calling thread ) to its own cpu.
+	/// The OpenMP runtime keeps the threads of a team alive for the next parallel region of the same thread, so they stay pinned.
+	bool pin_openmp_threads(const std::vector<uint32_t>& cpus);
+
+	/// runs 'fn' on a thread that is pinned to 'cpus', and waits for it. Memory that 'fn' touches first ends up on the NUMA node of those cpus.
+	void run_pinned(const std::vector<uint32_t>& cpus, const std::function<void()>& fn);
+}
+
+#endif //ALL_YOLO_TOPOLOGY_HPP
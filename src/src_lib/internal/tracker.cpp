@@ -0,0 +1,196 @@
+#include <algorithm>
+#include "tracker.hpp"
+
+namespace yolo::internal
+{
+	// standard deviations, relative to the size of the box ( the weights DeepSORT uses )
+	static constexpr float s_position_std = 1.0f / 20.0f;
+	static constexpr float s_velocity_std = 1.0f / 160.0f;
+
+	static float iou(const detection& a, const detection& b)
+	{
+		const float overlap_w = std::min(a.x + a.w * 0.5f, b.x + b.w * 0.5f) - std::max(a.x - a.w * 0.5f, b.x - b.w * 0.5f);
+		const float overlap_h = std::min(a.y + a.h * 0.5f, b.y + b.h * 0.5f) - std::max(a.y - a.h * 0.5f, b.y - b.h * 0.5f);
+		if(overlap_w <= 0.0f || overlap_h <= 0.0f)
+		{
+			return 0.0f;
+		}
+		const float intersection = overlap_w * overlap_h;
+		return intersection / (a.w * a.h + b.w * b.h - intersection);
+	}
+
+	void tracker::kalman::predict(float dt, float position_std, float velocity_std)
+	{
+		// F = [1 dt; 0 1], P = F P F' + Q
+		x += v * dt;
+		p00 += dt * (2.0f * p01 + dt * p11) + position_std * position_std * dt;
+		p01 += dt * p11;
+		p11 += velocity_std * velocity_std * dt;
+	}
+
+	void tracker::kalman::correct(float measured, float measurement_std)
+	{
+		// H = [1 0]
+		const float s = p00 + measurement_std * measurement_std;
+		const float k0 = p00 / s;
+		const float k1 = p01 / s;
+		const float residual = measured - x;
+		x += k0 * residual;
+		v += k1 * residual;
+		p11 -= k1 * p01;
+		p01 -= k0 * p01;
+		p00 -= k0 * p00;
+	}
+
+	detection tracker::state::box() const
+	{
+		return detection{
+			.class_id 	= class_id,
+			.confidence = confidence,
+			.x 			= filters[0].x,
+			.y 			= filters[1].x,
+			.w 			= std::max(filters[2].x, 0.0f),
+			.h 			= std::max(filters[3].x, 0.0f)
+		};
+	}
+
+	tracker::tracker(const v3::tracker_args& args)
+		: m_args(args)
+	{
+	}
+
+	void tracker::move_to(uint64_t frame_index)
+	{
+		for(auto& t : m_tracks)
+		{
+			const auto dt = (float)(frame_index - t.frame_index); // counts the frames that were dropped in between
+			if(dt <= 0.0f)
+			{
+				continue;
+			}
+			const float w = std::max(t.filters[2].x, 1e-3f);
+			const float h = std::max(t.filters[3].x, 1e-3f);
+			const float sizes[4] = {w, h, w, h};
+			for(size_t i=0; i<4; i++)
+			{
+				t.filters[i].predict(dt, s_position_std * sizes[i], s_velocity_std * sizes[i]);
+			}
+			t.frame_index = frame_index;
+			t.predicted = true;
+		}
+	}
+
+	void tracker::update(uint64_t frame_index, const std::vector<detection>& detections, std::vector<v3::track>& target)
+	{
+		move_to(frame_index);
+
+		// greedy matching, best IoU first. the same as the optimal assignment in all but crowded scenes, and without its O(n^3)
+		struct pair
+		{
+			float 		iou;
+			uint32_t 	track;
+			uint32_t 	detection;
+		};
+		std::vector<pair> pairs;
+		for(uint32_t t=0; t<m_tracks.size(); t++)
+		{
+			const detection predicted = m_tracks[t].box();
+			for(uint32_t d=0; d<detections.size(); d++)
+			{
+				if(detections[d].class_id != predicted.class_id)
+				{
+					continue;
+				}
+				if(const float v = iou(predicted, detections[d]); v >= m_args.iou_thresh)
+				{
+					pairs.push_back({v, t, d});
+				}
+			}
+		}
+		std::sort(pairs.begin(), pairs.end(), [](const pair& a, const pair& b){ return a.iou > b.iou; });
+
+		std::vector<uint8_t> track_matched(m_tracks.size(), 0);
+		std::vector<uint8_t> detection_matched(detections.size(), 0);
+		for(const auto& p : pairs)
+		{
+			if(track_matched[p.track] != 0 || detection_matched[p.detection] != 0)
+			{
+				continue;
+			}
+			track_matched[p.track] = 1;
+			detection_matched[p.detection] = 1;
+
+			state& t = m_tracks[p.track];
+			const detection& d = detections[p.detection];
+			const float measured[4] = {d.x, d.y, d.w, d.h};
+			const float sizes[4] = {d.w, d.h, d.w, d.h};
+			for(size_t i=0; i<4; i++)
+			{
+				t.filters[i].correct(measured[i], s_position_std * sizes[i]);
+			}
+			t.confidence = d.confidence;
+			t.hits++;
+			t.misses = 0;
+			t.predicted = false;
+		}
+
+		for(size_t i=0; i<m_tracks.size(); i++)
+		{
+			if(track_matched[i] == 0)
+			{
+				m_tracks[i].misses++;
+			}
+		}
+		std::erase_if(m_tracks, [&](const state& t){ return t.misses > m_args.max_misses; });
+
+		for(size_t i=0; i<detections.size(); i++)
+		{
+			if(detection_matched[i] != 0)
+			{
+				continue;
+			}
+			const detection& d = detections[i];
+			state t;
+			t.id = m_next_id++;
+			t.class_id = d.class_id;
+			t.confidence = d.confidence;
+			t.frame_index = frame_index;
+			t.hits = 1;
+			const float values[4] = {d.x, d.y, d.w, d.h};
+			const float sizes[4] = {d.w, d.h, d.w, d.h};
+			for(size_t j=0; j<4; j++)
+			{
+				// the velocity is unknown until the 2nd detection, hence its large variance
+				kalman& k = t.filters[j];
+				k.x = values[j];
+				k.p00 = 4.0f * (s_position_std * sizes[j]) * (s_position_std * sizes[j]);
+				k.p11 = 100.0f * (s_velocity_std * sizes[j]) * (s_velocity_std * sizes[j]);
+			}
+			m_tracks.push_back(t);
+		}
+
+		report(target);
+	}
+
+	void tracker::predict(uint64_t frame_index, std::vector<v3::track>& target)
+	{
+		move_to(frame_index);
+		report(target);
+	}
+
+	void tracker::report(std::vector<v3::track>& target) const
+	{
+		target.clear();
+		for(const auto& t : m_tracks)
+		{
+			if(t.hits >= m_args.min_hits)
+			{
+				target.push_back(v3::track{
+					.id 		= t.id,
+					.box 		= t.box(),
+					.predicted 	= t.predicted
+				});
+			}
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef ALL_YOLO_TRACKER_HPP
+#define ALL_YOLO_TRACKER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <yolo.hpp>
+
+namespace yolo::internal
+{
+	/// Multi object tracker in the style of SORT ( Bewley et al. ). Each track has a constant velocity Kalman filter over its box ( center x, center y,
+	/// width, height ). The state of the filter only couples each coordinate to its own velocity, so it runs as 4 independent 2 state filters.
+	/// The noise scales with the size of the box ( as in DeepSORT ), so small and large objects are followed equally well.
+	class tracker
+	{
+		public:
+			explicit tracker(const v3::tracker_args& args);
+
+			/// moves the tracks to 'frame_index', and corrects them with 'detections' ( of a frame that ran the forward pass )
+			/// \param target the reported tracks
+			void update(uint64_t frame_index, const std::vector<detection>& detections, std::vector<v3::track>& target);
+
+			/// moves the tracks to 'frame_index', for a frame without detections
+			void predict(uint64_t frame_index, std::vector<v3::track>& target);
+
+		private:
+			/// position and velocity ( per frame ) of one coordinate, with their covariance
+			struct kalman
+			{
+				float x = 0.0f;
+				float v = 0.0f;
+				float p00 = 0.0f;
+				float p01 = 0.0f;
+				float p11 = 0.0f;
+
+				void predict(float dt, float position_std, float velocity_std);
+				void correct(float measured, float measurement_std);
+			};
+
+			struct state
+			{
+				uint64_t 	id = 0;
+				uint32_t 	class_id = 0;
+				float 		confidence = 0.0f;
+				kalman 		filters[4]; // x, y, w, h
+				uint64_t 	frame_index = 0;
+				uint32_t 	hits = 0;
+				uint32_t 	misses = 0;
+				bool 		predicted = false;
+
+				[[nodiscard]] detection box() const;
+			};
+
+			void move_to(uint64_t frame_index);
+			void report(std::vector<v3::track>& target) const;
+
+			const v3::tracker_args 	m_args;
+			std::vector<state> 		m_tracks;
+			uint64_t 				m_next_id = 1;
+	};
+}
+
+#endif //ALL_YOLO_TRACKER_HPP
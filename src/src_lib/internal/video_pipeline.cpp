@@ -0,0 +1,437 @@
+#include <algorithm>
+#include "video_pipeline.hpp"
+#include "preprocess.hpp"
+#include "topology.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	void draw_detections(image& target, const std::vector<detection>& detections)
+	{
+		static constexpr int32_t s_thickness_px = 2;
+		const auto width = (int32_t)target.width_px;
+		const auto height = (int32_t)target.height_px;
+		auto fill = [&](int32_t x0, int32_t y0, int32_t x1, int32_t y1, const uint8_t* p_color)
+		{
+			x0 = std::clamp(x0, 0, width);
+			x1 = std::clamp(x1, 0, width);
+			y0 = std::clamp(y0, 0, height);
+			y1 = std::clamp(y1, 0, height);
+			for(int32_t y=y0; y<y1; y++)
+			{
+				uint8_t* p_row = &target.data[((size_t)y * width) * 3];
+				for(int32_t x=x0; x<x1; x++)
+				{
+					std::copy(p_color, p_color + 3, &p_row[x * 3]);
+				}
+			}
+		};
+		for(const auto& d : detections)
+		{
+			// a fixed color per class, spread over the hues
+			const uint32_t hash = d.class_id * 2654435761u;
+			const uint8_t color[3] = {(uint8_t)(64 + (hash >> 24) % 192), (uint8_t)(64 + (hash >> 16) % 192), (uint8_t)(64 + (hash >> 8) % 192)};
+			const auto left = (int32_t)((d.x - d.w * 0.5f) * (float)width);
+			const auto right = (int32_t)((d.x + d.w * 0.5f) * (float)width);
+			const auto top = (int32_t)((d.y - d.h * 0.5f) * (float)height);
+			const auto bottom = (int32_t)((d.y + d.h * 0.5f) * (float)height);
+			fill(left, top, right, top + s_thickness_px, color);
+			fill(left, bottom - s_thickness_px, right, bottom, color);
+			fill(left, top, left + s_thickness_px, bottom, color);
+			fill(right - s_thickness_px, top, right, bottom, color);
+		}
+	}
+}
+
+namespace yolo::v3
+{
+	video_pipeline::video_pipeline(std::unique_ptr<video_pipeline_internal>&& v) : m_internal(std::move(v)) {}
+	video_pipeline::~video_pipeline() = default;
+
+	void video_pipeline::wait()
+	{
+		m_internal->wait();
+	}
+
+	bool video_pipeline::is_done() const
+	{
+		return m_internal->is_done();
+	}
+
+	void video_pipeline::stop()
+	{
+		m_internal->stop();
+	}
+
+	video_metrics video_pipeline::metrics() const
+	{
+		return m_internal->metrics();
+	}
+
+	video_pipeline_internal::video_pipeline_internal(std::unique_ptr<yolo::internal::darknet_network>&& p_network, std::unique_ptr<yolo::internal::video_source>&& p_source, video_pipeline::sink&& sink,
+													 const video_args& args, uint32_t num_infer_threads, std::vector<uint32_t>&& infer_cpus)
+		: m_args(args)
+		, m_p_network(std::move(p_network))
+		, m_p_source(std::move(p_source))
+		, m_sink(std::move(sink))
+		, m_num_infer_threads(num_infer_threads)
+		, m_infer_cpus(std::move(infer_cpus))
+		, m_free_frames((size_t)(num_stages + 1) * std::max(args.buffer_size, 1u))
+	{
+		for(auto& p_buffer : m_buffers)
+		{
+			p_buffer = std::make_unique<buffer>(std::max(m_args.buffer_size, 1u));
+		}
+
+		const uint32_t net_width = m_p_network->width();
+		const uint32_t net_height = m_p_network->height();
+		const size_t input_size = (size_t)net_width * net_height * m_p_network->channels();
+
+		m_threads[decode_stage] = std::make_unique<std::thread>([this](){ decode_main(); });
+
+		m_threads[preprocess_stage] = std::make_unique<std::thread>([=, this]()
+		{
+			std::unique_ptr<yolo::internal::motion_gate> p_motion_gate;
+			if(m_args.motion_gate.enabled)
+			{
+				p_motion_gate = std::make_unique<yolo::internal::motion_gate>(m_args.motion_gate);
+			}
+			stage_main(preprocess_stage, [&](frame& item)
+			{
+				item.gated = false;
+				if(m_args.infer_interval > 1 && item.index % m_args.infer_interval != 0)
+				{
+					item.gated = true;
+					return true;
+				}
+				if(p_motion_gate != nullptr)
+				{
+					if(m_key_frame_dropped.exchange(false, std::memory_order_relaxed))
+					{
+						p_motion_gate->reset();
+					}
+					if(!p_motion_gate->changed(item.source))
+					{
+						item.gated = true;
+						m_frames_gated.fetch_add(1, std::memory_order_relaxed);
+						return true;
+					}
+				}
+				item.input.resize(input_size);
+				yolo::internal::to_network_input(item.source.data.data(), item.source.width_px, item.source.height_px, item.input.data(), net_width, net_height, m_args.letter_box);
+				return true;
+			});
+		});
+
+		m_threads[infer_stage] = std::make_unique<std::thread>([=, this]()
+		{
+			if(!m_infer_cpus.empty())
+			{
+				yolo::internal::pin_openmp_threads(m_infer_cpus);
+			}
+			else
+			{
+#ifdef _OPENMP
+				omp_set_num_threads((int)m_num_infer_threads); // only affects the parallel regions started from this thread
+#endif
+			}
+			const yolo::internal::box_args box_args = {
+					.thresh 		= m_args.thresh,
+					.nms_thresh 	= m_args.nms_thresh,
+					.letter_box 	= m_args.letter_box
+			};
+			stage_main(infer_stage, [&](frame& item)
+			{
+				if(item.gated)
+				{
+					return true;
+				}
+				std::copy(item.input.begin(), item.input.end(), m_p_network->input());
+				m_p_network->predict();
+				m_p_network->decode({item.source.width_px, item.source.height_px}, box_args, item.candidates);
+				return true;
+			});
+		});
+
+		m_threads[postprocess_stage] = std::make_unique<std::thread>([this]()
+		{
+			std::unique_ptr<yolo::internal::tracker> p_tracker;
+			if(m_args.tracker.enabled)
+			{
+				p_tracker = std::make_unique<yolo::internal::tracker>(m_args.tracker);
+			}
+			stage_main(postprocess_stage, [&](frame& item)
+			{
+				if(item.gated)
+				{
+					item.detections = m_last_detections;
+				}
+				else
+				{
+					yolo::internal::nms(item.candidates, m_args.nms_thresh);
+					item.detections.clear();
+					yolo::internal::to_detections(item.candidates, item.detections);
+					m_last_detections = item.detections;
+				}
+
+				// in frame order, this stage has a single thread
+				item.tracks.clear();
+				if(p_tracker != nullptr)
+				{
+					if(item.gated)
+					{
+						p_tracker->predict(item.index, item.tracks);
+					}
+					else
+					{
+						p_tracker->update(item.index, item.detections, item.tracks);
+					}
+				}
+				return true;
+			});
+		});
+
+		m_threads[sink_stage] = std::make_unique<std::thread>([this]()
+		{
+			stage_main(sink_stage, [&](frame& item)
+			{
+				const auto latency = std::chrono::steady_clock::now() - item.read_at;
+				const float latency_ms = (float)std::chrono::duration_cast<std::chrono::microseconds>(latency).count() / 1000.0f;
+				{
+					std::lock_guard lock(m_mutex);
+					m_metrics.frames_done++;
+					m_total_latency_ms += latency_ms;
+					m_metrics.max_latency_ms = std::max(m_metrics.max_latency_ms, latency_ms);
+				}
+				m_sink(video_frame{
+					.index 		= item.index,
+					.source 	= std::move(item.source),
+					.detections = item.detections,
+					.latency_ms = latency_ms,
+					.inferred 	= !item.gated,
+					.tracks 	= item.tracks,
+					.tracked 	= m_args.tracker.enabled
+				});
+				return true;
+			});
+		});
+	}
+
+	video_pipeline_internal::~video_pipeline_internal()
+	{
+		stop();
+	}
+
+	std::unique_ptr<video_pipeline_internal> video_pipeline_internal::start(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath, const std::string& source, video_pipeline::sink&& sink, const video_args& args)
+	{
+		auto p_source = yolo::internal::open_video_source(source);
+		if(p_source == nullptr)
+		{
+			return nullptr;
+		}
+
+		const auto num_cores = (uint32_t)topology().cores.size();
+		const uint32_t num_infer_threads = args.threads != 0 ? args.threads : (num_cores > 2 ? num_cores - 2 : 1u);
+		std::vector<uint32_t> infer_cpus;
+		if(args.pin_threads)
+		{
+			if(auto placement = yolo::internal::place_groups(topology(), 1, num_infer_threads); !placement.empty())
+			{
+				infer_cpus = std::move(placement.front().cpus);
+			}
+		}
+
+		// loaded on the cores that run it, so the activations end up on their NUMA node
+		std::unique_ptr<yolo::internal::darknet_network> p_network;
+		auto load = [&](){ p_network = yolo::internal::darknet_network::load(model_cfg, weights_filepath); };
+		if(infer_cpus.empty())
+		{
+			load();
+		}
+		else
+		{
+			yolo::internal::run_pinned(infer_cpus, load);
+		}
+		if(p_network == nullptr)
+		{
+			return nullptr;
+		}
+		return std::unique_ptr<video_pipeline_internal>(new video_pipeline_internal(std::move(p_network), std::move(p_source), std::move(sink), args, num_infer_threads, std::move(infer_cpus)));
+	}
+
+	void video_pipeline_internal::decode_main()
+	{
+		const float fps = m_args.source_fps > 0.0f ? m_args.source_fps : m_p_source->fps();
+		const auto frame_time = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(fps > 0.0f ? 1.0 / fps : 0.0));
+		auto next_read_at = std::chrono::steady_clock::now();
+		for(uint64_t index=0; !m_stop.load(std::memory_order_relaxed); index++)
+		{
+			frame_ptr item;
+			if(!m_free_frames.try_pop(item))
+			{
+				item = std::make_unique<frame>();
+			}
+			const auto start = std::chrono::steady_clock::now();
+			if(!m_p_source->read(item->source))
+			{
+				break;
+			}
+			item->index = index;
+			item->read_at = std::chrono::steady_clock::now();
+			add_stage_time(decode_stage, start);
+			{
+				std::lock_guard lock(m_mutex);
+				m_metrics.frames_read++;
+			}
+			push(decode_stage, std::move(item));
+
+			if(fps > 0.0f)
+			{
+				next_read_at = std::max(next_read_at + frame_time, std::chrono::steady_clock::now() - frame_time); // does not catch up on more than a frame after a stall
+				std::this_thread::sleep_until(next_read_at);
+			}
+		}
+		m_finished[decode_stage].store(true, std::memory_order_release);
+	}
+
+	template<typename Fn>
+	void video_pipeline_internal::stage_main(stage index, Fn&& process)
+	{
+		buffer& input = *m_buffers[index - 1];
+		yolo::internal::idle_backoff backoff;
+		while(!m_stop.load(std::memory_order_relaxed))
+		{
+			frame_ptr item;
+			if(!input.try_pop(item))
+			{
+				// the stage before pushes its last frame before it sets 'finished', so the buffer is checked once more after that
+				if(m_finished[index - 1].load(std::memory_order_acquire) && !input.try_pop(item))
+				{
+					break;
+				}
+				if(item == nullptr)
+				{
+					backoff.wait();
+					continue;
+				}
+			}
+			backoff.reset();
+
+			const auto start = std::chrono::steady_clock::now();
+			const bool keep = process(*item);
+			add_stage_time(index, start);
+			if(keep && index + 1 < num_stages)
+			{
+				push(index, std::move(item));
+			}
+			else
+			{
+				recycle(std::move(item));
+			}
+		}
+		m_finished[index].store(true, std::memory_order_release);
+		if(index == sink_stage)
+		{
+			std::lock_guard lock(m_done_mutex);
+			m_done_condition.notify_all();
+		}
+	}
+
+	void video_pipeline_internal::push(stage from, frame_ptr&& item)
+	{
+		buffer& target = *m_buffers[from];
+		yolo::internal::idle_backoff backoff;
+		while(!target.try_push(item))
+		{
+			switch(m_args.policy)
+			{
+				case overload_policy::drop_newest:
+					drop(from, std::move(item));
+					return;
+				case overload_policy::drop_oldest:
+					if(frame_ptr oldest; target.try_pop(oldest))
+					{
+						drop(from, std::move(oldest));
+					}
+					break;
+				case overload_policy::block:
+					if(m_stop.load(std::memory_order_relaxed))
+					{
+						return;
+					}
+					backoff.wait();
+					break;
+			}
+		}
+	}
+
+	void video_pipeline_internal::drop(stage from, frame_ptr&& item)
+	{
+		// a frame that went trough the motion gate without being gated is a key frame, that the gated frames after it reuse the detections of
+		if(from >= preprocess_stage && from < postprocess_stage && !item->gated)
+		{
+			m_key_frame_dropped.store(true, std::memory_order_relaxed);
+		}
+		m_frames_dropped.fetch_add(1, std::memory_order_relaxed);
+		recycle(std::move(item));
+	}
+
+	void video_pipeline_internal::recycle(frame_ptr&& item)
+	{
+		m_free_frames.try_push(item); // freed if there are enough spare frames already
+	}
+
+	void video_pipeline_internal::add_stage_time(stage index, std::chrono::steady_clock::time_point start)
+	{
+		const double ms = (double)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+		std::lock_guard lock(m_mutex);
+		m_total_stage_ms[index] += ms;
+		m_stage_frames[index]++;
+	}
+
+	void video_pipeline_internal::wait()
+	{
+		std::unique_lock lock(m_done_mutex);
+		m_done_condition.wait(lock, [&](){ return m_finished[sink_stage].load(std::memory_order_acquire); });
+	}
+
+	bool video_pipeline_internal::is_done() const
+	{
+		return m_finished[sink_stage].load(std::memory_order_acquire);
+	}
+
+	void video_pipeline_internal::stop()
+	{
+		m_stop.store(true, std::memory_order_relaxed);
+		m_p_source->interrupt(); // the decode stage can be waiting on a stream that stalled
+		for(auto& p_thread : m_threads)
+		{
+			if(p_thread != nullptr && p_thread->joinable())
+			{
+				p_thread->join();
+			}
+		}
+	}
+
+	video_metrics video_pipeline_internal::metrics() const
+	{
+		std::lock_guard lock(m_mutex);
+		video_metrics v = m_metrics;
+		v.frames_dropped = m_frames_dropped.load(std::memory_order_relaxed);
+		v.frames_gated = m_frames_gated.load(std::memory_order_relaxed);
+		v.average_latency_ms = v.frames_done != 0 ? (float)(m_total_latency_ms / (double)v.frames_done) : 0.0f;
+		for(size_t i=0; i<num_stages; i++)
+		{
+			v.stage_ms[i] = m_stage_frames[i] != 0 ? (float)(m_total_stage_ms[i] / (double)m_stage_frames[i]) : 0.0f;
+		}
+		return v;
+	}
+}
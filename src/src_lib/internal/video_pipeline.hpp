@@ -0,0 +1,120 @@
+#ifndef ALL_YOLO_VIDEO_PIPELINE_HPP
+#define ALL_YOLO_VIDEO_PIPELINE_HPP
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <yolo.hpp>
+#include "cfg.hpp"
+#include "darknet_network.hpp"
+#include "motion_gate.hpp"
+#include "ring_buffer.hpp"
+#include "tracker.hpp"
+#include "video_source.hpp"
+
+namespace yolo::internal
+{
+	/// draws the boxes of 'detections' into 'target' ( rgb ), with a color per class
+	void draw_detections(image& target, const std::vector<detection>& detections);
+}
+
+namespace yolo::v3
+{
+	class video_pipeline_internal
+	{
+		public:
+			~video_pipeline_internal();
+
+			/// \param model_cfg testing cfg, with a batch size of 1
+			/// \return nullptr if loading the network or opening the source failed
+			static std::unique_ptr<video_pipeline_internal> start(const cfg::cfg& model_cfg, const std::filesystem::path& weights_filepath, const std::string& source, video_pipeline::sink&& sink, const video_args& args);
+
+			void wait();
+			[[nodiscard]] bool is_done() const;
+			void stop();
+			[[nodiscard]] video_metrics metrics() const;
+
+		private:
+			/// a frame on its way trough the stages
+			struct frame
+			{
+				uint64_t 								index = 0;
+				image 									source;
+				std::chrono::steady_clock::time_point 	read_at;
+				std::vector<float> 						input; 		// network input, written by the preprocess stage
+				yolo::internal::box_candidates 			candidates; // decoded by the infer stage
+				std::vector<detection> 					detections;
+				bool 									gated = false; 	// skips the forward pass, see 'motion_gate' and 'video_args::infer_interval'
+				std::vector<track> 						tracks;
+			};
+			using frame_ptr = std::unique_ptr<frame>;
+			using buffer = yolo::internal::ring_buffer<frame_ptr>;
+
+			enum stage
+			{
+				decode_stage,
+				preprocess_stage,
+				infer_stage,
+				postprocess_stage,
+				sink_stage,
+				num_stages
+			};
+
+			/// \param infer_cpus to pin the threads of the forward pass to, or empty to leave them to the OS
+			video_pipeline_internal(std::unique_ptr<yolo::internal::darknet_network>&& p_network, std::unique_ptr<yolo::internal::video_source>&& p_source, video_pipeline::sink&& sink,
+									const video_args& args, uint32_t num_infer_threads, std::vector<uint32_t>&& infer_cpus);
+
+			void decode_main();
+
+			/// pops the frames from the buffer before 'index', runs 'process' on them, and pushes them to the buffer after it ( if any )
+			/// \param process returns false to drop the frame
+			template<typename Fn>
+			void stage_main(stage index, Fn&& process);
+
+			/// pushes 'item' into the buffer after 'from', applying the overload policy when it is full
+			void push(stage from, frame_ptr&& item);
+
+			/// drops 'item', that was pushed by 'from', because of the overload policy
+			void drop(stage from, frame_ptr&& item);
+
+			void add_stage_time(stage index, std::chrono::steady_clock::time_point start);
+
+			/// keeps the buffers of a frame that is done ( or dropped ) for a next one
+			void recycle(frame_ptr&& item);
+
+			const video_args 										m_args;
+			std::unique_ptr<yolo::internal::darknet_network> 		m_p_network;
+			std::unique_ptr<yolo::internal::video_source> 			m_p_source;
+			video_pipeline::sink 									m_sink;
+			const uint32_t 											m_num_infer_threads;
+			const std::vector<uint32_t> 							m_infer_cpus;
+
+			/// between stage i and i + 1
+			std::array<std::unique_ptr<buffer>, num_stages - 1> 	m_buffers;
+			buffer 													m_free_frames;
+
+			/// set by a stage once it will not push any more frames
+			std::array<std::atomic<bool>, num_stages> 				m_finished = {};
+			std::atomic<bool> 										m_stop = false;
+			std::mutex 												m_done_mutex;
+			std::condition_variable 								m_done_condition;
+			std::array<std::unique_ptr<std::thread>, num_stages> 	m_threads;
+
+			/// set when a key frame of the motion gate is dropped, so the one after it becomes a key frame instead
+			std::atomic<bool> 										m_key_frame_dropped = false;
+			std::vector<detection> 									m_last_detections; 	// of the postprocess stage, for the gated frames
+
+			std::atomic<uint64_t> 									m_frames_dropped = 0;
+			std::atomic<uint64_t> 									m_frames_gated = 0;
+			mutable std::mutex 										m_mutex;
+			video_metrics 											m_metrics;
+			double 													m_total_latency_ms = 0.0;
+			std::array<double, num_stages> 							m_total_stage_ms = {};
+			std::array<uint64_t, num_stages> 						m_stage_frames = {};
+	};
+}
+
+#endif //ALL_YOLO_VIDEO_PIPELINE_HPP
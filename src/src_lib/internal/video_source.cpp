@@ -0,0 +1,159 @@
+#include <darknet.h>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include "video_source.hpp"
+#include "mjpeg_source.hpp"
+
+#ifdef OPENCV
+#include "image_opencv.h"
+#endif
+
+namespace yolo
+{
+	void log(const std::string_view& message);
+}
+
+namespace yolo::internal
+{
+	/// the images of a folder, one per frame
+	class image_folder_source : public video_source
+	{
+		public:
+			explicit image_folder_source(std::vector<std::filesystem::path>&& filepaths)
+				: m_filepaths(std::move(filepaths))
+			{
+			}
+
+			bool read(image& target) override
+			{
+				while(m_next < m_filepaths.size())
+				{
+					if(image::load(m_filepaths[m_next++], target))
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+
+		private:
+			std::vector<std::filesystem::path> 	m_filepaths;
+			size_t 								m_next = 0;
+	};
+
+#ifdef OPENCV
+	/// camera or video file, trough darknet's OpenCV capture
+	class capture_source : public video_source
+	{
+		public:
+			capture_source(cap_cv* p_capture, bool is_live)
+				: m_p_capture(p_capture)
+				, m_fps(is_live ? 0.0f : (float)get_stream_fps_cpp_cv(p_capture))
+			{
+			}
+
+			~capture_source() override
+			{
+				release_capture(m_p_capture);
+			}
+
+			bool read(image& target) override
+			{
+				// planar float rgb ( range 0 - 1 ), to interleaved bytes
+				::image frame = get_image_from_stream_cpp(m_p_capture);
+				if(frame.data == nullptr || frame.c != 3)
+				{
+					free_image(frame);
+					return false;
+				}
+				const size_t plane = (size_t)frame.w * frame.h;
+				target.width_px = (uint32_t)frame.w;
+				target.height_px = (uint32_t)frame.h;
+				target.format = image_format::rgb;
+				target.data.resize(plane * 3);
+				for(size_t c=0; c<3; c++)
+				{
+					const float* p_plane = &frame.data[c * plane];
+					for(size_t i=0; i<plane; i++)
+					{
+						target.data[i*3 + c] = (uint8_t)std::clamp(p_plane[i] * 255.0f + 0.5f, 0.0f, 255.0f);
+					}
+				}
+				free_image(frame);
+				return true;
+			}
+
+			[[nodiscard]] float fps() const override
+			{
+				return m_fps;
+			}
+
+		private:
+			cap_cv* 	m_p_capture;
+			const float m_fps;
+	};
+#endif
+
+	std::unique_ptr<video_source> open_video_source(const std::string& source)
+	{
+		if(std::filesystem::is_directory(source))
+		{
+			std::vector<std::filesystem::path> filepaths;
+			for(const auto& entry : std::filesystem::directory_iterator(source))
+			{
+				const std::string extension = entry.path().extension().string();
+				if(entry.is_regular_file() && (extension == ".jpg" || extension == ".jpeg" || extension == ".png"))
+				{
+					filepaths.push_back(entry.path());
+				}
+			}
+			if(filepaths.empty())
+			{
+				log("No .jpg / .png images in '" + source + "'");
+				return nullptr;
+			}
+			std::sort(filepaths.begin(), filepaths.end());
+			return std::make_unique<image_folder_source>(std::move(filepaths));
+		}
+
+		if(source.starts_with("http://") || source.starts_with("https://"))
+		{
+			if(auto p_source = open_mjpeg_source(source))
+			{
+				return p_source;
+			}
+			log("Opening '" + source + "' as an other stream instead");
+		}
+
+#ifdef OPENCV
+		cap_cv* p_capture = nullptr;
+		const bool is_camera = source.starts_with("/dev/video");
+		if(is_camera)
+		{
+			char* p_end = nullptr;
+			const long index = strtol(source.c_str() + strlen("/dev/video"), &p_end, 10);
+			if(*p_end != '\0')
+			{
+				log("Could not obtain camera index from '" + source + "'");
+				return nullptr;
+			}
+			p_capture = get_capture_webcam((int)index);
+		}
+		else
+		{
+			p_capture = get_capture_video_stream(source.c_str());
+		}
+		if(p_capture == nullptr)
+		{
+			log("Failed to open '" + source + "'");
+			return nullptr;
+		}
+		return std::make_unique<capture_source>(p_capture, is_camera || source.find("://") != std::string::npos);
+#else
+		log("Can not open '" + source + "': cameras and video files need darknet to be built with OpenCV ( image folders work without )");
+		return nullptr;
+#endif
+	}
+}
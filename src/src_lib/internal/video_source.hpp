@@ -0,0 +1,35 @@
+#ifndef ALL_YOLO_VIDEO_SOURCE_HPP
+#define ALL_YOLO_VIDEO_SOURCE_HPP
+
+#include <memory>
+#include <string>
+#include <yolo.hpp>
+
+namespace yolo::internal
+{
+	/// where the decode stage of the 'video_pipeline' reads its frames from
+	class video_source
+	{
+		public:
+			virtual ~video_source() = default;
+
+			/// blocks until the next frame is decoded into 'target' ( rgb )
+			/// \return false once the source has ended, or failed
+			virtual bool 			read(image& target) = 0;
+
+			/// makes a 'read' that is blocked now, and the ones after it, return false. called from an other thread, when the pipeline stops.
+			/// sources whose 'read' returns quickly on its own do not need it
+			virtual void 			interrupt() {}
+
+			/// frame rate to replay a recording at. 0 for sources that deliver frames at their own pace ( cameras ), or have no rate ( image folders )
+			[[nodiscard]] virtual float fps() const { return 0.0f; }
+	};
+
+	/// \param source "/dev/videoN" for a camera, a folder of .jpg / .png images ( read in file name order ), an http(s) url of an MJPEG stream ( see
+	///               'open_mjpeg_source', urls that do not serve MJPEG are opened like any other stream ), or a video file / other stream url. cameras and video files are read trough darknet's OpenCV capture,
+	///               so they need darknet to be built with OpenCV
+	/// \return nullptr if the source could not be opened
+	std::unique_ptr<video_source> open_video_source(const std::string& source);
+}
+
+#endif //ALL_YOLO_VIDEO_SOURCE_HPP
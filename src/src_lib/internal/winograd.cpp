@@ -0,0 +1,176 @@
+#include <algorithm>
+#include "winograd.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace yolo::internal
+{
+	// F(2x2, 3x3): Y = At * ( ( G * g * Gt ) . ( Bt * d * B ) ) * A, with 4x4 input tiles that overlap by 2
+
+	winograd_filters winograd_transform_filters(const float* p_weights, uint32_t filters, uint32_t channels)
+	{
+		winograd_filters v;
+		v.filters = filters;
+		v.channels = channels;
+		const size_t matrix_size = (size_t)filters * channels;
+		v.u.resize(16 * matrix_size);
+		for(size_t f=0; f<filters; f++)
+		{
+			for(size_t c=0; c<channels; c++)
+			{
+				const float* g = &p_weights[(f * channels + c) * 9];
+
+				// G * g ( 4x3 )
+				float gg[4][3];
+				for(int x=0; x<3; x++)
+				{
+					gg[0][x] = g[0*3 + x];
+					gg[1][x] = 0.5f * (g[0*3 + x] + g[1*3 + x] + g[2*3 + x]);
+					gg[2][x] = 0.5f * (g[0*3 + x] - g[1*3 + x] + g[2*3 + x]);
+					gg[3][x] = g[2*3 + x];
+				}
+				// ( G * g ) * Gt ( 4x4 )
+				for(int y=0; y<4; y++)
+				{
+					const float u[4] = {
+							gg[y][0],
+							0.5f * (gg[y][0] + gg[y][1] + gg[y][2]),
+							0.5f * (gg[y][0] - gg[y][1] + gg[y][2]),
+							gg[y][2]
+					};
+					for(int x=0; x<4; x++)
+					{
+						v.u[(size_t)(y*4 + x) * matrix_size + f * channels + c] = u[x];
+					}
+				}
+			}
+		}
+		return v;
+	}
+
+	void winograd_convolution(const winograd_filters& filters, const float* p_input, uint32_t width, uint32_t height, uint32_t pad, float* p_output, uint32_t output_width, uint32_t output_height, const gemm_epilogue* p_epilogue)
+	{
+		const size_t tiles_x = (output_width + 1) / 2;
+		const size_t tiles_y = (output_height + 1) / 2;
+		const size_t num_tiles = tiles_x * tiles_y;
+		const int64_t channels = filters.channels;
+		const int64_t num_filters = filters.filters;
+
+		// v: 16 matrices of channels * tiles, m: 16 matrices of filters * tiles
+		thread_local std::vector<float> t_v;
+		thread_local std::vector<float> t_m;
+		t_v.resize(16 * (size_t)channels * num_tiles);
+		t_m.resize(16 * (size_t)num_filters * num_tiles);
+		float* p_v = t_v.data();
+		float* p_m = t_m.data();
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int64_t c=0; c<channels; c++)
+		{
+			const float* p_channel = &p_input[(size_t)c * width * height];
+			for(size_t ty=0; ty<tiles_y; ty++)
+			{
+				for(size_t tx=0; tx<tiles_x; tx++)
+				{
+					// input tile, zero outside the image
+					float d[4][4];
+					const int64_t y0 = (int64_t)ty * 2 - pad;
+					const int64_t x0 = (int64_t)tx * 2 - pad;
+					for(int y=0; y<4; y++)
+					{
+						for(int x=0; x<4; x++)
+						{
+							const int64_t sy = y0 + y;
+							const int64_t sx = x0 + x;
+							d[y][x] = (sy >= 0 && sy < height && sx >= 0 && sx < width) ? p_channel[sy * width + sx] : 0.0f;
+						}
+					}
+					// Bt * d
+					float bd[4][4];
+					for(int x=0; x<4; x++)
+					{
+						bd[0][x] = d[0][x] - d[2][x];
+						bd[1][x] = d[1][x] + d[2][x];
+						bd[2][x] = d[2][x] - d[1][x];
+						bd[3][x] = d[1][x] - d[3][x];
+					}
+					// ( Bt * d ) * B
+					const size_t tile = ty * tiles_x + tx;
+					const size_t stride = (size_t)channels * num_tiles;
+					float* p_target = &p_v[(size_t)c * num_tiles + tile];
+					for(int y=0; y<4; y++)
+					{
+						p_target[(size_t)(y*4 + 0) * stride] = bd[y][0] - bd[y][2];
+						p_target[(size_t)(y*4 + 1) * stride] = bd[y][1] + bd[y][2];
+						p_target[(size_t)(y*4 + 2) * stride] = bd[y][2] - bd[y][1];
+						p_target[(size_t)(y*4 + 3) * stride] = bd[y][1] - bd[y][3];
+					}
+				}
+			}
+		}
+
+		// element wise products summed over the channels, as matrix products
+		for(size_t xi=0; xi<16; xi++)
+		{
+			gemm((size_t)num_filters, num_tiles, (size_t)channels,
+				 &filters.u[xi * num_filters * channels], (size_t)channels,
+				 &p_v[xi * channels * num_tiles], num_tiles,
+				 &p_m[xi * num_filters * num_tiles], num_tiles, false);
+		}
+
+#ifdef _OPENMP
+		#pragma omp parallel for schedule(static)
+#endif
+		for(int64_t f=0; f<num_filters; f++)
+		{
+			float* p_filter_output = &p_output[(size_t)f * output_width * output_height];
+			const size_t stride = (size_t)num_filters * num_tiles;
+			for(size_t ty=0; ty<tiles_y; ty++)
+			{
+				for(size_t tx=0; tx<tiles_x; tx++)
+				{
+					const size_t tile = ty * tiles_x + tx;
+					const float* p_source = &p_m[(size_t)f * num_tiles + tile];
+					float m[4][4];
+					for(int i=0; i<16; i++)
+					{
+						m[i / 4][i % 4] = p_source[(size_t)i * stride];
+					}
+					// At * m ( 2x4 )
+					float am[2][4];
+					for(int x=0; x<4; x++)
+					{
+						am[0][x] = m[0][x] + m[1][x] + m[2][x];
+						am[1][x] = m[1][x] - m[2][x] - m[3][x];
+					}
+					// ( At * m ) * A ( 2x2 )
+					for(int y=0; y<2; y++)
+					{
+						const size_t oy = ty * 2 + y;
+						if(oy >= output_height)
+						{
+							continue;
+						}
+						const float out[2] = {am[y][0] + am[y][1] + am[y][2], am[y][1] - am[y][2] - am[y][3]};
+						for(int x=0; x<2; x++)
+						{
+							const size_t ox = tx * 2 + x;
+							if(ox < output_width)
+							{
+								p_filter_output[oy * output_width + ox] = out[x];
+							}
+						}
+					}
+				}
+			}
+			if(p_epilogue != nullptr)
+			{
+				p_epilogue->offset((size_t)f, 0).apply(p_filter_output, (size_t)output_width * output_height);
+			}
+		}
+	}
+}
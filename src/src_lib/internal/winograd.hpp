@@ -0,0 +1,29 @@
+#ifndef ALL_YOLO_WINOGRAD_HPP
+#define ALL_YOLO_WINOGRAD_HPP
+
+#include <vector>
+#include <cstdint>
+#include "gemm.hpp"
+
+namespace yolo::internal
+{
+	/// 3x3 filters transformed for F(2x2, 3x3), as 16 matrices of filters * channels
+	struct winograd_filters
+	{
+		std::vector<float> 	u;
+		uint32_t 			filters = 0;
+		uint32_t 			channels = 0;
+	};
+
+	/// \param p_weights filters * channels * 3 * 3, in darknet's layout
+	winograd_filters 	winograd_transform_filters(const float* p_weights, uint32_t filters, uint32_t channels);
+
+	/// 3x3 convolution with stride 1 using Winograd F(2x2, 3x3): 2.25x less multiplications than the direct / im2col convolution.
+	/// The output tiles are computed as 16 matrix products ( see 'gemm' ), the transforms are spread over the OpenMP threads.
+	/// \param p_input channels * height * width
+	/// \param p_output filters * output_height * output_width
+	/// \param p_epilogue applied to each filter's output right after it is transformed back ( rows are filters, columns the output pixels )
+	void 				winograd_convolution(const winograd_filters& filters, const float* p_input, uint32_t width, uint32_t height, uint32_t pad, float* p_output, uint32_t output_width, uint32_t output_height, const gemm_epilogue* p_epilogue = nullptr);
+}
+
+#endif //ALL_YOLO_WINOGRAD_HPP
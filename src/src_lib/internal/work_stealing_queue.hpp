@@ -0,0 +1,138 @@
+#ifndef ALL_YOLO_WORK_STEALING_QUEUE_HPP
+#define ALL_YOLO_WORK_STEALING_QUEUE_HPP
+
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <condition_variable>
+
+namespace yolo::internal
+{
+	/// A deque per worker. Items are spread round robin over the deques, a worker takes from the front of its own deque,
+	/// and steals from the back of the others once its own is empty. So a worker that is stuck on a slow item does not hold up the items queued behind it.
+	/// T must have a 'queued_at' ( std::chrono::steady_clock::time_point ) member.
+	template<typename T>
+	class work_stealing_queue
+	{
+		public:
+			explicit work_stealing_queue(size_t num_workers)
+				: m_queues(num_workers)
+			{
+				for(auto& v : m_queues)
+				{
+					v = std::make_unique<worker_queue>();
+				}
+			}
+
+			void push(T&& item)
+			{
+				const size_t index = m_next_queue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+				{
+					std::lock_guard lock(m_queues[index]->mutex);
+					m_queues[index]->items.push_back(std::move(item));
+				}
+				{
+					std::lock_guard lock(m_wait_mutex);
+					m_version++;
+				}
+				m_wait_condition.notify_all();
+			}
+
+			/// wakes up all workers, 'pop' returns false once nothing is left
+			void close()
+			{
+				{
+					std::lock_guard lock(m_wait_mutex);
+					m_closed = true;
+				}
+				m_wait_condition.notify_all();
+			}
+
+			/// Takes up to 'max_count' items for the given worker. Blocks until there is at least 1 item.
+			/// Once it has an item, it keeps gathering until it has 'max_count' items, or until the oldest taken item has waited 'max_wait'.
+			/// \return false if the queue is closed and empty
+			bool pop(size_t worker_index, std::vector<T>& target, size_t max_count, std::chrono::microseconds max_wait)
+			{
+				while(true)
+				{
+					uint64_t version;
+					{
+						std::lock_guard lock(m_wait_mutex);
+						version = m_version;
+					}
+
+					take(worker_index, target, max_count);
+
+					std::unique_lock lock(m_wait_mutex);
+					if(target.empty())
+					{
+						if(m_closed)
+						{
+							return false;
+						}
+						m_wait_condition.wait(lock, [&](){ return m_closed || m_version != version; });
+						continue;
+					}
+
+					auto oldest = target.front().queued_at;
+					for(const auto& v : target)
+					{
+						oldest = std::min(oldest, v.queued_at);
+					}
+					const auto deadline = oldest + max_wait;
+					if(target.size() >= max_count || m_closed || std::chrono::steady_clock::now() >= deadline)
+					{
+						return true;
+					}
+					m_wait_condition.wait_until(lock, deadline, [&](){ return m_closed || m_version != version; });
+				}
+			}
+
+		private:
+			struct worker_queue
+			{
+				std::mutex 		mutex;
+				std::deque<T> 	items;
+			};
+
+			void take(size_t worker_index, std::vector<T>& target, size_t max_count)
+			{
+				// own queue first, oldest first
+				{
+					worker_queue& own = *m_queues[worker_index];
+					std::lock_guard lock(own.mutex);
+					while(!own.items.empty() && target.size() < max_count)
+					{
+						target.push_back(std::move(own.items.front()));
+						own.items.pop_front();
+					}
+				}
+
+				// then steal from the back of the others
+				for(size_t i=1; i<m_queues.size() && target.size() < max_count; i++)
+				{
+					worker_queue& victim = *m_queues[(worker_index + i) % m_queues.size()];
+					std::lock_guard lock(victim.mutex);
+					while(!victim.items.empty() && target.size() < max_count)
+					{
+						target.push_back(std::move(victim.items.back()));
+						victim.items.pop_back();
+					}
+				}
+			}
+
+			std::vector<std::unique_ptr<worker_queue>> 	m_queues;
+			std::atomic<size_t> 						m_next_queue = 0;
+
+			std::mutex 									m_wait_mutex;
+			std::condition_variable 					m_wait_condition;
+			uint64_t 									m_version = 0;
+			bool 										m_closed = false;
+	};
+}
+
+#endif //ALL_YOLO_WORK_STEALING_QUEUE_HPP
@@ -0,0 +1,291 @@
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include "yolo_decode.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define YOLO_DECODE_X86
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define YOLO_DECODE_NEON
+#endif
+
+namespace yolo::internal
+{
+	static float sigmoid(float v)
+	{
+		return 1.0f / (1.0f + std::exp(-v));
+	}
+
+	/// inverse of 'sigmoid'. sigmoid(v) > p  <=>  v > logit(p)
+	static float logit(float p)
+	{
+		if(p <= 0.0f)
+		{
+			return -std::numeric_limits<float>::infinity();
+		}
+		if(p >= 1.0f)
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+		return std::log(p / (1.0f - p));
+	}
+
+	void box_candidates::push(float x_, float y_, float w_, float h_, float score_, uint32_t class_id_)
+	{
+		if(size == x.size())
+		{
+			const size_t capacity = std::max<size_t>(64, size * 2);
+			x.resize(capacity);
+			y.resize(capacity);
+			w.resize(capacity);
+			h.resize(capacity);
+			score.resize(capacity);
+			class_id.resize(capacity);
+			order.resize(capacity);
+			suppressed.resize(capacity);
+		}
+		x[size] = x_;
+		y[size] = y_;
+		w[size] = w_;
+		h[size] = h_;
+		score[size] = score_;
+		class_id[size] = class_id_;
+		size++;
+	}
+
+	static size_t select_above_scalar(const float* p_values, size_t n, float threshold, uint32_t* p_indices_out)
+	{
+		size_t count = 0;
+		for(size_t i=0; i<n; i++)
+		{
+			if(p_values[i] > threshold)
+			{
+				p_indices_out[count++] = (uint32_t)i;
+			}
+		}
+		return count;
+	}
+
+#ifdef YOLO_DECODE_X86
+	__attribute__((target("avx2")))
+	static size_t select_above_avx2(const float* p_values, size_t n, float threshold, uint32_t* p_indices_out)
+	{
+		const __m256 t = _mm256_set1_ps(threshold);
+		size_t count = 0;
+		size_t i = 0;
+		for(; i+8<=n; i+=8)
+		{
+			uint32_t mask = (uint32_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(&p_values[i]), t, _CMP_GT_OQ));
+			while(mask != 0)
+			{
+				p_indices_out[count++] = (uint32_t)(i + __builtin_ctz(mask));
+				mask &= mask - 1;
+			}
+		}
+		for(; i<n; i++)
+		{
+			if(p_values[i] > threshold)
+			{
+				p_indices_out[count++] = (uint32_t)i;
+			}
+		}
+		return count;
+	}
+#endif
+
+#ifdef YOLO_DECODE_NEON
+	static size_t select_above_neon(const float* p_values, size_t n, float threshold, uint32_t* p_indices_out)
+	{
+		const float32x4_t t = vdupq_n_f32(threshold);
+		size_t count = 0;
+		size_t i = 0;
+		for(; i+4<=n; i+=4)
+		{
+			if(vmaxvq_u32(vcgtq_f32(vld1q_f32(&p_values[i]), t)) == 0)
+			{
+				continue; // the common case: nothing in these 4 passes
+			}
+			for(size_t k=i; k<i+4; k++)
+			{
+				if(p_values[k] > threshold)
+				{
+					p_indices_out[count++] = (uint32_t)k;
+				}
+			}
+		}
+		for(; i<n; i++)
+		{
+			if(p_values[i] > threshold)
+			{
+				p_indices_out[count++] = (uint32_t)i;
+			}
+		}
+		return count;
+	}
+#endif
+
+	size_t select_above(const float* p_values, size_t n, float threshold, uint32_t* p_indices_out)
+	{
+		using select_above_fn = size_t(*)(const float*, size_t, float, uint32_t*);
+		static const select_above_fn s_fn = []()
+		{
+#ifdef YOLO_DECODE_X86
+			if(__builtin_cpu_supports("avx2"))
+			{
+				return (select_above_fn)select_above_avx2;
+			}
+#endif
+#ifdef YOLO_DECODE_NEON
+			return (select_above_fn)select_above_neon;
+#endif
+			return (select_above_fn)select_above_scalar;
+		}();
+		return s_fn(p_values, n, threshold, p_indices_out);
+	}
+
+	void decode_yolo_heads(const std::vector<yolo_head>& heads, uint32_t batch_index, const decode_args& args, box_candidates& target)
+	{
+		target.clear();
+
+		const float objectness_logit_thresh = logit(args.thresh);
+
+		// same correction as darknet's 'correct_yolo_boxes' ( relative )
+		const auto [net_w, net_h] = args.network_size;
+		const auto [src_w, src_h] = args.source_size;
+		uint32_t new_w = net_w;
+		uint32_t new_h = net_h;
+		if(args.letter_box)
+		{
+			if(((float)net_w / (float)src_w) < ((float)net_h / (float)src_h))
+			{
+				new_h = (src_h * net_w) / src_w;
+			}
+			else
+			{
+				new_w = (src_w * net_h) / src_h;
+			}
+		}
+		const float ratio_w = (float)new_w / (float)net_w;
+		const float ratio_h = (float)new_h / (float)net_h;
+		const float offset_x = (float)(net_w - new_w) / 2.0f / (float)net_w;
+		const float offset_y = (float)(net_h - new_h) / 2.0f / (float)net_h;
+
+		for(const yolo_head& head : heads)
+		{
+			const size_t plane = (size_t)head.width * head.height;
+			const size_t entries = 5 + head.classes;
+			if(target.cells.size() < plane)
+			{
+				target.cells.resize(plane);
+			}
+
+			for(size_t a=0; a<head.anchors.size(); a++)
+			{
+				const float* p = head.p_output + (size_t)batch_index * head.outputs + a * entries * plane;
+				const float* p_objectness = p + 4 * plane;
+
+				const size_t num_cells = select_above(p_objectness, plane, objectness_logit_thresh, target.cells.data());
+				for(size_t k=0; k<num_cells; k++)
+				{
+					const uint32_t cell = target.cells[k];
+					const float objectness = sigmoid(p_objectness[cell]);
+					bool is_decoded = false;
+					float bx = 0.0f, by = 0.0f, bw = 0.0f, bh = 0.0f;
+
+					for(uint32_t c=0; c<head.classes; c++)
+					{
+						const float prob = objectness * sigmoid(p[(5 + c) * plane + cell]);
+						if(prob <= args.thresh)
+						{
+							continue;
+						}
+						if(!is_decoded)
+						{
+							const float column = (float)(cell % head.width);
+							const float row = (float)(cell / head.width);
+							const float grid_offset = -0.5f * (head.scale_x_y - 1.0f);
+							bx = (column + sigmoid(p[0 * plane + cell]) * head.scale_x_y + grid_offset) / (float)head.width;
+							by = (row + sigmoid(p[1 * plane + cell]) * head.scale_x_y + grid_offset) / (float)head.height;
+							bw = std::exp(p[2 * plane + cell]) * head.anchors[a].first / (float)net_w;
+							bh = std::exp(p[3 * plane + cell]) * head.anchors[a].second / (float)net_h;
+
+							bx = (bx - offset_x) / ratio_w;
+							by = (by - offset_y) / ratio_h;
+							bw /= ratio_w;
+							bh /= ratio_h;
+							is_decoded = true;
+						}
+						target.push(bx, by, bw, bh, prob, c);
+					}
+				}
+			}
+		}
+	}
+
+	static float iou(const box_candidates& c, uint32_t a, uint32_t b)
+	{
+		const float overlap_w = std::min(c.x[a] + c.w[a] * 0.5f, c.x[b] + c.w[b] * 0.5f) - std::max(c.x[a] - c.w[a] * 0.5f, c.x[b] - c.w[b] * 0.5f);
+		const float overlap_h = std::min(c.y[a] + c.h[a] * 0.5f, c.y[b] + c.h[b] * 0.5f) - std::max(c.y[a] - c.h[a] * 0.5f, c.y[b] - c.h[b] * 0.5f);
+		if(overlap_w <= 0.0f || overlap_h <= 0.0f)
+		{
+			return 0.0f;
+		}
+		const float intersection = overlap_w * overlap_h;
+		return intersection / (c.w[a] * c.h[a] + c.w[b] * c.h[b] - intersection);
+	}
+
+	void nms(box_candidates& candidates, float nms_thresh)
+	{
+		const size_t n = candidates.size;
+		uint32_t* order = candidates.order.data();
+		uint8_t* suppressed = candidates.suppressed.data();
+		std::iota(order, order + n, 0u);
+		std::fill(suppressed, suppressed + n, 0);
+		std::sort(order, order + n, [&](uint32_t a, uint32_t b)
+		{
+			if(candidates.class_id[a] != candidates.class_id[b])
+			{
+				return candidates.class_id[a] < candidates.class_id[b];
+			}
+			return candidates.score[a] > candidates.score[b];
+		});
+
+		size_t num_kept = 0;
+		for(size_t i=0; i<n; i++)
+		{
+			if(suppressed[i] != 0)
+			{
+				continue;
+			}
+			const uint32_t a = order[i];
+			for(size_t j=i+1; j<n && candidates.class_id[order[j]] == candidates.class_id[a]; j++)
+			{
+				if(suppressed[j] == 0 && iou(candidates, a, order[j]) > nms_thresh)
+				{
+					suppressed[j] = 1;
+				}
+			}
+			order[num_kept++] = a; // num_kept <= i, so this never overwrites an entry that is still to be visited
+		}
+		candidates.num_kept = num_kept;
+	}
+
+	void to_detections(const box_candidates& candidates, std::vector<detection>& target)
+	{
+		for(size_t i=0; i<candidates.num_kept; i++)
+		{
+			const uint32_t k = candidates.order[i];
+			target.push_back(detection{
+				.class_id 	= candidates.class_id[k],
+				.confidence = candidates.score[k],
+				.x 			= candidates.x[k],
+				.y 			= candidates.y[k],
+				.w 			= candidates.w[k],
+				.h 			= candidates.h[k]
+			});
+		}
+	}
+}
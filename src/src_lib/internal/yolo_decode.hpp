@@ -0,0 +1,71 @@
+#ifndef ALL_YOLO_YOLO_DECODE_HPP
+#define ALL_YOLO_YOLO_DECODE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <yolo.hpp>
+
+namespace yolo::internal
+{
+	/// output of a [yolo] layer, before the logistic activation is applied
+	struct yolo_head
+	{
+		/// layout per batch item: [anchor][x, y, w, h, objectness, class_0 ... class_n][height][width]
+		const float* 		p_output = nullptr;
+		uint32_t 			outputs = 0; 			// floats per batch item
+		uint32_t 			width = 0;
+		uint32_t 			height = 0;
+		uint32_t 			classes = 0;
+		float 				scale_x_y = 1.0f;
+
+		/// anchor size ( in network input pixels ) per anchor of this head ( the 'mask' ones )
+		std::vector<std::pair<float, float>> anchors;
+	};
+
+	/// candidate boxes as structure of arrays. All buffers are kept in between frames, so decoding does not allocate once warmed up.
+	struct box_candidates
+	{
+		std::vector<float> 		x;
+		std::vector<float> 		y;
+		std::vector<float> 		w;
+		std::vector<float> 		h;
+		std::vector<float> 		score;
+		std::vector<uint32_t> 	class_id;
+		size_t 					size = 0;
+
+		/// after 'nms': the indices of the boxes that were kept ( the first 'num_kept' ), sorted by class, then by descending score
+		std::vector<uint32_t> 	order;
+		size_t 					num_kept = 0;
+
+		// scratch
+		std::vector<uint32_t> 	cells;
+		std::vector<uint8_t> 	suppressed;
+
+		void 					clear() { size = 0; num_kept = 0; }
+		void 					push(float x, float y, float w, float h, float score, uint32_t class_id);
+	};
+
+	struct decode_args
+	{
+		std::pair<uint32_t, uint32_t> 	network_size;
+		std::pair<uint32_t, uint32_t> 	source_size;
+		bool 							letter_box = false;
+		float 							thresh = 0.25f;
+	};
+
+	/// decodes all boxes of which ( objectness * class probability ) > thresh.
+	/// the objectness threshold is tested on the raw logits with SIMD, so the logistic and the box decoding is only done for the cells that pass.
+	void decode_yolo_heads(const std::vector<yolo_head>& heads, uint32_t batch_index, const decode_args& args, box_candidates& target);
+
+	/// per class non maximum suppression ( same as darknet's 'do_nms_sort' ). fills 'order' and 'num_kept' of the candidates
+	void nms(box_candidates& candidates, float nms_thresh);
+
+	void to_detections(const box_candidates& candidates, std::vector<detection>& target);
+
+	/// indices ( in range 0 - n ) of the values that are > threshold
+	/// \return amount of indices written to 'p_indices_out' ( which must have room for n indices )
+	size_t select_above(const float* p_values, size_t n, float threshold, uint32_t* p_indices_out);
+}
+
+#endif //ALL_YOLO_YOLO_DECODE_HPP
@@ -3,7 +3,7 @@ static const char * s_cfg_yolov3 = R"______(
 [net]
 
 @ifdef testing
-	batch=1
+	batch=${testing_batch}
 	subdivisions=1
 @else # training
 	batch=${training_batch}
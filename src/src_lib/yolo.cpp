@@ -1,13 +1,24 @@
 #include <iostream>
 #include <yolo.hpp>
 #include <fstream>
+#include <thread>
+#include <atomic>
 #include "internal/annotations.hpp"
 #include "internal/cfg.hpp"
 #include "internal/internal.hpp"
 #include "internal/python.hpp"
 #include "internal/http.hpp"
 #include "internal/http_server.hpp"
+#include "internal/detector.hpp"
+#include "internal/quantization.hpp"
+#include "internal/pruning.hpp"
+#include "internal/topology.hpp"
+#include "internal/video_pipeline.hpp"
 #include "models/yolov3.h"
+
+#ifdef OPENCV
+#include "image_opencv.h"
+#endif
 //#include <opencv4/opencv2/opencv.hpp>
 // https://colab.research.google.com/drive/1dT1xZ6tYClq4se4kOTen_u5MSHVHQ2hu
 
@@ -128,7 +139,8 @@ namespace yolo
 			cfg_load_args.predefinitions.emplace_back("training");
 			model_arg.inject_to_load_args(cfg_load_args);
 
-			auto cfg = cfg::load(s_cfg_yolov3, cfg_load_args);
+			// a pruned model ( see 'prune' ) is fine-tuned from its own weights
+			auto cfg = cfg::load(load_model_template(weights_folder_path, s_cfg_yolov3), cfg_load_args);
 			if(!cfg.has_value())
 			{
 				log("Failed to load cfg file");
@@ -247,56 +259,213 @@ namespace yolo
 			getchar(); // just wait for a key for now. server will stay active until then.
 		}
 
-		/// run YOLO v3 detection on an image
-		//void detect(const std::filesystem::path& image, const std::filesystem::path& weights_filepath, const model_args& args)
-		//{
-
-		//}
-
-		/// run YOLO v3 detection on an image
-		//void detect(const image& image, const std::filesystem::path& weights_filepath, const model_args& args)
-		//{
-
-		//}
-
-		bool demo(const std::filesystem::path& weights_path, const std::filesystem::path& source)
+		/// finds the 'config.cfg' written by 'train' for the given weights file or folder
+		static std::optional<std::filesystem::path> find_config_file(const std::filesystem::path& weights_path)
 		{
-			std::filesystem::path config_file = weights_path / "config.cfg"; // std::filesystem::temp_directory_path();
+			const std::filesystem::path folder = std::filesystem::is_directory(weights_path) ? weights_path : weights_path.parent_path();
+			std::filesystem::path config_file = folder / "config.cfg";
 			if(!std::filesystem::exists(config_file))
 			{
-				config_file = weights_path / ".." / "config.cfg";
+				config_file = folder / ".." / "config.cfg";
 				if(!std::filesystem::exists(config_file))
 				{
-					log("Failed to load '" + config_file.string() + "' or '" + (weights_path / "config.cfg").string() + "'");
-					return false;
+					log("Failed to load '" + config_file.string() + "' or '" + (folder / "config.cfg").string() + "'");
+					return std::nullopt;
 				}
 			}
+			return config_file;
+		}
+
+		static std::optional<cfg::cfg> load_testing_cfg(const std::filesystem::path& weights_path, uint32_t batch)
+		{
+			const auto config_file = find_config_file(weights_path);
+			if(!config_file)
+			{
+				return std::nullopt;
+			}
 
 			// load full args
-			const std::optional<full_args> model_arg = full_args::from_file(config_file);
+			const std::optional<full_args> model_arg = full_args::from_file(*config_file);
 			if(!model_arg)
 			{
-				log("Failed to load '" + config_file.string() + "'");
-				return false;
+				log("Failed to load '" + config_file->string() + "'");
+				return std::nullopt;
 			}
 
 			// load model args
 			cfg::load_args cfg_load_args;
 			cfg_load_args.predefinitions.emplace_back("testing");
+			cfg_load_args.variables.insert({"testing_batch", std::to_string(batch)});
 			model_arg->inject_to_load_args(cfg_load_args);
 
-			auto cfg = cfg::load(s_cfg_yolov3, cfg_load_args);
+			auto cfg = cfg::load(load_model_template(config_file->parent_path(), s_cfg_yolov3), cfg_load_args);
 			if(!cfg.has_value())
 			{
 				log("Failed to load cfg file");
+				return std::nullopt;
+			}
+			return cfg;
+		}
+
+		std::unique_ptr<detector> detector::create(const std::filesystem::path& weights_path, const detector_args& args)
+		{
+			const auto cfg = load_testing_cfg(weights_path, std::max(args.max_batch_size, 1u));
+			if(!cfg.has_value())
+			{
+				return nullptr;
+			}
+
+			const auto weights_filepath = std::filesystem::is_directory(weights_path) ? find_latest_weights(weights_path) : std::make_optional(weights_path);
+			if(!weights_filepath.has_value())
+			{
+				log("Failed to find any .weights in '" + weights_path.string() + "'");
+				return nullptr;
+			}
+
+			std::optional<std::filesystem::path> int8_filepath;
+			if(args.int8)
+			{
+				int8_filepath = find_config_file(weights_path)->parent_path() / "config.int8";
+			}
+
+			auto p_internal = detector_internal::create(*cfg, *weights_filepath, args, int8_filepath);
+			if(p_internal == nullptr)
+			{
+				return nullptr;
+			}
+			return std::unique_ptr<detector>(new detector(std::move(p_internal)));
+		}
+
+		std::optional<quantization_report> quantize(const std::filesystem::path& images_and_txt_annotations_folder, const std::filesystem::path& weights_path, const quantize_args& args)
+		{
+			const auto cfg = load_testing_cfg(weights_path, 1);
+			if(!cfg.has_value())
+			{
+				return std::nullopt;
+			}
+
+			const auto weights_filepath = std::filesystem::is_directory(weights_path) ? find_latest_weights(weights_path) : std::make_optional(weights_path);
+			if(!weights_filepath.has_value())
+			{
+				log("Failed to find any .weights in '" + weights_path.string() + "'");
+				return std::nullopt;
+			}
+
+			auto images = annotations::annotations_collection::load(images_and_txt_annotations_folder);
+			if(!images.has_value())
+			{
+				log("Failed to load annotations");
+				return std::nullopt;
+			}
+
+			const std::filesystem::path int8_filepath = find_config_file(weights_path)->parent_path() / "config.int8";
+			return internal::quantize(*cfg, *weights_filepath, *images, args, int8_filepath);
+		}
+
+		std::optional<prune_report> prune(const std::filesystem::path& weights_path, const std::filesystem::path& target_folder, const prune_args& args)
+		{
+			const auto config_file = find_config_file(weights_path);
+			const auto cfg = load_testing_cfg(weights_path, 1);
+			if(!config_file.has_value() || !cfg.has_value())
+			{
+				return std::nullopt;
+			}
+
+			const auto weights_filepath = std::filesystem::is_directory(weights_path) ? find_latest_weights(weights_path) : std::make_optional(weights_path);
+			if(!weights_filepath.has_value())
+			{
+				log("Failed to find any .weights in '" + weights_path.string() + "'");
+				return std::nullopt;
+			}
+
+			const std::string model_template = load_model_template(config_file->parent_path(), s_cfg_yolov3);
+			auto report = internal::prune(*cfg, model_template, *weights_filepath, args, target_folder);
+			if(!report.has_value())
+			{
+				return std::nullopt;
+			}
+			std::error_code ec;
+			std::filesystem::copy_file(*config_file, target_folder / "config.cfg", std::filesystem::copy_options::overwrite_existing, ec);
+			if(ec)
+			{
+				log("Failed to copy '" + config_file->string() + "' to '" + target_folder.string() + "'");
+				return std::nullopt;
+			}
+			return report;
+		}
+
+		std::unique_ptr<video_pipeline> video_pipeline::start(const std::filesystem::path& weights_path, const std::string& source, sink sink, const video_args& args)
+		{
+			const auto cfg = load_testing_cfg(weights_path, 1);
+			if(!cfg.has_value())
+			{
+				return nullptr;
+			}
+
+			const auto weights_filepath = std::filesystem::is_directory(weights_path) ? find_latest_weights(weights_path) : std::make_optional(weights_path);
+			if(!weights_filepath.has_value())
+			{
+				log("Failed to find any .weights in '" + weights_path.string() + "'");
+				return nullptr;
+			}
+
+			auto p_internal = video_pipeline_internal::start(*cfg, *weights_filepath, source, std::move(sink), args);
+			if(p_internal == nullptr)
+			{
+				return nullptr;
+			}
+			return std::unique_ptr<video_pipeline>(new video_pipeline(std::move(p_internal)));
+		}
+
+		bool demo(const std::filesystem::path& weights_path, const std::filesystem::path& source)
+		{
+			std::atomic<bool> closed = false;
+			auto p_pipeline = video_pipeline::start(weights_path, source.string(), [&](video_frame&& frame)
+			{
+#ifdef OPENCV
+				yolo::internal::draw_detections(frame.source, frame.detections);
+				::image window_image = make_image((int)frame.source.width_px, (int)frame.source.height_px, 3);
+				const size_t plane = (size_t)frame.source.width_px * frame.source.height_px;
+				for(size_t i=0; i<plane; i++)
+				{
+					for(size_t c=0; c<3; c++)
+					{
+						window_image.data[c * plane + i] = (float)frame.source.data[i*3 + c] / 255.0f;
+					}
+				}
+				show_image_cv(window_image, "Demo");
+				free_image(window_image);
+				if(wait_key_cv(1) == 27)
+				{
+					closed = true;
+				}
+#else
+				log("Frame " + std::to_string(frame.index) + ": " + std::to_string(frame.detections.size()) + " detections, " + std::to_string(frame.latency_ms) + " ms");
+#endif
+			});
+			if(p_pipeline == nullptr)
+			{
 				return false;
 			}
-			start_darknet_demo(*cfg, weights_path, source);
+			while(!p_pipeline->is_done() && !closed)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+			p_pipeline->stop();
+
+			const video_metrics metrics = p_pipeline->metrics();
+			log("Frames read: " + std::to_string(metrics.frames_read) + ", done: " + std::to_string(metrics.frames_done) + ", dropped: " + std::to_string(metrics.frames_dropped)
+				+ ", average latency: " + std::to_string(metrics.average_latency_ms) + " ms");
 			return true;
 		}
 
 	}
 
+	const cpu_topology& topology()
+	{
+		static const cpu_topology s_topology = detect_topology();
+		return s_topology;
+	}
 
 	std::optional<internal::folder_and_server> obtain_trainingdata_server(const std::string_view& server)
 	{
@@ -540,11 +709,49 @@ namespace yolo
 			}
 			return std::unique_ptr<server>(new server(std::move(t)));
 #else
-			(void)images_and_txt_annotations_folder;
+			(void)data_source;
 			(void)weights_folder_path;
+			(void)chart_png_path;
+			(void)latest_weights_filepath;
+			(void)port;
 			log("This library was build without minizip. 'server::start' cannot be used");
 			return nullptr;
 #endif
 		}
+
+		std::unique_ptr<server> start_detection(std::shared_ptr<v3::detector> p_detector, unsigned int num_workers, unsigned int port)
+		{
+			if(p_detector == nullptr)
+			{
+				return nullptr;
+			}
+			yolo::http::server::init_args args = {
+					.data_source = "",
+					.weights_folder_path = "",
+					.chart_png_path = "",
+					.latest_weights_filepath = std::nullopt,
+					.port = port,
+					.p_detector = std::move(p_detector),
+					.num_workers = num_workers
+			};
+
+			std::unique_ptr<server_internal> t = std::make_unique<server_internal>(std::move(args));
+			if(!t->is_running())
+			{
+				return nullptr;
+			}
+			return std::unique_ptr<server>(new server(std::move(t)));
+		}
+
+		std::unique_ptr<server> start_detection(const std::filesystem::path& weights_path, const v3::detector_args& detector_args, unsigned int num_workers, unsigned int port)
+		{
+			std::shared_ptr<v3::detector> p_detector = v3::detector::create(weights_path, detector_args);
+			if(p_detector == nullptr)
+			{
+				log("Error: Failed to load the detector for the server.");
+				return nullptr;
+			}
+			return start_detection(std::move(p_detector), num_workers, port);
+		}
 	}
 }
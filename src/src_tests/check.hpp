@@ -0,0 +1,35 @@
+#ifndef ALL_YOLO_TESTS_CHECK_HPP
+#define ALL_YOLO_TESTS_CHECK_HPP
+
+#include <cstdio>
+
+namespace yolo::tests
+{
+	inline int g_num_failed = 0;
+}
+
+/// logs a failed condition, and keeps going. a test returns 'yolo::tests::exit_code()' from main
+#define CHECK(condition) \
+	do \
+	{ \
+		if(!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+			yolo::tests::g_num_failed++; \
+		} \
+	} while(false)
+
+namespace yolo::tests
+{
+	inline int exit_code()
+	{
+		if(g_num_failed != 0)
+		{
+			fprintf(stderr, "%d check(s) failed\n", g_num_failed);
+			return 1;
+		}
+		return 0;
+	}
+}
+
+#endif //ALL_YOLO_TESTS_CHECK_HPP
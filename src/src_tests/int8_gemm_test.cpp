@@ -0,0 +1,166 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "int8_gemm.hpp"
+#include "check.hpp"
+
+// 'quantize_columns' + 'int8_gemm' against the integer sums they stand for, and against im2col + 'gemm' in float, within the quantization error
+
+namespace
+{
+	struct shape
+	{
+		uint32_t channels;
+		uint32_t filters;
+		uint32_t width;
+		uint32_t height;
+		uint32_t size;
+		uint32_t stride;
+		uint32_t pad;
+	};
+
+	/// columns[k][pixel], the layout 'gemm' takes
+	void im2col(const std::vector<float>& input, const shape& s, uint32_t output_width, uint32_t output_height, std::vector<float>& columns)
+	{
+		const size_t n = (size_t)output_width * output_height;
+		columns.assign((size_t)s.channels * s.size * s.size * n, 0.0f);
+		for(uint32_t c=0; c<s.channels; c++)
+		{
+			for(uint32_t k=0; k<s.size * s.size; k++)
+			{
+				float* p_row = &columns[((size_t)c * s.size * s.size + k) * n];
+				for(uint32_t y=0; y<output_height; y++)
+				{
+					for(uint32_t x=0; x<output_width; x++)
+					{
+						const int64_t source_y = (int64_t)y * s.stride + k / s.size - s.pad;
+						const int64_t source_x = (int64_t)x * s.stride + k % s.size - s.pad;
+						if(source_y >= 0 && source_y < s.height && source_x >= 0 && source_x < s.width)
+						{
+							p_row[(size_t)y * output_width + x] = input[((size_t)c * s.height + source_y) * s.width + source_x];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+int main()
+{
+	// depths of 27, 45, 40 and 297 are not a multiple of 32, 7, 13 and 5 filters not of the 4 rows the kernels take, odd column counts end in a single column,
+	// and the larger ones span several blocks of 64 columns. pad 1 puts zero points in the columns at the borders
+	const shape shapes[] = {
+		{3, 16, 13, 11, 3, 1, 1},
+		{5, 7, 9, 9, 3, 2, 1},
+		{40, 13, 17, 9, 1, 1, 0},
+		{33, 5, 8, 8, 3, 1, 0},
+		{64, 32, 26, 26, 3, 1, 1}
+	};
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	for(const auto& s : shapes)
+	{
+		const uint32_t output_width = (s.width + 2 * s.pad - s.size) / s.stride + 1;
+		const uint32_t output_height = (s.height + 2 * s.pad - s.size) / s.stride + 1;
+		const size_t n = (size_t)output_width * output_height;
+		const uint32_t depth = s.channels * s.size * s.size;
+		std::vector<float> input((size_t)s.channels * s.width * s.height);
+		std::vector<float> weights((size_t)s.filters * depth);
+		std::vector<float> biases(s.filters);
+		std::vector<float> residual(s.filters * n);
+		for(auto* p_values : {&input, &weights, &biases, &residual})
+		{
+			std::generate(p_values->begin(), p_values->end(), [&](){ return distribution(random); });
+		}
+		float max_abs = 0.0f;
+		for(float v : input)
+		{
+			max_abs = std::max(max_abs, std::fabs(v));
+		}
+		const float input_scale = max_abs / 127.0f; // as the calibration sets it, so nothing is clamped
+
+		const auto quantized = yolo::internal::int8_weights::quantize(weights.data(), s.filters, depth);
+		CHECK(quantized.depth_padded % yolo::internal::s_int8_depth_alignment == 0 && quantized.depth_padded >= depth);
+		std::vector<uint8_t> quantized_columns(n * quantized.depth_padded);
+		yolo::internal::quantize_columns(input.data(), s.channels, s.height, s.width, s.size, s.stride, s.pad, output_width, output_height, input_scale, quantized_columns.data(), quantized.depth_padded);
+
+		std::vector<float> columns;
+		im2col(input, s, output_width, output_height, columns);
+		for(size_t pixel=0; pixel<n; pixel++)
+		{
+			const uint8_t* p_row = &quantized_columns[pixel * quantized.depth_padded];
+			for(size_t k=0; k<depth; k++)
+			{
+				// the padding of the input is a zero, so it quantizes to the zero point
+				CHECK(columns[k * n + pixel] != 0.0f || p_row[k] == yolo::internal::s_int8_zero_point);
+			}
+			CHECK(std::all_of(p_row + depth, p_row + quantized.depth_padded, [](uint8_t q){ return q == yolo::internal::s_int8_zero_point; }));
+		}
+
+		// the integer sums are exact, whichever kernel took them
+		std::vector<float> output(s.filters * n);
+		yolo::internal::int8_gemm(quantized, quantized_columns.data(), n, input_scale, output.data(), n, nullptr);
+		size_t num_mismatches = 0;
+		for(size_t r=0; r<s.filters; r++)
+		{
+			for(size_t pixel=0; pixel<n; pixel++)
+			{
+				int64_t sum = 0;
+				for(size_t k=0; k<quantized.depth_padded; k++)
+				{
+					sum += (int64_t)quantized.data[r * quantized.depth_padded + k] * ((int64_t)quantized_columns[pixel * quantized.depth_padded + k] - yolo::internal::s_int8_zero_point);
+				}
+				const float expected = (float)sum * (quantized.scales[r] * input_scale);
+				num_mismatches += std::fabs(output[r * n + pixel] - expected) > 1e-6f * std::max(1.0f, std::fabs(expected)) ? 1 : 0;
+			}
+		}
+		CHECK(num_mismatches == 0);
+
+		// the fused epilogue ( bias, leaky, residual ) gives the same as applying it afterwards
+		yolo::internal::gemm_epilogue epilogue;
+		epilogue.p_bias = biases.data();
+		epilogue.act = yolo::internal::gemm_epilogue::activation::leaky;
+		epilogue.p_residual = residual.data();
+		epilogue.ld_residual = n;
+		std::vector<float> expected = output;
+		for(size_t r=0; r<s.filters; r++)
+		{
+			epilogue.offset(r, 0).apply(&expected[r * n], n);
+		}
+		yolo::internal::int8_gemm(quantized, quantized_columns.data(), n, input_scale, output.data(), n, &epilogue);
+		num_mismatches = 0;
+		for(size_t i=0; i<output.size(); i++)
+		{
+			num_mismatches += std::fabs(output[i] - expected[i]) > 1e-6f * std::max(1.0f, std::fabs(expected[i])) ? 1 : 0;
+		}
+		CHECK(num_mismatches == 0);
+
+		// against float: leaky does not grow a difference, so each value stays within the rounding of its products,
+		// |w| * input_scale / 2 + ( |x| + input_scale / 2 ) * weight_scale / 2 per product
+		yolo::internal::gemm(s.filters, n, depth, weights.data(), depth, columns.data(), n, expected.data(), n, false, &epilogue);
+		size_t num_outside = 0;
+		float max_error = 0.0f;
+		for(size_t r=0; r<s.filters; r++)
+		{
+			for(size_t pixel=0; pixel<n; pixel++)
+			{
+				float bound = 1e-4f;
+				for(size_t k=0; k<depth; k++)
+				{
+					bound += std::fabs(weights[r * depth + k]) * input_scale / 2.0f + (std::fabs(columns[k * n + pixel]) + input_scale / 2.0f) * quantized.scales[r] / 2.0f;
+				}
+				const float error = std::fabs(output[r * n + pixel] - expected[r * n + pixel]);
+				num_outside += error > bound ? 1 : 0;
+				max_error = std::max(max_error, error);
+			}
+		}
+		CHECK(num_outside == 0);
+		if(num_outside != 0)
+		{
+			fprintf(stderr, "  %u channels, %u filters, %ux%u, size %u, stride %u, pad %u: %zu values outside the bound, error up to %g\n", s.channels, s.filters, s.width, s.height, s.size, s.stride, s.pad, num_outside, max_error);
+		}
+	}
+	return yolo::tests::exit_code();
+}
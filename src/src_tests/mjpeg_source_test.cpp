@@ -0,0 +1,203 @@
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <httplib.h>
+#include <stb_image_write.h>
+#include "mjpeg_source.hpp"
+#include "check.hpp"
+
+// the multipart parser on hand made streams, and 'open_mjpeg_source' against a stand-in camera on localhost
+
+static std::vector<std::vector<uint8_t>> parse(const std::string& boundary, const std::string& stream, size_t chunk_size)
+{
+	yolo::internal::multipart_parser parser(boundary);
+	std::vector<std::vector<uint8_t>> parts;
+	for(size_t i=0; i<stream.size(); i+=chunk_size)
+	{
+		const size_t size = std::min(chunk_size, stream.size() - i);
+		parser.feed((const uint8_t*)stream.data() + i, size, [&](std::vector<uint8_t>&& body){ parts.push_back(std::move(body)); });
+	}
+	return parts;
+}
+
+/// \param delimiter the line the parts start with
+static std::string make_stream(const std::string& delimiter, const std::vector<std::string>& bodies, bool content_length)
+{
+	std::string stream = "\r\n"; // some cameras start with an empty line
+	for(const auto& body : bodies)
+	{
+		stream += delimiter + "\r\nContent-Type: image/jpeg\r\n";
+		if(content_length)
+		{
+			stream += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+		}
+		stream += "\r\n" + body + "\r\n";
+	}
+	return stream + delimiter + "--\r\n"; // without a Content-Length, a part ends at the next delimiter
+}
+
+static void check_parts(const std::vector<std::vector<uint8_t>>& parts, const std::vector<std::string>& bodies)
+{
+	CHECK(parts.size() == bodies.size());
+	for(size_t i=0; i<std::min(parts.size(), bodies.size()); i++)
+	{
+		CHECK(std::string(parts[i].begin(), parts[i].end()) == bodies[i]);
+	}
+}
+
+static void test_parser()
+{
+	const std::vector<std::string> bodies = {"first", std::string("\xff\xd8 binary \0 with a \r\n line break \xff\xd9", 34), "third"};
+	// with Content-Length a body can hold anything, also what looks like the start of a delimiter
+	std::vector<std::string> length_bodies = bodies;
+	length_bodies.push_back("\r\n--fram");
+
+	for(size_t chunk_size : {1, 2, 3, 7, 64, 4096})
+	{
+		check_parts(parse("frame", make_stream("--frame", length_bodies, true), chunk_size), length_bodies);
+		check_parts(parse("frame", make_stream("--frame", bodies, false), chunk_size), bodies);
+
+		// the boundary parameter starts with "--", and the delimiter adds an other "--" ( as the RFC says )
+		check_parts(parse("--frame", make_stream("----frame", bodies, false), chunk_size), bodies);
+		check_parts(parse("--frame", make_stream("----frame", length_bodies, true), chunk_size), length_bodies);
+
+		// the camera quirk: the boundary parameter is used as the delimiter as is
+		check_parts(parse("--frame", make_stream("--frame", bodies, false), chunk_size), bodies);
+		check_parts(parse("--frame", make_stream("--frame", length_bodies, true), chunk_size), length_bodies);
+	}
+
+	CHECK(yolo::internal::multipart_parser::find_boundary("multipart/x-mixed-replace; boundary=frame") == "frame");
+	CHECK(yolo::internal::multipart_parser::find_boundary(" Multipart/x-mixed-replace;boundary=\"--my frame\"; charset=x") == "--my frame");
+	CHECK(!yolo::internal::multipart_parser::find_boundary("image/jpeg").has_value());
+	CHECK(!yolo::internal::multipart_parser::find_boundary("multipart/x-mixed-replace").has_value());
+}
+
+static std::string encode_jpeg(uint8_t gray)
+{
+	const std::vector<uint8_t> pixels(16 * 8 * 3, gray);
+	std::string jpeg;
+	stbi_write_jpg_to_func([](void* p_context, void* p_data, int size)
+	{
+		((std::string*)p_context)->append((const char*)p_data, (size_t)size);
+	}, &jpeg, 16, 8, 3, pixels.data(), 95);
+	return jpeg;
+}
+
+static std::string part(const std::string& delimiter, const std::string& jpeg, bool content_length)
+{
+	return delimiter + "\r\nContent-Type: image/jpeg\r\n" + (content_length ? "Content-Length: " + std::to_string(jpeg.size()) + "\r\n" : "") + "\r\n" + jpeg + "\r\n";
+}
+
+static void test_source()
+{
+	constexpr size_t num_frames = 5;
+	std::atomic<bool> stop = false;
+
+	httplib::Server server;
+	server.set_keep_alive_max_count(1); // a stream ends with its connection
+	server.Get("/text", [](const httplib::Request&, httplib::Response& res)
+	{
+		res.set_content("not a stream", "text/plain");
+	});
+	for(const bool quirk : {false, true})
+	{
+		server.Get(quirk ? "/quirk" : "/stream", [quirk](const httplib::Request&, httplib::Response& res)
+		{
+			res.set_content_provider(quirk ? "multipart/x-mixed-replace; boundary=--frame" : "multipart/x-mixed-replace; boundary=frame", [quirk](size_t, httplib::DataSink& sink)
+			{
+				for(size_t i=0; i<num_frames; i++)
+				{
+					const std::string data = part("--frame", encode_jpeg((uint8_t)(40 + i * 40)), !quirk);
+					sink.write(data.data(), data.size());
+				}
+				sink.write("--frame--\r\n", 11);
+				sink.done();
+				return true;
+			});
+		});
+	}
+	server.Get("/stall", [&stop](const httplib::Request&, httplib::Response& res)
+	{
+		auto p_sent = std::make_shared<bool>(false);
+		res.set_content_provider("multipart/x-mixed-replace; boundary=frame", [&stop, p_sent](size_t, httplib::DataSink& sink)
+		{
+			if(!*p_sent)
+			{
+				const std::string data = part("--frame", encode_jpeg(128), true);
+				sink.write(data.data(), data.size());
+				*p_sent = true;
+			}
+			// the camera stalls: the connection stays open, but nothing comes in
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			return !stop.load();
+		});
+	});
+	const int port = server.bind_to_any_port("127.0.0.1");
+	CHECK(port > 0);
+	std::thread server_thread([&](){ server.listen_after_bind(); });
+	while(!server.is_running())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const std::string url = "http://127.0.0.1:" + std::to_string(port);
+
+	CHECK(yolo::internal::open_mjpeg_source(url + "/text") == nullptr);
+
+	for(const char* path : {"/stream", "/quirk"})
+	{
+		auto p_source = yolo::internal::open_mjpeg_source(url + path);
+		CHECK(p_source != nullptr);
+		if(p_source == nullptr)
+		{
+			continue;
+		}
+		yolo::image frame;
+		yolo::image last;
+		size_t num_read = 0;
+		while(p_source->read(frame))
+		{
+			CHECK(frame.width_px == 16 && frame.height_px == 8 && frame.data.size() == 16 * 8 * 3);
+			last = frame;
+			num_read++;
+		}
+		// frames can be skipped, but the newest always comes trough
+		CHECK(num_read >= 1 && num_read <= num_frames);
+		CHECK(!last.data.empty() && std::abs((int)last.data[0] - (int)(40 + (num_frames - 1) * 40)) <= 4);
+	}
+
+	{
+		auto p_source = yolo::internal::open_mjpeg_source(url + "/stall");
+		CHECK(p_source != nullptr);
+		if(p_source != nullptr)
+		{
+			yolo::image frame;
+			CHECK(p_source->read(frame));
+
+			// 'interrupt' wakes a 'read' that waits for a frame that does not come
+			std::atomic<bool> returned = false;
+			bool result = true;
+			std::thread reader([&](){ result = p_source->read(frame); returned = true; });
+			std::this_thread::sleep_for(std::chrono::milliseconds(200));
+			CHECK(!returned.load());
+			const auto interrupted_at = std::chrono::steady_clock::now();
+			p_source->interrupt();
+			reader.join();
+			CHECK(!result);
+			p_source.reset(); // curl aborts from its progress callback
+			CHECK(std::chrono::steady_clock::now() - interrupted_at < std::chrono::seconds(3));
+		}
+	}
+
+	stop = true;
+	server.stop();
+	server_thread.join();
+}
+
+int main()
+{
+	test_parser();
+	test_source();
+	return yolo::tests::exit_code();
+}
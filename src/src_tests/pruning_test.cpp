@@ -0,0 +1,367 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <unordered_map>
+#include "pruning.hpp"
+#include "check.hpp"
+
+// 'prune' on a small residual model where some channels have a batchnorm scale of 0: the pruned model gives the same output as the original,
+// computed by a plain forward pass of the cfg and weights ( the same math as darknet's layers )
+
+namespace
+{
+	// 2 residual blocks on layer 0 ( layers 0, 2, 3, 5 and 6 keep the same channels ), a route of 2 widths, and a last convolution without batchnorm
+	// that is not pruned itself. the convolutions after a pruned layer are 1x1, or 3x3 without padding, where folding the constant of a removed
+	// channel into the batchnorm mean ( or the bias ) is exact
+	constexpr const char* s_model = R"([net]
+width=8
+height=8
+channels=3
+
+[convolutional]
+batch_normalize=1
+filters=8
+size=3
+stride=1
+pad=1
+activation=leaky
+
+[convolutional]
+batch_normalize=1
+filters=4
+size=1
+stride=1
+pad=1
+activation=leaky
+
+[convolutional]
+batch_normalize=1
+filters=8
+size=1
+stride=1
+pad=1
+activation=leaky
+
+[shortcut]
+from=-3
+activation=linear
+
+[convolutional]
+batch_normalize=1
+filters=4
+size=1
+stride=1
+pad=1
+activation=leaky
+
+[convolutional]
+batch_normalize=1
+filters=8
+size=1
+stride=1
+pad=1
+activation=leaky
+
+[shortcut]
+from=-3
+activation=linear
+
+[convolutional]
+batch_normalize=1
+filters=6
+size=1
+stride=1
+pad=1
+activation=leaky
+
+[route]
+layers=-1,-2
+
+[upsample]
+stride=2
+
+[convolutional]
+filters=5
+size=3
+stride=1
+pad=0
+activation=linear
+)";
+
+	struct section
+	{
+		std::string 									name;
+		std::unordered_map<std::string, std::string> 	values;
+
+		[[nodiscard]] int get(const std::string& key, int default_value) const
+		{
+			auto it = values.find(key);
+			return it != values.end() ? std::stoi(it->second) : default_value;
+		}
+	};
+
+	std::vector<std::string> split_lines(const std::string& text)
+	{
+		std::vector<std::string> lines;
+		std::istringstream stream(text);
+		for(std::string line; std::getline(stream, line);)
+		{
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	std::vector<section> parse_sections(const std::string& text)
+	{
+		std::vector<section> sections;
+		for(const auto& line : split_lines(text))
+		{
+			if(line.starts_with('['))
+			{
+				sections.push_back({.name = line.substr(1, line.find(']') - 1), .values = {}});
+			}
+			else if(line.find('=') != std::string::npos)
+			{
+				sections.back().values[line.substr(0, line.find('='))] = line.substr(line.find('=') + 1);
+			}
+		}
+		return sections;
+	}
+
+	struct tensor
+	{
+		uint32_t 			c = 0, h = 0, w = 0;
+		std::vector<float> 	values;
+
+		[[nodiscard]] float at(uint32_t channel, int64_t y, int64_t x) const
+		{
+			return y >= 0 && y < h && x >= 0 && x < w ? values[((size_t)channel * h + y) * w + x] : 0.0f;
+		}
+	};
+
+	float activate(const std::string& activation, float x)
+	{
+		return activation == "leaky" && x < 0.0f ? 0.1f * x : x;
+	}
+
+	/// the output of the last layer
+	tensor forward(const std::string& model, const std::filesystem::path& weights_filepath, const tensor& input)
+	{
+		const auto sections = parse_sections(model);
+		std::ifstream file(weights_filepath, std::ios::binary);
+		int32_t version[3] = {};
+		uint64_t seen = 0;
+		file.read((char*)version, sizeof(version));
+		file.read((char*)&seen, sizeof(seen));
+		auto read = [&](size_t count)
+		{
+			std::vector<float> v(count);
+			file.read((char*)v.data(), (std::streamsize)(count * sizeof(float)));
+			CHECK(file.good());
+			return v;
+		};
+
+		std::vector<tensor> outputs;
+		for(size_t s=1; s<sections.size(); s++)
+		{
+			const section& sec = sections[s];
+			const auto index = (int64_t)outputs.size();
+			const tensor& in = outputs.empty() ? input : outputs.back();
+			tensor out;
+			if(sec.name == "convolutional")
+			{
+				const auto filters = (uint32_t)sec.get("filters", 1);
+				const int size = sec.get("size", 1);
+				const int pad = sec.get("pad", 0) != 0 ? size / 2 : 0;
+				const bool batch_normalize = sec.get("batch_normalize", 0) != 0;
+				const auto biases = read(filters);
+				const auto scales = batch_normalize ? read(filters) : std::vector<float>();
+				const auto means = batch_normalize ? read(filters) : std::vector<float>();
+				const auto variances = batch_normalize ? read(filters) : std::vector<float>();
+				const auto weights = read((size_t)filters * in.c * size * size);
+				out.c = filters;
+				out.h = in.h + 2 * pad - size + 1;
+				out.w = in.w + 2 * pad - size + 1;
+				out.values.resize((size_t)out.c * out.h * out.w);
+				for(uint32_t o=0; o<out.c; o++)
+				{
+					for(uint32_t y=0; y<out.h; y++)
+					{
+						for(uint32_t x=0; x<out.w; x++)
+						{
+							float sum = 0.0f;
+							for(uint32_t c=0; c<in.c; c++)
+							{
+								for(int k=0; k<size * size; k++)
+								{
+									sum += weights[((size_t)o * in.c + c) * size * size + k] * in.at(c, (int64_t)y + k / size - pad, (int64_t)x + k % size - pad);
+								}
+							}
+							if(batch_normalize)
+							{
+								sum = (sum - means[o]) / std::sqrt(variances[o] + .000001f) * scales[o];
+							}
+							out.values[((size_t)o * out.h + y) * out.w + x] = activate(sec.values.at("activation"), sum + biases[o]);
+						}
+					}
+				}
+			}
+			else if(sec.name == "shortcut")
+			{
+				const tensor& from = outputs[index + sec.get("from", 0)];
+				out = in;
+				for(size_t i=0; i<out.values.size(); i++)
+				{
+					out.values[i] = activate(sec.values.at("activation"), in.values[i] + from.values[i]);
+				}
+			}
+			else if(sec.name == "route")
+			{
+				for(const auto& entry : {sec.values.at("layers").substr(0, sec.values.at("layers").find(',')), sec.values.at("layers").substr(sec.values.at("layers").find(',') + 1)})
+				{
+					const tensor& from = outputs[index + std::stoi(entry)];
+					out.h = from.h;
+					out.w = from.w;
+					out.c += from.c;
+					out.values.insert(out.values.end(), from.values.begin(), from.values.end());
+				}
+			}
+			else if(sec.name == "upsample")
+			{
+				out.c = in.c;
+				out.h = in.h * 2;
+				out.w = in.w * 2;
+				out.values.resize((size_t)out.c * out.h * out.w);
+				for(uint32_t c=0; c<out.c; c++)
+				{
+					for(uint32_t y=0; y<out.h; y++)
+					{
+						for(uint32_t x=0; x<out.w; x++)
+						{
+							out.values[((size_t)c * out.h + y) * out.w + x] = in.at(c, y / 2, x / 2);
+						}
+					}
+				}
+			}
+			outputs.push_back(std::move(out));
+		}
+		return outputs.back();
+	}
+}
+
+int main()
+{
+	const std::filesystem::path folder = std::filesystem::temp_directory_path() / "yolo_pruning_test";
+	std::filesystem::remove_all(folder);
+	std::filesystem::create_directories(folder);
+
+	// the channels with a gamma of 0 output their activated bias wherever they are. the residual unit only drops channels that are 0 in all of its convolutions
+	const std::unordered_map<size_t, std::vector<uint32_t>> dead_channels = {{0, {1, 6}}, {1, {2}}, {2, {1, 6}}, {4, {0}}, {5, {1, 6}}, {7, {3, 5}}};
+	const uint32_t num_dead_channels = 10;
+	const uint32_t num_scores = 8 + 4 + 4 + 6; // the channels of the residual unit, layers 1, 4 and 7
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	const std::filesystem::path weights_filepath = folder / "model.weights";
+	{
+		std::ofstream file(weights_filepath, std::ios::binary);
+		const int32_t version[3] = {0, 2, 5};
+		const uint64_t seen = 0;
+		file.write((const char*)version, sizeof(version));
+		file.write((const char*)&seen, sizeof(seen));
+		auto write = [&](const std::vector<float>& v)
+		{
+			file.write((const char*)v.data(), (std::streamsize)(v.size() * sizeof(float)));
+		};
+		const auto sections = parse_sections(s_model);
+		uint32_t c = 3;
+		std::vector<uint32_t> channels; // output channels per layer
+		for(size_t s=1; s<sections.size(); s++)
+		{
+			const section& sec = sections[s];
+			const size_t index = channels.size();
+			if(sec.name == "convolutional")
+			{
+				const auto filters = (uint32_t)sec.get("filters", 1);
+				std::vector<float> biases(filters), scales(filters), means(filters), variances(filters), weights((size_t)filters * c * sec.get("size", 1) * sec.get("size", 1));
+				for(uint32_t o=0; o<filters; o++)
+				{
+					biases[o] = distribution(random);
+					scales[o] = 1.0f + distribution(random) * 0.5f;
+					means[o] = distribution(random) * 0.1f;
+					variances[o] = 1.0f + distribution(random) * 0.5f;
+				}
+				std::generate(weights.begin(), weights.end(), [&](){ return distribution(random) * 0.5f; });
+				if(dead_channels.count(index) != 0)
+				{
+					for(uint32_t o : dead_channels.at(index))
+					{
+						scales[o] = 0.0f;
+					}
+				}
+				write(biases);
+				if(sec.get("batch_normalize", 0) != 0)
+				{
+					write(scales);
+					write(means);
+					write(variances);
+				}
+				write(weights);
+				c = filters;
+			}
+			else if(sec.name == "route")
+			{
+				c = channels[index - 1] + channels[index - 2];
+			}
+			channels.push_back(c);
+		}
+	}
+
+	tensor input;
+	input.c = 3;
+	input.h = input.w = 8;
+	input.values.resize((size_t)input.c * input.h * input.w);
+	std::generate(input.values.begin(), input.values.end(), [&](){ return distribution(random); });
+	const tensor expected = forward(s_model, weights_filepath, input);
+
+	// removes exactly the channels with a gamma of 0
+	yolo::v3::prune_args args;
+	args.ratio = ((float)num_dead_channels - 4.0f + 0.5f) / (float)num_scores; // the residual unit counts its 2 channels once, not 3 times
+	args.min_channels = 1;
+	args.channel_multiple = 1;
+	const yolo::cfg::cfg model_cfg{.lines = split_lines(s_model)};
+	const auto report = yolo::internal::prune(model_cfg, s_model, weights_filepath, args, folder / "pruned");
+	CHECK(report.has_value());
+	if(report.has_value())
+	{
+		CHECK(report->num_pruned_channels == num_dead_channels);
+		CHECK(report->bflops_after < report->bflops_before);
+
+		std::ifstream file(folder / "pruned" / yolo::internal::s_model_template_filename);
+		const std::string pruned_model((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+		const tensor output = forward(pruned_model, report->weights_path, input);
+		CHECK(output.c == expected.c && output.h == expected.h && output.w == expected.w);
+		float max_error = 0.0f;
+		for(size_t i=0; i<std::min(output.values.size(), expected.values.size()); i++)
+		{
+			max_error = std::max(max_error, std::fabs(output.values[i] - expected.values[i]));
+		}
+		CHECK(max_error < 1e-4f);
+		if(max_error >= 1e-4f)
+		{
+			fprintf(stderr, "  the pruned model differs by up to %g\n", max_error);
+		}
+	}
+
+	// an empty entry of a [route] is not layer 0
+	std::string trailing_comma = s_model;
+	trailing_comma.replace(trailing_comma.find("layers=-1,-2"), 12, "layers=-1,-2,");
+	CHECK(!yolo::internal::prune(yolo::cfg::cfg{.lines = split_lines(trailing_comma)}, trailing_comma, weights_filepath, args, folder / "invalid").has_value());
+
+	std::filesystem::remove_all(folder);
+	return yolo::tests::exit_code();
+}
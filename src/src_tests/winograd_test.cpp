@@ -0,0 +1,115 @@
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include "winograd.hpp"
+#include "check.hpp"
+
+// 'winograd_convolution' against im2col + 'gemm' ( the pass the other convolutions run on ), within a tolerance
+
+namespace
+{
+	struct shape
+	{
+		uint32_t channels;
+		uint32_t filters;
+		uint32_t width;
+		uint32_t height;
+		uint32_t pad;
+	};
+
+	/// 3x3, stride 1
+	void im2col(const std::vector<float>& input, const shape& s, uint32_t output_width, uint32_t output_height, std::vector<float>& columns)
+	{
+		columns.assign((size_t)s.channels * 9 * output_width * output_height, 0.0f);
+		for(uint32_t c=0; c<s.channels; c++)
+		{
+			for(uint32_t k=0; k<9; k++)
+			{
+				float* p_row = &columns[((size_t)c * 9 + k) * output_width * output_height];
+				for(uint32_t y=0; y<output_height; y++)
+				{
+					for(uint32_t x=0; x<output_width; x++)
+					{
+						const int64_t source_y = (int64_t)y + k / 3 - s.pad;
+						const int64_t source_x = (int64_t)x + k % 3 - s.pad;
+						if(source_y >= 0 && source_y < s.height && source_x >= 0 && source_x < s.width)
+						{
+							p_row[(size_t)y * output_width + x] = input[((size_t)c * s.height + source_y) * s.width + source_x];
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/// \return the largest difference, relative to the size of the value ( at least 1 )
+	float max_error(const std::vector<float>& output, const std::vector<float>& expected)
+	{
+		float error = 0.0f;
+		for(size_t i=0; i<output.size(); i++)
+		{
+			error = std::max(error, std::fabs(output[i] - expected[i]) / std::max(1.0f, std::fabs(expected[i])));
+		}
+		return error;
+	}
+}
+
+int main()
+{
+	// odd sizes end in partial tiles, pad 0 makes the output smaller than the input, and the last ones are the deep layers of yolov3 ( 13x13 and 26x26 )
+	const shape shapes[] = {
+		{1, 1, 4, 4, 1},
+		{3, 5, 7, 9, 1},
+		{8, 4, 10, 11, 0},
+		{16, 8, 11, 11, 1},
+		{64, 32, 33, 17, 1},
+		{256, 512, 26, 26, 1},
+		{512, 1024, 13, 13, 1}
+	};
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	for(const auto& s : shapes)
+	{
+		const uint32_t output_width = s.width + 2 * s.pad - 2;
+		const uint32_t output_height = s.height + 2 * s.pad - 2;
+		const size_t n = (size_t)output_width * output_height;
+		std::vector<float> input((size_t)s.channels * s.width * s.height);
+		std::vector<float> weights((size_t)s.filters * s.channels * 9);
+		std::vector<float> biases(s.filters);
+		std::vector<float> residual(s.filters * n);
+		for(auto* p_values : {&input, &weights, &biases, &residual})
+		{
+			std::generate(p_values->begin(), p_values->end(), [&](){ return distribution(random); });
+		}
+
+		std::vector<float> columns;
+		im2col(input, s, output_width, output_height, columns);
+		const auto filters = yolo::internal::winograd_transform_filters(weights.data(), s.filters, s.channels);
+
+		// the sums of 9 * channels products: float rounding grows with the depth, the transforms add some more
+		const float tolerance = 1e-5f * std::sqrt((float)s.channels * 9.0f) * 8.0f;
+
+		std::vector<float> expected(s.filters * n);
+		std::vector<float> output(s.filters * n);
+		yolo::internal::gemm(s.filters, n, (size_t)s.channels * 9, weights.data(), (size_t)s.channels * 9, columns.data(), n, expected.data(), n, false);
+		yolo::internal::winograd_convolution(filters, input.data(), s.width, s.height, s.pad, output.data(), output_width, output_height);
+		const float error = max_error(output, expected);
+		CHECK(error < tolerance);
+		if(error >= tolerance)
+		{
+			fprintf(stderr, "  %u channels, %u filters, %ux%u, pad %u: error %g\n", s.channels, s.filters, s.width, s.height, s.pad, error);
+		}
+
+		// the fused epilogue ( bias, leaky, residual ) gives the same as it does on 'gemm'
+		yolo::internal::gemm_epilogue epilogue;
+		epilogue.p_bias = biases.data();
+		epilogue.act = yolo::internal::gemm_epilogue::activation::leaky;
+		epilogue.p_residual = residual.data();
+		epilogue.ld_residual = n;
+		yolo::internal::gemm(s.filters, n, (size_t)s.channels * 9, weights.data(), (size_t)s.channels * 9, columns.data(), n, expected.data(), n, false, &epilogue);
+		yolo::internal::winograd_convolution(filters, input.data(), s.width, s.height, s.pad, output.data(), output_width, output_height, &epilogue);
+		CHECK(max_error(output, expected) < tolerance);
+	}
+	return yolo::tests::exit_code();
+}